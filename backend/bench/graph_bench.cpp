@@ -0,0 +1,337 @@
+// Throughput and latency percentiles of Graph operations on a deterministic
+// synthetic social graph:
+//
+//   follows       power-law out-degree; targets Zipf over a shuffled popularity order
+//   posts         Zipf authors, 6-30 words drawn Zipf from a generated vocabulary
+//   likes, views  Zipf over posts, timestamps with exponential age and a daily
+//                 cycle; likes come from followers of the author
+//
+// The first --single ops of each add_* kind are timed one by one; the rest of
+// the posts and interactions go through the batched APIs. communities() is
+// quadratic in users and only runs up to --communities-max users.
+// Each scale builds a fresh graph in a temp directory; the results are one
+// JSON document (stdout, or --out), tagged with --label for comparing commits.
+//
+//   g++ -std=c++17 -O2 -pthread $(find src -type d -printf '-I%p ') bench/graph_bench.cpp
+//       $(find src -name '*.cpp' ! -name main.cpp) -o graph_bench
+//   ./graph_bench --users=10000,100000,1000000 --label=$(git rev-parse --short HEAD)
+#include "graph.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Options {
+    vector<int> users = {10000, 100000, 1000000};
+    uint64_t seed = 42;
+    size_t queries = 200;
+    size_t single = 20000;
+    int communities_max = 20000;
+    string label;
+    string out;
+};
+
+// Samples ranks 0..n-1 with P(k) proportional to 1 / (k + 1)^s.
+class Zipf {
+public:
+    Zipf(size_t n, double s) : cdf_(n) {
+        double sum = 0.0;
+        for (size_t k = 0; k < n; ++k) cdf_[k] = sum += pow(static_cast<double>(k + 1), -s);
+        for (double &c : cdf_) c /= sum;
+    }
+    template <class Rng>
+    size_t operator()(Rng &rng) {
+        const double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return min(static_cast<size_t>(lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin()), cdf_.size() - 1);
+    }
+
+private:
+    vector<double> cdf_;
+};
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Per-call latencies of one operation; a batched call counts `items` items.
+class Timings {
+public:
+    template <class F>
+    auto time(F &&f, size_t items = 1) {
+        const auto start = chrono::steady_clock::now();
+        auto result = f();
+        samples_.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        items_ += items;
+        return result;
+    }
+    void skip(const char *reason) { skipped_ = reason; }
+
+    string json() {
+        if (!skipped_.empty()) return "{\"skipped\":\"" + skipped_ + "\"}";
+        sort(samples_.begin(), samples_.end());
+        double total = 0.0;
+        for (double s : samples_) total += s;
+        auto pct = [&](double p) {
+            if (samples_.empty()) return 0.0;
+            return samples_[min(samples_.size() - 1, static_cast<size_t>(p * static_cast<double>(samples_.size())))];
+        };
+        char buf[320];
+        snprintf(buf, sizeof buf,
+                 "{\"calls\":%zu,\"items\":%zu,\"total_s\":%.6f,\"items_per_s\":%.1f,"
+                 "\"p50_us\":%.2f,\"p90_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f,\"max_us\":%.2f}",
+                 samples_.size(), items_, total / 1e6, total > 0.0 ? static_cast<double>(items_) / (total / 1e6) : 0.0,
+                 pct(0.50), pct(0.90), pct(0.99), pct(0.999), samples_.empty() ? 0.0 : samples_.back());
+        return buf;
+    }
+
+private:
+    vector<double> samples_;
+    size_t items_ = 0;
+    string skipped_;
+};
+
+vector<string> make_vocabulary(size_t n, mt19937_64 &rng) {
+    static const char *onsets[] = {"b", "c", "d", "f", "g", "h", "j", "k", "l", "m", "n", "p", "r", "s", "t", "v", "w", "z",
+                                   "br", "ch", "cl", "dr", "fl", "gr", "pl", "sh", "st", "th", "tr"};
+    static const char *vowels[] = {"a", "e", "i", "o", "u", "ai", "ea", "ou", "io"};
+    vector<string> words;
+    words.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        string w;
+        const int syllables = 1 + static_cast<int>(rng() % 4);
+        for (int s = 0; s < syllables; ++s) {
+            w += onsets[rng() % size(onsets)];
+            w += vowels[rng() % size(vowels)];
+        }
+        words.push_back(move(w));
+    }
+    return words;
+}
+
+// Seconds before now: exponential age (mean 36h, capped at 30 days), thinned
+// so that activity follows a daily cycle.
+int64_t interaction_timestamp(int64_t now, mt19937_64 &rng) {
+    exponential_distribution<double> age(1.0 / (36.0 * 3600.0));
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    for (;;) {
+        const int64_t t = now - static_cast<int64_t>(min(age(rng), 30.0 * 86400.0));
+        const double hour = static_cast<double>(t % 86400) / 3600.0;
+        if (unit(rng) < 0.55 + 0.45 * sin((hour - 8.0) / 24.0 * 6.283185307179586)) return t;
+    }
+}
+
+string run_scale(int users, const Options &opt) {
+    mt19937_64 rng(opt.seed + static_cast<uint64_t>(users));
+    const auto dir = filesystem::temp_directory_path() / ("graph_bench_" + to_string(users));
+    filesystem::remove_all(dir);
+    const string db = (dir / "social_graph.db").string();
+    const auto build_start = chrono::steady_clock::now();
+    const int64_t now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+    Graph g(db);
+    Timings add_user, add_follow, add_post, add_posts_bulk, add_like, add_view, add_interactions;
+    vector<int> user_ids;
+    user_ids.reserve(users);
+    for (int i = 0; i < users; ++i) {
+        const string name = "user" + to_string(i);
+        user_ids.push_back(add_user.time([&] { return g.add_user(name); }));
+    }
+
+    // power-law out-degree (Pareto, alpha 1.5, mean ~9), Zipf targets
+    vector<int> popularity(user_ids);
+    shuffle(popularity.begin(), popularity.end(), rng);
+    Zipf pick_popular(popularity.size(), 1.0);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    vector<vector<int>> followers(users);  // by user index
+    size_t follows = 0;
+    for (int i = 0; i < users; ++i) {
+        const double degree = 3.0 * pow(1.0 - unit(rng), -1.0 / 1.5);
+        const size_t k = min<size_t>(static_cast<size_t>(degree), 5000);
+        for (size_t e = 0; e < k; ++e) {
+            const int target = popularity[pick_popular(rng)];
+            if (target == user_ids[i]) continue;
+            add_follow.time([&] { return g.add_follow(user_ids[i], target); });
+            followers[target - user_ids.front()].push_back(user_ids[i]);
+            ++follows;
+        }
+    }
+
+    const vector<string> vocabulary = make_vocabulary(5000, rng);
+    Zipf pick_word(vocabulary.size(), 1.1);
+    Zipf pick_author(popularity.size(), 0.8);
+    const size_t post_count = static_cast<size_t>(users) * 2;
+    vector<int> post_ids, post_authors;
+    post_ids.reserve(post_count);
+    vector<pair<int, string>> batch;
+    auto flush_posts = [&] {
+        auto results = add_posts_bulk.time([&] { return g.add_posts_bulk(batch); }, batch.size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (results[i].post_id < 0) continue;
+            post_ids.push_back(results[i].post_id);
+            post_authors.push_back(batch[i].first);
+        }
+        batch.clear();
+    };
+    for (size_t p = 0; p < post_count; ++p) {
+        const int author = popularity[pick_author(rng)];
+        string text;
+        const int words = 6 + static_cast<int>(rng() % 25);
+        for (int w = 0; w < words; ++w) {
+            if (w) text += ' ';
+            text += vocabulary[pick_word(rng)];
+        }
+        if (p < opt.single) {
+            const int id = add_post.time([&] { return g.add_post(author, text); });
+            if (id >= 0) { post_ids.push_back(id); post_authors.push_back(author); }
+            continue;
+        }
+        batch.emplace_back(author, move(text));
+        if (batch.size() == 10000) flush_posts();
+    }
+    if (!batch.empty()) flush_posts();
+
+    Zipf pick_post(post_ids.size(), 0.9);
+    uniform_int_distribution<size_t> pick_user(0, user_ids.size() - 1);
+    const size_t view_count = static_cast<size_t>(users) * 8, like_count = static_cast<size_t>(users) * 2;
+    vector<InteractionRecord> records;
+    auto flush_records = [&] {
+        add_interactions.time([&] { return g.add_interactions(records); }, records.size());
+        records.clear();
+    };
+    size_t likes = 0;
+    for (size_t i = 0; i < view_count + like_count; ++i) {
+        const bool like = i >= view_count;
+        const size_t p = pick_post(rng);
+        int user = user_ids[pick_user(rng)];
+        if (like) {
+            const auto &fans = followers[post_authors[p] - user_ids.front()];
+            if (fans.empty()) continue;
+            user = fans[rng() % fans.size()];
+            ++likes;
+        }
+        const int64_t ts = interaction_timestamp(now, rng);
+        const size_t done = like ? likes - 1 : i;
+        if (done < opt.single) {
+            if (like) add_like.time([&] { return g.add_like(user, post_ids[p], 3.0, ts); });
+            else add_view.time([&] { return g.add_view(user, post_ids[p], 1.0, ts); });
+            continue;
+        }
+        records.push_back({like ? InteractionRecord::Type::Like : InteractionRecord::Type::View,
+                           user, post_ids[p], like ? 3.0 : 1.0, ts});
+        if (records.size() == 10000) flush_records();
+    }
+    if (!records.empty()) flush_records();
+    const double build_s = seconds_since(build_start);
+
+    Timings recompute, bfs, weighted, weighted_bounded, recommend, personalized, communities, search, search_aho, autocomplete, save, load;
+    for (int r = 0; r < 3; ++r) recompute.time([&] { g.recompute_analytics(); return 0; });
+    const Graph::ClusteringSummary clustering = g.clustering_summary();
+    for (size_t q = 0; q < opt.queries; ++q) {
+        const int a = user_ids[pick_user(rng)], b = popularity[pick_popular(rng)];
+        bfs.time([&] { return g.bfs_path(a, b); });
+        weighted.time([&] { return g.weighted_path(a, b); });
+        weighted_bounded.time([&] { return g.weighted_path(a, b, {4.0, 6}); });
+    }
+    for (size_t q = 0; q < opt.queries; ++q) {
+        const int u = user_ids[pick_user(rng)];
+        recommend.time([&] { return g.recommendations(u); });
+        personalized.time([&] { return g.personalized_recommendations(u); });
+    }
+    if (users <= opt.communities_max) communities.time([&] { return g.communities(); });
+    else communities.skip("users above --communities-max");
+    for (size_t q = 0; q < opt.queries; ++q) {
+        const string &word = vocabulary[pick_word(rng)];
+        search.time([&] { return g.search_posts(word); });
+        const string fragment = word.substr(word.size() / 3, max<size_t>(3, word.size() / 2));
+        search_aho.time([&] { return g.search_posts_aho(fragment); });
+        const string prefix = word.substr(0, 2 + rng() % 2);
+        autocomplete.time([&] { return g.autocomplete(prefix); });
+    }
+    for (int r = 0; r < 3; ++r) {
+        save.time([&] { g.save_to_db(db); return 0; });
+        load.time([&] { g.load_from_db(db); return 0; });
+    }
+    filesystem::remove_all(dir);
+
+    ostringstream out;
+    out << "{\"users\":" << users << ",\"follows\":" << follows << ",\"posts\":" << post_ids.size()
+        << ",\"views\":" << view_count << ",\"likes\":" << likes << ",\"triangles\":" << clustering.triangles
+        << ",\"transitivity\":" << clustering.transitivity << ",\"build_s\":" << build_s << ",\"ops\":{"
+        << "\"add_user\":" << add_user.json() << ",\"add_follow\":" << add_follow.json()
+        << ",\"add_post\":" << add_post.json() << ",\"add_posts_bulk\":" << add_posts_bulk.json()
+        << ",\"add_like\":" << add_like.json() << ",\"add_view\":" << add_view.json()
+        << ",\"add_interactions\":" << add_interactions.json()
+        << ",\"recompute_analytics\":" << recompute.json() << ",\"bfs_path\":" << bfs.json()
+        << ",\"weighted_path\":" << weighted.json() << ",\"weighted_path_bounded\":" << weighted_bounded.json()
+        << ",\"recommendations\":" << recommend.json() << ",\"personalized_recommendations\":" << personalized.json()
+        << ",\"communities\":" << communities.json()
+        << ",\"search_posts\":" << search.json() << ",\"search_posts_aho\":" << search_aho.json()
+        << ",\"autocomplete\":" << autocomplete.json()
+        << ",\"save_to_db\":" << save.json() << ",\"load_from_db\":" << load.json() << "}}";
+    return out.str();
+}
+
+bool parse_flag(const string &arg, const char *name, string &value) {
+    const string prefix = string("--") + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        string v;
+        if (parse_flag(arg, "users", v)) {
+            opt.users.clear();
+            stringstream list(v);
+            for (string item; getline(list, item, ',');) opt.users.push_back(atoi(item.c_str()));
+        } else if (parse_flag(arg, "seed", v)) opt.seed = strtoull(v.c_str(), nullptr, 10);
+        else if (parse_flag(arg, "queries", v)) opt.queries = strtoull(v.c_str(), nullptr, 10);
+        else if (parse_flag(arg, "single", v)) opt.single = strtoull(v.c_str(), nullptr, 10);
+        else if (parse_flag(arg, "communities-max", v)) opt.communities_max = atoi(v.c_str());
+        else if (parse_flag(arg, "label", v)) opt.label = v;
+        else if (parse_flag(arg, "out", v)) opt.out = v;
+        else {
+            fprintf(stderr, "usage: %s [--users=N,N,...] [--seed=N] [--queries=N] [--single=N] "
+                            "[--communities-max=N] [--label=S] [--out=FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    for (int users : opt.users) {
+        if (users < 2) {
+            fprintf(stderr, "need at least 2 users per scale\n");
+            return 2;
+        }
+    }
+
+    ostringstream doc;
+    doc << "{\"benchmark\":\"graph_bench\",\"label\":\"" << opt.label << "\",\"seed\":" << opt.seed
+        << ",\"queries\":" << opt.queries << ",\"single\":" << opt.single << ",\"scales\":[";
+    for (size_t i = 0; i < opt.users.size(); ++i) {
+        fprintf(stderr, "graph_bench: %d users...\n", opt.users[i]);
+        doc << (i ? "," : "") << run_scale(opt.users[i], opt);
+    }
+    doc << "]}\n";
+    if (opt.out.empty()) {
+        fputs(doc.str().c_str(), stdout);
+    } else {
+        ofstream(opt.out) << doc.str();
+    }
+    return 0;
+}
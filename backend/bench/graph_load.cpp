@@ -0,0 +1,343 @@
+// In-process mixed-workload load generator and contention profiler for Graph.
+//
+// Seeds a graph (users, Zipf follows, posts), then runs --threads workers for
+// --duration seconds. Every operation first picks a class from --mix, then an
+// operation within the class by weight (--weights overrides any of them):
+//
+//   read         get_post_metrics, get_user_metrics, top_posts, get_ranked_after,
+//                users_list_after, get_followers, search_posts, autocomplete, bfs_path,
+//                weighted_path, personalized_recommendations
+//   interaction  add_view, add_like (by a follower of the post's author)
+//   write        add_post, add_follow, add_user, delete_post, recompute_analytics
+//
+// Users and posts are drawn Zipf with exponent --skew (0 = uniform), so hot
+// keys contend on the same stripes. Every --interval seconds one JSON line
+// reports throughput, per-class latency and per-lock wait from Graph::stats();
+// a summary line with per-operation percentiles follows at the end. Exits 1
+// if the overall p99 is above --p99-us.
+//
+//   g++ -std=c++17 -O2 -pthread $(find src -type d -printf '-I%p ') bench/graph_load.cpp
+//       $(find src -name '*.cpp' ! -name main.cpp) -o graph_load
+//   ./graph_load --threads=16 --duration=30 --mix=90,9,1 --skew=1.1 --p99-us=2000
+#include "graph.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+enum Class { Read, Interaction, Write, kClasses };
+const char *const kClassNames[] = {"read", "interaction", "write"};
+
+struct OpSpec {
+    const char *name;
+    Class cls;
+    double weight;
+};
+
+OpSpec g_ops[] = {
+    {"get_post_metrics", Read, 30}, {"get_user_metrics", Read, 15}, {"top_posts", Read, 15},
+    {"get_ranked_after", Read, 10}, {"users_list_after", Read, 5}, {"get_followers", Read, 10},
+    {"search_posts", Read, 8}, {"autocomplete", Read, 5}, {"bfs_path", Read, 2},
+    {"weighted_path", Read, 2}, {"personalized_recommendations", Read, 2},
+    {"add_view", Interaction, 85}, {"add_like", Interaction, 15},
+    {"add_post", Write, 50}, {"add_follow", Write, 35}, {"add_user", Write, 10},
+    {"delete_post", Write, 4}, {"recompute_analytics", Write, 1},
+};
+constexpr size_t kOps = sizeof(g_ops) / sizeof(g_ops[0]);
+
+struct Options {
+    int threads = 8;
+    double duration = 10.0;
+    double interval = 1.0;
+    double mix[kClasses] = {90, 9, 1};
+    double skew = 1.0;
+    int users = 20000;
+    int posts = 40000;
+    double p99_us = 0.0;  // 0 = no gate
+    uint64_t seed = 42;
+};
+
+class Zipf {
+public:
+    Zipf(size_t n, double s) : cdf_(n) {
+        double sum = 0.0;
+        for (size_t k = 0; k < n; ++k) cdf_[k] = sum += pow(static_cast<double>(k + 1), -s);
+        for (double &c : cdf_) c /= sum;
+    }
+    template <class Rng>
+    size_t operator()(Rng &rng) const {
+        const double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return min(static_cast<size_t>(lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin()), cdf_.size() - 1);
+    }
+
+private:
+    vector<double> cdf_;
+};
+
+// What the workers draw keys from; fixed after seeding.
+struct Keys {
+    vector<int> users;               // Zipf rank -> user id
+    vector<int> posts;               // Zipf rank -> post id
+    vector<int> post_author;         // by post rank
+    vector<vector<int>> followers;   // by user id
+    vector<string> words;
+};
+
+LatencyHistogram::Snapshot delta(const LatencyHistogram::Snapshot &now, const LatencyHistogram::Snapshot &before) {
+    LatencyHistogram::Snapshot d;
+    if (now.count == 0) return d;
+    d.counts = now.counts;
+    if (!before.counts.empty()) {
+        for (size_t b = 0; b < d.counts.size(); ++b) d.counts[b] -= before.counts[b];
+    }
+    d.count = now.count - before.count;
+    d.sum_nanos = now.sum_nanos - before.sum_nanos;
+    for (size_t b = d.counts.size(); b-- > 0;) {
+        if (d.counts[b]) { d.max_nanos = min(now.max_nanos, LatencyHistogram::bucket_upper_bound(b)); break; }
+    }
+    return d;
+}
+
+string latency_json(const LatencyHistogram::Snapshot &h, double seconds) {
+    char buf[256];
+    snprintf(buf, sizeof buf, "{\"ops\":%llu,\"ops_per_s\":%.1f,\"p50_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f,\"max_us\":%.2f}",
+             static_cast<unsigned long long>(h.count), seconds > 0 ? static_cast<double>(h.count) / seconds : 0.0,
+             h.quantile(0.5) / 1e3, h.quantile(0.99) / 1e3, h.quantile(0.999) / 1e3, h.max_nanos / 1e3);
+    return buf;
+}
+
+// Lock contention over one interval: how many acquisitions had to wait, and
+// for how long in total.
+string lock_json(const GraphStats::Lock &now, const GraphStats::Lock &before, double seconds) {
+    ostringstream out;
+    out << "{";
+    const pair<const char *, LatencyHistogram::Snapshot> modes[] = {
+        {"exclusive", delta(now.wait, before.wait)}, {"shared", delta(now.shared_wait, before.shared_wait)}};
+    for (size_t i = 0; i < 2; ++i) {
+        const auto &h = modes[i].second;
+        const uint64_t contended = h.count - (h.counts.empty() ? 0 : h.counts[0]);
+        char buf[200];
+        snprintf(buf, sizeof buf, "\"%s\":{\"acquired\":%llu,\"contended\":%llu,\"wait_s_per_s\":%.6f,\"p99_wait_us\":%.2f}",
+                 modes[i].first, static_cast<unsigned long long>(h.count), static_cast<unsigned long long>(contended),
+                 seconds > 0 ? h.sum_nanos / 1e9 / seconds : 0.0, h.quantile(0.99) / 1e3);
+        out << (i ? "," : "") << buf;
+    }
+    const auto hold = delta(now.hold, before.hold);
+    char buf[96];
+    snprintf(buf, sizeof buf, ",\"p99_hold_us\":%.2f}", hold.quantile(0.99) / 1e3);
+    out << buf;
+    return out.str();
+}
+
+Keys seed_graph(Graph &g, const Options &opt, mt19937_64 &rng) {
+    Keys k;
+    for (int i = 0; i < opt.users; ++i) k.users.push_back(g.add_user("load" + to_string(i)));
+    shuffle(k.users.begin(), k.users.end(), rng);
+    k.followers.resize(static_cast<size_t>(k.users.size()) + 1);
+    Zipf popular(k.users.size(), 1.0);
+    for (int u : k.users) {
+        const int degree = 1 + static_cast<int>(rng() % 20);
+        for (int e = 0; e < degree; ++e) {
+            const int target = k.users[popular(rng)];
+            if (target != u && g.add_follow(u, target)) k.followers[target].push_back(u);
+        }
+    }
+    for (int i = 0; i < 2000; ++i) k.words.push_back("w" + to_string(i));
+    Zipf word(k.words.size(), 1.1);
+    vector<pair<int, string>> batch;
+    for (int i = 0; i < opt.posts; ++i) {
+        string text;
+        for (int w = 0; w < 12; ++w) text += k.words[word(rng)] + " ";
+        batch.emplace_back(k.users[popular(rng)], move(text));
+    }
+    const auto results = g.add_posts_bulk(batch, false);
+    vector<pair<int, int>> posts;  // (post id, author)
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].post_id >= 0) posts.emplace_back(results[i].post_id, batch[i].first);
+    }
+    shuffle(posts.begin(), posts.end(), rng);
+    for (const auto &[post, author] : posts) {
+        k.posts.push_back(post);
+        k.post_author.push_back(author);
+    }
+    return k;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const string key = arg.substr(0, eq), value = eq == string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--threads") opt.threads = max(1, atoi(value.c_str()));
+        else if (key == "--duration") opt.duration = atof(value.c_str());
+        else if (key == "--interval") opt.interval = max(0.1, atof(value.c_str()));
+        else if (key == "--skew") opt.skew = atof(value.c_str());
+        else if (key == "--users") opt.users = max(2, atoi(value.c_str()));
+        else if (key == "--posts") opt.posts = max(1, atoi(value.c_str()));
+        else if (key == "--p99-us") opt.p99_us = atof(value.c_str());
+        else if (key == "--seed") opt.seed = strtoull(value.c_str(), nullptr, 10);
+        else if (key == "--mix") {
+            if (sscanf(value.c_str(), "%lf,%lf,%lf", &opt.mix[Read], &opt.mix[Interaction], &opt.mix[Write]) != 3) {
+                fprintf(stderr, "--mix wants read,interaction,write weights\n");
+                return 2;
+            }
+        } else if (key == "--weights") {
+            stringstream list(value);
+            for (string item; getline(list, item, ',');) {
+                const size_t colon = item.find(':');
+                auto op = find_if(begin(g_ops), end(g_ops), [&](const OpSpec &o) { return item.compare(0, colon, o.name) == 0 && strlen(o.name) == colon; });
+                if (colon == string::npos || op == end(g_ops)) {
+                    fprintf(stderr, "unknown operation weight '%s'\n", item.c_str());
+                    return 2;
+                }
+                op->weight = atof(item.c_str() + colon + 1);
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--threads=N] [--duration=S] [--interval=S] [--mix=R,I,W] [--weights=op:w,...]\n"
+                            "          [--skew=S] [--users=N] [--posts=N] [--p99-us=US] [--seed=N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    const auto dir = filesystem::temp_directory_path() / "graph_load_db";
+    filesystem::remove_all(dir);
+    Graph g((dir / "social_graph.db").string());
+    mt19937_64 seed_rng(opt.seed);
+    fprintf(stderr, "graph_load: seeding %d users, %d posts...\n", opt.users, opt.posts);
+    const Keys keys = seed_graph(g, opt, seed_rng);
+    g.recompute_analytics();
+    g.reset_metrics();
+
+    array<LatencyHistogram, kClasses> by_class;
+    array<LatencyHistogram, kOps> by_op;
+    LatencyHistogram overall;
+    atomic<bool> stop{false};
+    const Zipf user_rank(keys.users.size(), opt.skew), post_rank(keys.posts.size(), opt.skew);
+    const Zipf word_rank(keys.words.size(), 1.1);
+
+    auto worker = [&](int t) {
+        mt19937_64 rng(opt.seed * 7919 + static_cast<uint64_t>(t));
+        discrete_distribution<int> pick_class(begin(opt.mix), end(opt.mix));
+        array<vector<size_t>, kClasses> ops_in;
+        array<discrete_distribution<size_t>, kClasses> pick_op;
+        for (int c = 0; c < kClasses; ++c) {
+            vector<double> w;
+            for (size_t o = 0; o < kOps; ++o) {
+                if (g_ops[o].cls == c) { ops_in[c].push_back(o); w.push_back(g_ops[o].weight); }
+            }
+            pick_op[c] = discrete_distribution<size_t>(w.begin(), w.end());
+        }
+        int new_users = 0;
+        while (!stop.load(memory_order_relaxed)) {
+            const int c = pick_class(rng);
+            const size_t o = ops_in[c][pick_op[c](rng)];
+            const int user = keys.users[user_rank(rng)];
+            const size_t p = post_rank(rng);
+            const int post = keys.posts[p];
+            const uint64_t start = monotonic_nanos();
+            switch (o) {
+            case 0: g.get_post_metrics(post); break;
+            case 1: g.get_user_metrics(user); break;
+            case 2: g.top_posts(10); break;
+            case 3: g.get_ranked_after("", 20); break;
+            case 4: g.users_list_after(to_string(user), 20); break;
+            case 5: g.get_followers(user); break;
+            case 6: g.search_posts(keys.words[word_rank(rng)]); break;
+            case 7: g.autocomplete(keys.words[word_rank(rng)].substr(0, 2)); break;
+            case 8: g.bfs_path(user, keys.users[user_rank(rng)]); break;
+            case 9: g.weighted_path(user, keys.users[user_rank(rng)], {4.0, 6}); break;
+            case 10: g.personalized_recommendations(user); break;
+            case 11: g.add_view(user, post); break;
+            case 12: {
+                const auto &fans = keys.followers[keys.post_author[p]];
+                if (fans.empty()) g.add_view(user, post);
+                else g.add_like(fans[rng() % fans.size()], post);
+                break;
+            }
+            case 13: g.add_post(user, keys.words[word_rank(rng)] + " " + keys.words[word_rank(rng)]); break;
+            case 14: g.add_follow(user, keys.users[user_rank(rng)]); break;
+            case 15: g.add_user("load_t" + to_string(t) + "_" + to_string(new_users++)); break;
+            case 16: g.delete_post(post); break;
+            case 17: g.recompute_analytics(); break;
+            }
+            const uint64_t elapsed = monotonic_nanos() - start;
+            by_class[c].record(elapsed);
+            by_op[o].record(elapsed);
+            overall.record(elapsed);
+        }
+    };
+
+    fprintf(stderr, "graph_load: %d threads for %.1fs, mix %g/%g/%g, skew %g\n",
+            opt.threads, opt.duration, opt.mix[Read], opt.mix[Interaction], opt.mix[Write], opt.skew);
+    vector<thread> threads;
+    const auto run_start = chrono::steady_clock::now();
+    for (int t = 0; t < opt.threads; ++t) threads.emplace_back(worker, t);
+
+    array<LatencyHistogram::Snapshot, kClasses> class_before;
+    GraphStats stats_before = g.stats();
+    double elapsed = 0.0;
+    while (elapsed < opt.duration) {
+        const double step = min(opt.interval, opt.duration - elapsed);
+        this_thread::sleep_for(chrono::duration<double>(step));
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - run_start).count();
+        const GraphStats stats_now = g.stats();
+        ostringstream line;
+        line << "{\"t\":" << elapsed << ",\"classes\":{";
+        for (int c = 0; c < kClasses; ++c) {
+            const auto now = by_class[c].snapshot();
+            line << (c ? "," : "") << "\"" << kClassNames[c] << "\":" << latency_json(delta(now, class_before[c]), step);
+            class_before[c] = now;
+        }
+        line << "},\"locks\":{";
+        for (size_t l = 0; l < stats_now.locks.size(); ++l) {
+            line << (l ? "," : "") << "\"" << stats_now.locks[l].name << "\":"
+                 << lock_json(stats_now.locks[l], stats_before.locks[l], step);
+        }
+        line << "}}";
+        puts(line.str().c_str());
+        fflush(stdout);
+        stats_before = stats_now;
+    }
+    stop.store(true);
+    for (auto &t : threads) t.join();
+    const double total_s = chrono::duration<double>(chrono::steady_clock::now() - run_start).count();
+
+    const auto all = overall.snapshot();
+    ostringstream summary;
+    summary << "{\"summary\":{\"threads\":" << opt.threads << ",\"seconds\":" << total_s
+            << ",\"overall\":" << latency_json(all, total_s) << ",\"ops\":{";
+    bool first = true;
+    for (size_t o = 0; o < kOps; ++o) {
+        const auto h = by_op[o].snapshot();
+        if (h.count == 0) continue;
+        summary << (first ? "" : ",") << "\"" << g_ops[o].name << "\":" << latency_json(h, total_s);
+        first = false;
+    }
+    const double p99_us = all.quantile(0.99) / 1e3;
+    const bool failed = opt.p99_us > 0.0 && p99_us > opt.p99_us;
+    summary << "},\"p99_target_us\":" << opt.p99_us << ",\"passed\":" << (failed ? "false" : "true") << "}}";
+    puts(summary.str().c_str());
+    filesystem::remove_all(dir);
+    if (failed) {
+        fprintf(stderr, "graph_load: p99 %.1f us is above the %.1f us target\n", p99_us, opt.p99_us);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,189 @@
+// Allocation and RSS cost of interaction edge storage.
+//
+//   hashmap  per-post unordered_map<user, edge> (the previous layout)
+//   vector   per-post sorted vectors on the global heap
+//   pooled   per-post sorted pmr vectors, small ones carved from per-stripe pools (Graph's layout)
+//   graph    the real Graph: batched view ingestion, then load_from_db (reported as teardown)
+//
+// Run each mode in its own process so RSS numbers do not mix:
+//   g++ -std=c++17 -O2 -pthread $(find src -type d -printf '-I%p ') bench/interaction_alloc_bench.cpp
+//       $(find src -name '*.cpp' ! -name main.cpp) -o alloc_bench
+//   ./alloc_bench pooled [posts] [users] [edges]
+#include "graph.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+static atomic<size_t> g_allocations{0};
+
+// Counting replacements; noinline keeps GCC from pairing the inlined free()
+// with a new-expression and warning about a mismatch.
+__attribute__((noinline)) void *operator new(size_t size) {
+    g_allocations.fetch_add(1, memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+__attribute__((noinline)) void *operator new(size_t size, align_val_t align) {
+    g_allocations.fetch_add(1, memory_order_relaxed);
+    const size_t a = static_cast<size_t>(align);
+    if (void *p = aligned_alloc(a, (max<size_t>(size, 1) + a - 1) / a * a)) return p;
+    throw bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void *p, align_val_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t, align_val_t) noexcept { free(p); }
+
+namespace {
+
+struct Edge {
+    int user_id = 0;
+    double weight = 0.0;
+    int64_t timestamp = 0;
+    double landmark = 0.0;
+};
+
+long rss_kb(const char *field) {
+    ifstream in("/proc/self/status");
+    string line;
+    const size_t n = char_traits<char>::length(field);
+    while (getline(in, line)) {
+        if (line.compare(0, n, field) == 0) return atol(line.c_str() + n + 1);
+    }
+    return -1;
+}
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+struct Result {
+    size_t allocations = 0;
+    double build_s = 0.0;
+    double teardown_s = 0.0;
+    long rss_kb = 0;
+};
+
+Result run_hashmap(int posts, int users, size_t edges, mt19937 &rng) {
+    Result r;
+    const size_t base = g_allocations.load();
+    auto start = chrono::steady_clock::now();
+    auto *table = new vector<unordered_map<int, Edge>>(posts);
+    uniform_int_distribution<int> pick_post(0, posts - 1), pick_user(1, users);
+    for (size_t i = 0; i < edges; ++i) {
+        const int u = pick_user(rng);
+        (*table)[pick_post(rng)][u] = {u, 1.0, 1, 1.0};
+    }
+    r.build_s = seconds_since(start);
+    r.allocations = g_allocations.load() - base;
+    r.rss_kb = rss_kb("VmRSS");
+    start = chrono::steady_clock::now();
+    delete table;
+    r.teardown_s = seconds_since(start);
+    return r;
+}
+
+struct StripePool : pmr::unsynchronized_pool_resource {
+    StripePool() : unsynchronized_pool_resource(pmr::pool_options{0, 256}) {}  // same as Graph::EdgePool
+};
+
+Result run_vectors(int posts, int users, size_t edges, mt19937 &rng, bool pooled) {
+    constexpr size_t stripes = 64;
+    Result r;
+    const size_t base = g_allocations.load();
+    auto start = chrono::steady_clock::now();
+    auto *pools = new array<StripePool, stripes>();
+    auto *table = new vector<pmr::vector<Edge>>();
+    table->reserve(posts);
+    for (int p = 0; p < posts; ++p) {
+        table->emplace_back(pooled ? static_cast<pmr::memory_resource *>(&(*pools)[p % stripes])
+                                   : pmr::new_delete_resource());
+    }
+    uniform_int_distribution<int> pick_post(0, posts - 1), pick_user(1, users);
+    for (size_t i = 0; i < edges; ++i) {
+        const int u = pick_user(rng);
+        auto &list = (*table)[pick_post(rng)];
+        auto it = lower_bound(list.begin(), list.end(), u, [](const Edge &e, int id) { return e.user_id < id; });
+        if (it != list.end() && it->user_id == u) *it = {u, 1.0, 1, 1.0};
+        else list.insert(it, {u, 1.0, 1, 1.0});
+    }
+    r.build_s = seconds_since(start);
+    r.allocations = g_allocations.load() - base;
+    r.rss_kb = rss_kb("VmRSS");
+    start = chrono::steady_clock::now();
+    delete table;
+    delete pools;
+    r.teardown_s = seconds_since(start);
+    return r;
+}
+
+Result run_graph(int posts, int users, size_t edges, mt19937 &rng) {
+    const auto dir = filesystem::temp_directory_path() / "interaction_alloc_bench";
+    filesystem::remove_all(dir);
+    const string db = (dir / "social_graph.db").string();
+    Result r;
+    Graph g(db);
+    for (int u = 1; u <= users; ++u) g.add_user("user" + to_string(u));
+    vector<pair<int, string>> batch;
+    for (int p = 0; p < posts; ++p) batch.emplace_back(1 + p % users, "post " + to_string(p));
+    g.add_posts_bulk(batch, false);
+
+    uniform_int_distribution<int> pick_post(1, posts), pick_user(1, users);
+    vector<InteractionRecord> records;
+    records.reserve(100000);
+    const size_t base = g_allocations.load();
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < edges; ++i) {
+        records.push_back({InteractionRecord::Type::View, pick_user(rng), pick_post(rng), 1.0, 0});
+        if (records.size() == records.capacity() || i + 1 == edges) {
+            g.add_interactions(records);
+            records.clear();
+        }
+    }
+    r.build_s = seconds_since(start);
+    r.allocations = g_allocations.load() - base;
+    r.rss_kb = rss_kb("VmRSS");
+    start = chrono::steady_clock::now();
+    g.load_from_db(db);  // tears down and rebuilds every interaction list
+    r.teardown_s = seconds_since(start);
+    filesystem::remove_all(dir);
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const string mode = argc > 1 ? argv[1] : "pooled";
+    const int posts = argc > 2 ? atoi(argv[2]) : 100000;
+    const int users = argc > 3 ? atoi(argv[3]) : 200000;
+    const size_t edges = argc > 4 ? strtoull(argv[4], nullptr, 10) : 5000000;
+    mt19937 rng(42);
+
+    Result r;
+    if (mode == "hashmap") r = run_hashmap(posts, users, edges, rng);
+    else if (mode == "vector") r = run_vectors(posts, users, edges, rng, false);
+    else if (mode == "pooled") r = run_vectors(posts, users, edges, rng, true);
+    else if (mode == "graph") r = run_graph(posts, users, edges, rng);
+    else {
+        fprintf(stderr, "usage: %s hashmap|vector|pooled|graph [posts] [users] [edges]\n", argv[0]);
+        return 2;
+    }
+    printf("{\"mode\":\"%s\",\"posts\":%d,\"users\":%d,\"edges\":%zu,\"allocations\":%zu,"
+           "\"allocations_per_edge\":%.3f,\"build_s\":%.3f,\"teardown_s\":%.3f,\"rss_kb\":%ld,\"peak_rss_kb\":%ld}\n",
+           mode.c_str(), posts, users, edges, r.allocations, static_cast<double>(r.allocations) / edges,
+           r.build_s, r.teardown_s, r.rss_kb, rss_kb("VmHWM"));
+    return 0;
+}
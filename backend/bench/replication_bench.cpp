@@ -0,0 +1,296 @@
+// Read replicas on one machine: a primary Graph behind a ReplicationServer on
+// localhost and --replicas GraphReplica followers.
+//
+//   1. seeds the primary (users, Zipf follows, posts, likes and views)
+//   2. starts the replicas, which bootstrap from a snapshot
+//   3. runs one writer on the primary (follows, posts, likes, views and the
+//      occasional post or user deletion) at --write-rate ops/s, with
+//      --readers threads reading from the primary for --seconds, then from
+//      the replicas (round robin) for --seconds; lag is sampled every 10 ms
+//   4. stops the writer, waits for every replica to reach the primary's log
+//      offset, and compares each one with the primary user by user and post
+//      by post
+//   5. starts one more replica late, so its snapshot includes the
+//      deletions, and compares that one too
+//
+// Prints one JSON document with read throughput per phase and lag
+// percentiles; exits 1 if any replica differs from the primary.
+//
+//   g++ -std=c++17 -O2 -pthread $(find src -type d -printf '-I%p ') bench/replication_bench.cpp
+//       $(find src -name '*.cpp' ! -name main.cpp) -o replication_bench
+//   ./replication_bench --users=20000 --replicas=3 --readers=8 --seconds=5
+#include "graph.hpp"
+#include "graph_replica.hpp"
+#include "replication_server.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+atomic<size_t> g_sink{0};  // keeps the reads' results alive
+
+struct Options {
+    int users = 20000;
+    size_t replicas = 3;
+    size_t readers = 8;
+    double seconds = 5.0;
+    double write_rate = 5000.0;  // 0 = as fast as the primary takes them
+    uint64_t seed = 42;
+};
+
+// Samples ranks 0..n-1 with P(k) proportional to 1 / (k + 1)^s.
+class Zipf {
+public:
+    Zipf(size_t n, double s) : cdf_(n) {
+        double sum = 0.0;
+        for (size_t k = 0; k < n; ++k) cdf_[k] = sum += pow(static_cast<double>(k + 1), -s);
+        for (double &c : cdf_) c /= sum;
+    }
+    template <class Rng>
+    size_t operator()(Rng &rng) {
+        const double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return min(static_cast<size_t>(lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin()), cdf_.size() - 1);
+    }
+
+private:
+    vector<double> cdf_;
+};
+
+double percentile(vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    sort(v.begin(), v.end());
+    return v[min(v.size() - 1, static_cast<size_t>(p * static_cast<double>(v.size())))];
+}
+
+// One of the reads a feed page makes; returns something so it isn't optimized away.
+template <class G>
+size_t read_once(G &g, mt19937_64 &rng, Zipf &pick, int users) {
+    const int u = 1 + static_cast<int>(pick(rng) % static_cast<size_t>(users));
+    switch (rng() % 10) {
+    case 0: return g.bfs_path(u, 1 + static_cast<int>(rng() % static_cast<uint64_t>(users))).size();
+    case 1: case 2: case 3: return g.get_followers(u).size();
+    case 4: case 5: return g.get_user_posts(u).size();
+    default: return static_cast<size_t>(g.get_user_metrics(u).followers);
+    }
+}
+
+// Differences between a replica and the primary, counted per user and post.
+size_t compare(Graph &primary, GraphReplica &replica, int max_user_id, int max_post_id) {
+    size_t mismatches = 0;
+    auto sorted = [](vector<int> v) {
+        sort(v.begin(), v.end());
+        return v;
+    };
+    for (int u = 1; u <= max_user_id; ++u) {
+        const auto a = primary.get_user_metrics(u), b = replica.get_user_metrics(u);
+        if (a.followers != b.followers || a.followings != b.followings || a.posts != b.posts ||
+            a.total_likes != b.total_likes || sorted(primary.get_followers(u)) != sorted(replica.get_followers(u)) ||
+            sorted(primary.get_followings(u)) != sorted(replica.get_followings(u)) ||
+            sorted(primary.get_user_posts(u)) != sorted(replica.get_user_posts(u)) ||
+            sorted(primary.get_liked_posts(u)) != sorted(replica.get_liked_posts(u))) {
+            ++mismatches;
+        }
+    }
+    for (int p = 1; p <= max_post_id; ++p) {
+        const auto a = primary.get_post_metrics(p), b = replica.get_post_metrics(p);
+        if (a.likes != b.likes || a.unique_views != b.unique_views ||
+            fabs(a.interaction_weight - b.interaction_weight) > 1e-6 * max(1.0, a.interaction_weight)) {
+            ++mismatches;
+        }
+    }
+    if (primary.users_list(1, max_user_id) != replica.users_list(1, max_user_id)) ++mismatches;
+    return mismatches;
+}
+
+bool parse_flag(const string &arg, const char *name, string &value) {
+    const string prefix = string("--") + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        string v;
+        if (parse_flag(arg, "users", v)) opt.users = max(2, atoi(v.c_str()));
+        else if (parse_flag(arg, "replicas", v)) opt.replicas = strtoull(v.c_str(), nullptr, 10);
+        else if (parse_flag(arg, "readers", v)) opt.readers = max<size_t>(1, strtoull(v.c_str(), nullptr, 10));
+        else if (parse_flag(arg, "seconds", v)) opt.seconds = atof(v.c_str());
+        else if (parse_flag(arg, "write-rate", v)) opt.write_rate = atof(v.c_str());
+        else if (parse_flag(arg, "seed", v)) opt.seed = strtoull(v.c_str(), nullptr, 10);
+        else {
+            fprintf(stderr, "usage: %s [--users=N] [--replicas=N] [--readers=N] [--seconds=S] [--write-rate=OPS] [--seed=N]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    const auto dir = filesystem::temp_directory_path() / "replication_bench";
+    filesystem::remove_all(dir);
+    Graph primary((dir / "primary.db").string());
+
+    // 1. seed
+    mt19937_64 rng(opt.seed);
+    Zipf pick_user(static_cast<size_t>(opt.users), 1.0);
+    const int64_t now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+    for (int i = 0; i < opt.users; ++i) primary.add_user("user" + to_string(i));
+    vector<InteractionRecord> seed_interactions;
+    for (int a = 1; a <= opt.users; ++a) {
+        for (int k = 0; k < 5; ++k) primary.add_follow(a, 1 + static_cast<int>(pick_user(rng)));
+    }
+    vector<pair<int, string>> seed_posts;
+    for (int i = 0; i < opt.users; ++i) seed_posts.emplace_back(1 + static_cast<int>(pick_user(rng)), "post " + to_string(i));
+    primary.add_posts_bulk(seed_posts, false);
+    for (int i = 0; i < 3 * opt.users; ++i) {
+        InteractionRecord r;
+        r.type = rng() % 4 == 0 ? InteractionRecord::Type::Like : InteractionRecord::Type::View;
+        r.user_id = 1 + static_cast<int>(rng() % static_cast<uint64_t>(opt.users));
+        r.post_id = 1 + static_cast<int>(pick_user(rng));
+        r.weight = 0.5 + static_cast<double>(rng() % 1000) / 333.0;  // not short decimals
+        r.timestamp = now - static_cast<int64_t>(rng() % (7 * 86400));
+        seed_interactions.push_back(r);
+    }
+    primary.add_interactions(seed_interactions);
+
+    // 2. replicas
+    ReplicationServer server(primary);
+    vector<unique_ptr<GraphReplica>> replicas;
+    for (size_t i = 0; i < opt.replicas; ++i) {
+        replicas.push_back(make_unique<GraphReplica>("127.0.0.1", server.port(),
+                                                     (dir / ("replica-" + to_string(i) + ".db")).string()));
+    }
+    auto start = chrono::steady_clock::now();
+    bool ok = true;
+    for (auto &r : replicas) ok = r->wait_for(server.offset(), chrono::seconds(60)) && ok;
+    const double bootstrap_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // 3. writer, readers and the lag sampler
+    atomic<bool> stop_writer{false};
+    atomic<uint64_t> writes{0};
+    thread writer([&] {
+        mt19937_64 wrng(opt.seed + 1);
+        Zipf pick(static_cast<size_t>(opt.users), 1.0);
+        const auto begin = chrono::steady_clock::now();
+        for (uint64_t n = 0; !stop_writer.load(); ++n) {
+            if (opt.write_rate > 0) {
+                this_thread::sleep_until(begin + chrono::duration_cast<chrono::steady_clock::duration>(
+                                                     chrono::duration<double>(static_cast<double>(n) / opt.write_rate)));
+            }
+            const int u = 1 + static_cast<int>(wrng() % static_cast<uint64_t>(opt.users));
+            const int post = 1 + static_cast<int>(pick(wrng));
+            const double weight = 0.5 + static_cast<double>(wrng() % 1000) / 333.0;
+            switch (wrng() % 2000) {
+            case 0: primary.delete_post(post); break;
+            case 1: primary.delete_user(1 + static_cast<int>(wrng() % static_cast<uint64_t>(opt.users))); break;
+            default:
+                switch (wrng() % 10) {
+                case 0: primary.add_follow(u, 1 + static_cast<int>(pick(wrng))); break;
+                case 1: primary.add_post(u, "post by " + to_string(u)); break;
+                case 2: case 3: primary.add_like(u, post, weight, 0); break;
+                default: primary.add_view(u, post, weight, 0); break;
+                }
+            }
+            ++writes;
+        }
+    });
+    atomic<bool> stop_sampler{false};
+    mutex samples_mutex;
+    vector<double> lag_seconds, lag_bytes;
+    thread sampler([&] {
+        while (!stop_sampler.load()) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+            lock_guard lock(samples_mutex);
+            for (auto &r : replicas) {
+                const GraphReplica::Lag lag = r->lag();
+                lag_seconds.push_back(lag.seconds);
+                lag_bytes.push_back(static_cast<double>(lag.bytes));
+            }
+        }
+    });
+    auto run_readers = [&](bool on_replicas) {
+        atomic<bool> stop{false};
+        atomic<uint64_t> reads{0};
+        vector<thread> threads;
+        for (size_t t = 0; t < opt.readers; ++t) {
+            threads.emplace_back([&, t] {
+                mt19937_64 rrng(opt.seed + 100 + t);
+                Zipf pick(static_cast<size_t>(opt.users), 1.0);
+                size_t sink = 0;
+                uint64_t n = 0;
+                for (; !stop.load(); ++n) {
+                    if (on_replicas && !replicas.empty()) sink += read_once(*replicas[t % replicas.size()], rrng, pick, opt.users);
+                    else sink += read_once(primary, rrng, pick, opt.users);
+                }
+                reads += n;
+                g_sink += sink;
+            });
+        }
+        this_thread::sleep_for(chrono::duration<double>(opt.seconds));
+        stop.store(true);
+        for (auto &t : threads) t.join();
+        return static_cast<double>(reads.load()) / opt.seconds;
+    };
+    const uint64_t writes_before = writes.load();
+    const double primary_reads = run_readers(false);
+    const uint64_t writes_primary_phase = writes.load() - writes_before;
+    const double replica_reads = run_readers(true);
+    const uint64_t writes_replica_phase = writes.load() - writes_before - writes_primary_phase;
+    stop_writer.store(true);
+    writer.join();
+    stop_sampler.store(true);
+    sampler.join();
+
+    // 4. convergence
+    start = chrono::steady_clock::now();
+    const uint64_t final_offset = server.offset();
+    for (auto &r : replicas) ok = r->wait_for(final_offset, chrono::seconds(60)) && ok;
+    const double drain_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    int max_user_id = 0, max_post_id = 0;
+    for (const auto &u : primary.users_list(1, numeric_limits<int>::max() / 2)) max_user_id = max(max_user_id, u.first);
+    for (const auto &p : primary.all_posts()) max_post_id = max(max_post_id, p.post_id);
+    max_user_id += 10;  // and a few that never existed
+    max_post_id += 10;
+    size_t mismatches = 0;
+    for (auto &r : replicas) mismatches += compare(primary, *r, max_user_id, max_post_id);
+
+    // 5. a late replica bootstraps from a snapshot taken after the deletions
+    GraphReplica late("127.0.0.1", server.port(), (dir / "replica-late.db").string());
+    ok = late.wait_for(server.offset(), chrono::seconds(60)) && ok;
+    mismatches += compare(primary, late, max_user_id, max_post_id);
+    uint64_t divergences = late.lag().divergences;
+    for (auto &r : replicas) divergences += r->lag().divergences;
+    ok = ok && mismatches == 0 && divergences == 0;
+
+    printf("{\"users\":%d,\"replicas\":%zu,\"readers\":%zu,\"bootstrap_s\":%.3f,\"log_bytes\":%llu,\n", opt.users,
+           opt.replicas, opt.readers, bootstrap_s, static_cast<unsigned long long>(final_offset));
+    printf(" \"reads_per_s\":{\"primary\":%.0f,\"replicas\":%.0f},\"writes_per_s\":{\"primary_phase\":%.0f,"
+           "\"replica_phase\":%.0f},\n",
+           primary_reads, replica_reads, static_cast<double>(writes_primary_phase) / opt.seconds,
+           static_cast<double>(writes_replica_phase) / opt.seconds);
+    printf(" \"lag_seconds\":{\"p50\":%.4f,\"p99\":%.4f,\"max\":%.4f},\"lag_bytes\":{\"p50\":%.0f,\"p99\":%.0f,"
+           "\"max\":%.0f},\"drain_s\":%.3f,\n",
+           percentile(lag_seconds, 0.5), percentile(lag_seconds, 0.99), percentile(lag_seconds, 1.0),
+           percentile(lag_bytes, 0.5), percentile(lag_bytes, 0.99), percentile(lag_bytes, 1.0), drain_s);
+    printf(" \"snapshots_sent\":%llu,\"mismatches\":%zu,\"divergences\":%llu,\"ok\":%s}\n",
+           static_cast<unsigned long long>(server.snapshots_sent()), mismatches,
+           static_cast<unsigned long long>(divergences), ok ? "true" : "false");
+    return ok ? 0 : 1;
+}
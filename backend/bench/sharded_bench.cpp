@@ -0,0 +1,244 @@
+// Partitioned mode against a single Graph on one machine: builds the same
+// synthetic graph (power-law follows with Zipf targets, Zipf authors, views
+// and likes on Zipf posts) into a Graph and into a ShardedGraph for each
+// --shards count, times the writes and the cross-shard algorithms, and checks
+// that every sharded answer matches Graph's:
+//
+//   bfs_path             same path length for --queries random pairs
+//   recompute_analytics  user and post PageRank within 1e-9
+//   communities          same partition (up to --communities-max users)
+//
+// Prints one JSON document with timings and superstep counts per shard
+// count; exits 1 on any mismatch.
+//
+//   g++ -std=c++17 -O2 -pthread $(find src -type d -printf '-I%p ') bench/sharded_bench.cpp
+//       $(find src -name '*.cpp' ! -name main.cpp) -o sharded_bench
+//   ./sharded_bench --users=20000 --shards=1,2,4,8
+#include "graph.hpp"
+#include "sharded_graph.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Options {
+    int users = 20000;
+    vector<size_t> shards = {1, 2, 4};
+    size_t queries = 100;
+    int communities_max = 20000;
+    uint64_t seed = 42;
+};
+
+// Samples ranks 0..n-1 with P(k) proportional to 1 / (k + 1)^s.
+class Zipf {
+public:
+    Zipf(size_t n, double s) : cdf_(n) {
+        double sum = 0.0;
+        for (size_t k = 0; k < n; ++k) cdf_[k] = sum += pow(static_cast<double>(k + 1), -s);
+        for (double &c : cdf_) c /= sum;
+    }
+    template <class Rng>
+    size_t operator()(Rng &rng) {
+        const double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return min(static_cast<size_t>(lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin()), cdf_.size() - 1);
+    }
+
+private:
+    vector<double> cdf_;
+};
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Every write, in order, so both graphs see the same sequence.
+struct Workload {
+    vector<pair<int, int>> follows;
+    vector<int> post_authors;
+    struct Interaction {
+        bool like;
+        int user;
+        size_t post;  // index into post_authors
+        double weight;
+        int64_t timestamp;
+    };
+    vector<Interaction> interactions;
+    vector<pair<int, int>> queries;
+};
+
+Workload make_workload(const Options &opt) {
+    mt19937_64 rng(opt.seed);
+    Workload w;
+    const int n = opt.users;
+    vector<int> popularity(static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i) popularity[static_cast<size_t>(i)] = i + 1;
+    shuffle(popularity.begin(), popularity.end(), rng);
+    Zipf pick_popular(static_cast<size_t>(n), 1.0);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    for (int a = 1; a <= n; ++a) {
+        // Pareto out-degree, alpha 1.5, mean ~9
+        const int degree = min(n - 1, static_cast<int>(3.0 / pow(1.0 - unit(rng), 1.0 / 1.5)));
+        for (int k = 0; k < degree; ++k) w.follows.emplace_back(a, popularity[pick_popular(rng)]);
+    }
+    Zipf pick_author(static_cast<size_t>(n), 0.8);
+    for (int i = 0; i < n; ++i) w.post_authors.push_back(popularity[pick_author(rng)]);
+    Zipf pick_post(w.post_authors.size(), 0.9);
+    const int64_t now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+    for (int i = 0; i < 3 * n; ++i) {
+        const bool like = rng() % 4 == 0;
+        const int user = 1 + static_cast<int>(rng() % static_cast<uint64_t>(n));
+        w.interactions.push_back({like, user, pick_post(rng), 1.0 + static_cast<double>(rng() % 3),
+                                  now - static_cast<int64_t>(rng() % (7 * 86400))});
+    }
+    for (size_t q = 0; q < opt.queries; ++q) {
+        w.queries.emplace_back(1 + static_cast<int>(rng() % static_cast<uint64_t>(n)),
+                               1 + static_cast<int>(rng() % static_cast<uint64_t>(n)));
+    }
+    return w;
+}
+
+// Writes the workload into g; returns the post ids in creation order.
+template <class G>
+vector<int> load(G &g, const Workload &w, int users) {
+    for (int i = 0; i < users; ++i) g.add_user("user" + to_string(i));
+    for (const auto &f : w.follows) g.add_follow(f.first, f.second);
+    vector<int> posts;
+    posts.reserve(w.post_authors.size());
+    for (size_t i = 0; i < w.post_authors.size(); ++i) posts.push_back(g.add_post(w.post_authors[i], "post " + to_string(i)));
+    for (const auto &x : w.interactions) {
+        if (x.like) g.add_like(x.user, posts[x.post], x.weight, x.timestamp);
+        else g.add_view(x.user, posts[x.post], x.weight, x.timestamp);
+    }
+    return posts;
+}
+
+set<vector<int>> partition(vector<pair<int, vector<int>>> communities) {
+    set<vector<int>> out;
+    for (auto &c : communities) {
+        sort(c.second.begin(), c.second.end());
+        out.insert(move(c.second));
+    }
+    return out;
+}
+
+bool parse_flag(const string &arg, const char *name, string &value) {
+    const string prefix = string("--") + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        string v;
+        if (parse_flag(arg, "users", v)) opt.users = atoi(v.c_str());
+        else if (parse_flag(arg, "shards", v)) {
+            opt.shards.clear();
+            stringstream ss(v);
+            for (string item; getline(ss, item, ',');) opt.shards.push_back(strtoull(item.c_str(), nullptr, 10));
+        } else if (parse_flag(arg, "queries", v)) opt.queries = strtoull(v.c_str(), nullptr, 10);
+        else if (parse_flag(arg, "communities-max", v)) opt.communities_max = atoi(v.c_str());
+        else if (parse_flag(arg, "seed", v)) opt.seed = strtoull(v.c_str(), nullptr, 10);
+        else {
+            fprintf(stderr, "usage: %s [--users=N] [--shards=N,N,...] [--queries=N] [--communities-max=N] [--seed=N]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    const Workload w = make_workload(opt);
+    const bool run_communities = opt.users <= opt.communities_max;
+
+    // Workers are forked from this process: start them all before Graph
+    // spawns any threads of its own.
+    vector<unique_ptr<ShardedGraph>> sharded;
+    for (size_t shards : opt.shards) sharded.push_back(make_unique<ShardedGraph>(shards));
+
+    const auto dir = filesystem::temp_directory_path() / "sharded_bench";
+    filesystem::remove_all(dir);
+    Graph graph((dir / "social_graph.db").string());
+    auto start = chrono::steady_clock::now();
+    const vector<int> graph_posts = load(graph, w, opt.users);
+    const double graph_build = seconds_since(start);
+    start = chrono::steady_clock::now();
+    graph.recompute_analytics();
+    const double graph_rank = seconds_since(start);
+    vector<size_t> graph_paths;
+    start = chrono::steady_clock::now();
+    for (const auto &q : w.queries) graph_paths.push_back(graph.bfs_path(q.first, q.second).size());
+    const double graph_bfs = seconds_since(start);
+    set<vector<int>> graph_communities;
+    double graph_comm = 0.0;
+    if (run_communities) {
+        start = chrono::steady_clock::now();
+        graph_communities = partition(graph.communities());
+        graph_comm = seconds_since(start);
+    }
+
+    bool ok = true;
+    printf("{\"users\":%d,\"follows\":%zu,\"posts\":%zu,\"interactions\":%zu,\n", opt.users, w.follows.size(),
+           w.post_authors.size(), w.interactions.size());
+    printf(" \"graph\":{\"build_s\":%.3f,\"pagerank_s\":%.3f,\"bfs_ms\":%.3f,\"communities_s\":%.3f},\n \"sharded\":[",
+           graph_build, graph_rank, graph_bfs * 1e3 / static_cast<double>(max<size_t>(1, w.queries.size())), graph_comm);
+    for (size_t i = 0; i < sharded.size(); ++i) {
+        ShardedGraph &sg = *sharded[i];
+        start = chrono::steady_clock::now();
+        const vector<int> posts = load(sg, w, opt.users);
+        const double build = seconds_since(start);
+
+        start = chrono::steady_clock::now();
+        sg.recompute_analytics();
+        const double rank = seconds_since(start);
+        const auto rank_exchange = sg.last_exchange();
+        double rank_diff = 0.0;
+        for (int u = 1; u <= opt.users; ++u) {
+            rank_diff = max(rank_diff, fabs(sg.get_user_metrics(u).score - graph.get_user_metrics(u).score));
+        }
+        for (size_t p = 0; p < posts.size(); ++p) {
+            rank_diff = max(rank_diff, fabs(sg.get_post_metrics(posts[p]).score - graph.get_post_metrics(graph_posts[p]).score));
+        }
+
+        size_t path_mismatches = 0, supersteps = 0;
+        start = chrono::steady_clock::now();
+        for (size_t q = 0; q < w.queries.size(); ++q) {
+            if (sg.bfs_path(w.queries[q].first, w.queries[q].second).size() != graph_paths[q]) ++path_mismatches;
+            supersteps += sg.last_exchange().supersteps;
+        }
+        const double bfs = seconds_since(start);
+
+        double comm = 0.0;
+        bool same_communities = true;
+        if (run_communities) {
+            start = chrono::steady_clock::now();
+            same_communities = partition(sg.communities()) == graph_communities;
+            comm = seconds_since(start);
+        }
+        const bool matches = rank_diff < 1e-9 && path_mismatches == 0 && same_communities;
+        ok = ok && matches;
+        const double queries = static_cast<double>(max<size_t>(1, w.queries.size()));
+        printf("%s\n  {\"shards\":%zu,\"build_s\":%.3f,\"pagerank_s\":%.3f,\"pagerank_supersteps\":%zu,"
+               "\"pagerank_routed_bytes\":%llu,\"bfs_ms\":%.3f,\"bfs_supersteps\":%.1f,\"communities_s\":%.3f,"
+               "\"max_rank_diff\":%.3g,\"path_mismatches\":%zu,\"same_communities\":%s}",
+               i ? "," : "", sg.shard_count(), build, rank, rank_exchange.supersteps,
+               static_cast<unsigned long long>(rank_exchange.routed_bytes), bfs * 1e3 / queries,
+               static_cast<double>(supersteps) / queries, comm, rank_diff, path_mismatches,
+               same_communities ? "true" : "false");
+    }
+    printf("\n ],\"ok\":%s}\n", ok ? "true" : "false");
+    return ok ? 0 : 1;
+}
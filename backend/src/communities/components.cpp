@@ -0,0 +1,169 @@
+#include "components.hpp"
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+ComponentLabels weak_components(const vector<size_t> &offsets, const vector<uint32_t> &targets) {
+    ComponentLabels labels;
+    const size_t n = offsets.empty() ? 0 : offsets.size() - 1;
+    DSU dsu(static_cast<int>(n));
+    for (size_t v = 0; v < n; ++v) {
+        for (size_t i = offsets[v]; i < offsets[v + 1]; ++i) dsu.unite(static_cast<int>(v), static_cast<int>(targets[i]));
+    }
+    constexpr uint32_t kUnnumbered = 0xffffffffu;
+    vector<uint32_t> number(n, kUnnumbered);  // by root
+    labels.of.resize(n);
+    for (size_t v = 0; v < n; ++v) {
+        const int root = dsu.find(static_cast<int>(v));
+        if (number[root] == kUnnumbered) {
+            number[root] = static_cast<uint32_t>(labels.sizes.size());
+            labels.sizes.push_back(0);
+        }
+        labels.of[v] = number[root];
+        ++labels.sizes[number[root]];
+    }
+    return labels;
+}
+
+ComponentLabels strong_components(const vector<size_t> &offsets, const vector<uint32_t> &targets) {
+    ComponentLabels labels;
+    const size_t n = offsets.empty() ? 0 : offsets.size() - 1;
+    constexpr uint32_t kUnvisited = 0xffffffffu;
+    vector<uint32_t> index(n, kUnvisited), low(n);
+    vector<unsigned char> on_stack(n, 0);
+    vector<uint32_t> stack;
+    struct Frame {
+        uint32_t v;
+        size_t edge;  // next out-edge of v to look at
+    };
+    vector<Frame> frames;
+    labels.of.resize(n);
+    uint32_t next_index = 0;
+    auto visit = [&](uint32_t v) {
+        index[v] = low[v] = next_index++;
+        stack.push_back(v);
+        on_stack[v] = 1;
+        frames.push_back({v, offsets[v]});
+    };
+    for (size_t root = 0; root < n; ++root) {
+        if (index[root] != kUnvisited) continue;
+        visit(static_cast<uint32_t>(root));
+        while (!frames.empty()) {
+            Frame &f = frames.back();
+            const uint32_t v = f.v;
+            if (f.edge < offsets[v + 1]) {
+                const uint32_t w = targets[f.edge++];
+                if (index[w] == kUnvisited) visit(w);  // invalidates f
+                else if (on_stack[w]) low[v] = min(low[v], index[w]);
+                continue;
+            }
+            frames.pop_back();
+            if (!frames.empty()) low[frames.back().v] = min(low[frames.back().v], low[v]);
+            if (low[v] != index[v]) continue;
+            // v roots a component: everything above it on the stack
+            const uint32_t component = static_cast<uint32_t>(labels.sizes.size());
+            size_t size = 0;
+            uint32_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                on_stack[w] = 0;
+                labels.of[w] = component;
+                ++size;
+            } while (w != v);
+            labels.sizes.push_back(size);
+        }
+    }
+    return labels;
+}
+
+vector<pair<int, vector<int>>> followee_communities(const vector<size_t> &offsets, const vector<uint32_t> &targets,
+                                                   const vector<int> &ids) {
+    const size_t n = ids.size();
+    if (n == 0) return {};
+    // in-edges as CSR: the vertices pointing at each target, ascending
+    vector<size_t> in_offsets(n + 1, 0);
+    for (size_t i = 0; i < offsets[n]; ++i) ++in_offsets[targets[i] + 1];
+    for (size_t v = 0; v < n; ++v) in_offsets[v + 1] += in_offsets[v];
+    vector<uint32_t> sources(offsets[n]);
+    {
+        vector<size_t> next(in_offsets.begin(), in_offsets.end() - 1);
+        for (size_t v = 0; v < n; ++v) {
+            for (size_t i = offsets[v]; i < offsets[v + 1]; ++i) sources[next[targets[i]]++] = static_cast<uint32_t>(v);
+        }
+    }
+
+    DSU dsu(ids.back() + 1);
+    vector<uint32_t> shared(n, 0);  // out-neighbours in common with the current vertex
+    vector<uint32_t> candidates;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t e = offsets[i]; e < offsets[i + 1]; ++e) {
+            const uint32_t t = targets[e];
+            // sources are ascending: skip straight past the ones at or below i
+            auto it = upper_bound(sources.begin() + static_cast<ptrdiff_t>(in_offsets[t]),
+                                  sources.begin() + static_cast<ptrdiff_t>(in_offsets[t + 1]), static_cast<uint32_t>(i));
+            for (; it != sources.begin() + static_cast<ptrdiff_t>(in_offsets[t + 1]); ++it) {
+                if (shared[*it]++ == 0) candidates.push_back(*it);
+            }
+        }
+        sort(candidates.begin(), candidates.end());
+        const size_t degree_i = offsets[i + 1] - offsets[i];
+        for (uint32_t j : candidates) {
+            const size_t common = shared[j];
+            const size_t uni = degree_i + (offsets[j + 1] - offsets[j]) - common;
+            if (static_cast<double>(common) / static_cast<double>(uni) > 0.1) dsu.unite(ids[i], ids[j]);
+            shared[j] = 0;
+        }
+        candidates.clear();
+    }
+
+    vector<unsigned char> present(ids.back() + 1, 0);
+    for (int id : ids) present[id] = 1;
+    vector<pair<int, vector<int>>> out;
+    for (auto &comp : dsu.get_components()) {
+        vector<int> members;
+        for (int id : comp.second) {
+            if (present[id]) members.push_back(id);
+        }
+        if (!members.empty()) out.emplace_back(comp.first, move(members));
+    }
+    return out;
+}
+
+vector<pair<size_t, size_t>> size_histogram(const vector<size_t> &sizes) {
+    map<size_t, size_t> counts;
+    for (size_t s : sizes) ++counts[s];
+    return vector<pair<size_t, size_t>>(counts.begin(), counts.end());
+}
+
+void FollowComponents::add_follow(int a, int b) {
+    lock_guard lock(mutex_);
+    dsu_.resize(max(a, b) + 1);
+    dsu_.unite(a, b);
+}
+
+bool FollowComponents::connected(int a, int b) {
+    if (a == b) return true;
+    lock_guard lock(mutex_);
+    const int known = static_cast<int>(dsu_.parent.size());
+    if (a < 0 || b < 0 || a >= known || b >= known) return false;  // never followed or followed
+    return dsu_.connected(a, b);
+}
+
+void FollowComponents::reset(const vector<int> &ids, const ComponentLabels &weak) {
+    DSU dsu(ids.empty() ? 0 : ids.back() + 1);
+    vector<int> first(weak.sizes.size(), -1);  // lowest user id in each component
+    for (size_t v = 0; v < ids.size(); ++v) {
+        int &head = first[weak.of[v]];
+        if (head < 0) head = ids[v];
+        else dsu.unite(head, ids[v]);
+    }
+    lock_guard lock(mutex_);
+    dsu_ = move(dsu);
+}
+
+void FollowComponents::clear() {
+    lock_guard lock(mutex_);
+    dsu_ = DSU(0);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "dsu.hpp"
+
+// Components of a directed graph given as CSR: the out-neighbours of v are
+// targets[offsets[v] .. offsets[v + 1]).
+struct ComponentLabels {
+    std::vector<std::uint32_t> of;   // component of each vertex, 0..sizes.size() - 1
+    std::vector<std::size_t> sizes;  // by component
+};
+
+// Weakly connected components by union-find over every edge, O(E α(V)).
+// Numbered in order of each component's lowest vertex.
+ComponentLabels weak_components(const std::vector<std::size_t> &offsets, const std::vector<std::uint32_t> &targets);
+
+// Strongly connected components by Tarjan's algorithm on an explicit stack,
+// so deep follow chains cannot overflow the call stack; O(V + E). Numbered
+// in reverse topological order: an edge between two components always goes
+// from the higher number to the lower.
+ComponentLabels strong_components(const std::vector<std::size_t> &offsets, const std::vector<std::uint32_t> &targets);
+
+// Vertices whose out-neighbour sets have a Jaccard similarity above 0.1,
+// joined transitively: Graph::communities() over the follow graph. ids[v] is
+// vertex v's user id, ascending; each community is keyed by its union-find
+// root, as a user id. Only vertices sharing an out-neighbour can pass, so
+// candidates come from walking back along the in-edges of each out-neighbour,
+// O(sum of in-degree over every edge's target) rather than O(V^2) pairs. Pairs
+// are united in the order an all-pairs scan would take them, so the keys are
+// the ones that scan would give. Each vertex's targets must be distinct.
+std::vector<std::pair<int, std::vector<int>>> followee_communities(const std::vector<std::size_t> &offsets,
+                                                                   const std::vector<std::uint32_t> &targets,
+                                                                   const std::vector<int> &ids);
+
+// (component size, number of components of that size), ascending by size.
+std::vector<std::pair<std::size_t, std::size_t>> size_histogram(const std::vector<std::size_t> &sizes);
+
+// Weak components of the follow graph by user id, kept current as follows
+// are added so that "no path either way" is a union-find lookup instead of a
+// search. Removals can only split components and are picked up by the next
+// reset(); until then two users may look connected when they are not, never
+// the reverse. Locks internally, so it nests under any graph lock.
+class FollowComponents {
+public:
+    void add_follow(int a, int b);
+    // False only if no chain of follows, in any direction, joins a and b.
+    bool connected(int a, int b);
+    // Start over from exact components: ids[v] is vertex v's user id, ascending.
+    void reset(const std::vector<int> &ids, const ComponentLabels &weak);
+    void clear();
+
+private:
+    std::mutex mutex_;
+    DSU dsu_{0};  // by user id
+};
@@ -9,6 +9,17 @@ DSU::DSU(int n): parent(n), rank(n, 0), size(n, 1) {
     }
 }
 
+void DSU::resize(int n) {
+    int old = (int)parent.size();
+    if (n <= old) return;
+    parent.resize(n);
+    rank.resize(n, 0);
+    size.resize(n, 1);
+    for (int i = old; i < n; ++i) {
+        parent[i] = i;
+    }
+}
+
 int DSU::find(int x) {
     if (parent[x] != x) {
         parent[x] = find(parent[x]); 
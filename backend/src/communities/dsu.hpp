@@ -8,6 +8,9 @@ using namespace std;
 // Used for efficient community detection in social graph
 struct DSU {
     DSU(int n);
+
+    // Grow to n elements; the new ones start as singletons
+    void resize(int n);
     
     // Find with path compression
     int find(int x);
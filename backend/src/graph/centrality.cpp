@@ -0,0 +1,253 @@
+#include "centrality.hpp"
+#include "components.hpp"
+#include "hll_sketch.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+using namespace std;
+
+namespace {
+
+struct Csr {
+    const vector<size_t> &offsets;
+    const vector<uint32_t> &targets;
+};
+
+struct OwnedCsr {
+    vector<size_t> offsets;
+    vector<uint32_t> targets;
+};
+
+OwnedCsr transpose(const vector<size_t> &offsets, const vector<uint32_t> &targets) {
+    const size_t n = offsets.size() - 1;
+    OwnedCsr in;
+    in.offsets.assign(n + 1, 0);
+    for (uint32_t w : targets) ++in.offsets[w + 1];
+    for (size_t v = 0; v < n; ++v) in.offsets[v + 1] += in.offsets[v];
+    in.targets.resize(targets.size());
+    vector<size_t> next(in.offsets.begin(), in.offsets.end() - 1);
+    for (size_t v = 0; v < n; ++v) {
+        for (size_t i = offsets[v]; i < offsets[v + 1]; ++i) in.targets[next[targets[i]]++] = static_cast<uint32_t>(v);
+    }
+    return in;
+}
+
+// One worker's state for sampling shortest paths. Vertex state is stamped
+// with the sample's generation, so a sample costs O(vertices touched).
+struct PathSampler {
+    struct Side {
+        vector<uint32_t> stamp;
+        vector<uint32_t> dist;
+        vector<double> paths;  // shortest paths from this side's end
+        vector<uint32_t> frontier, next;
+    };
+    struct Cut {
+        uint32_t forward;   // reached from s
+        uint32_t backward;  // reached from t; forward -> backward is an edge
+        double paths;
+    };
+
+    explicit PathSampler(size_t n) {
+        for (Side &side : sides) {
+            side.stamp.assign(n, 0);
+            side.dist.resize(n);
+            side.paths.resize(n);
+        }
+    }
+
+    // Draws one shortest s -> t path uniformly at random and leaves its inner
+    // vertices in `path`, which is empty if t is unreachable or adjacent.
+    void sample(const Csr &out, const Csr &in, uint32_t s, uint32_t t, mt19937_64 &rng) {
+        path.clear();
+        cut.clear();
+        const uint32_t gen = ++generation;
+        const Csr *adjacent[2] = {&out, &in};  // side 0 walks edges forwards from s, side 1 backwards from t
+        for (int d = 0; d < 2; ++d) {
+            Side &side = sides[d];
+            const uint32_t start = d == 0 ? s : t;
+            side.stamp[start] = gen;
+            side.dist[start] = 0;
+            side.paths[start] = 1.0;
+            side.frontier.assign(1, start);
+        }
+
+        // Grow the cheaper frontier a whole level at a time. The first level
+        // that touches the other side closes every shortest path, each
+        // through exactly one of the edges it found.
+        double total = 0.0;
+        while (cut.empty() && !sides[0].frontier.empty() && !sides[1].frontier.empty()) {
+            size_t work[2] = {0, 0};
+            for (int d = 0; d < 2; ++d) {
+                for (uint32_t v : sides[d].frontier) work[d] += adjacent[d]->offsets[v + 1] - adjacent[d]->offsets[v];
+            }
+            const int d = work[0] <= work[1] ? 0 : 1;
+            Side &side = sides[d];
+            const Side &other = sides[1 - d];
+            const Csr &adj = *adjacent[d];
+            side.next.clear();
+            for (uint32_t u : side.frontier) {
+                const uint32_t next_dist = side.dist[u] + 1;
+                const double u_paths = side.paths[u];
+                for (size_t i = adj.offsets[u]; i < adj.offsets[u + 1]; ++i) {
+                    const uint32_t w = adj.targets[i];
+                    if (other.stamp[w] == gen) {
+                        const double p = u_paths * other.paths[w];
+                        cut.push_back(d == 0 ? Cut{u, w, p} : Cut{w, u, p});
+                        total += p;
+                    } else if (side.stamp[w] != gen) {
+                        side.stamp[w] = gen;
+                        side.dist[w] = next_dist;
+                        side.paths[w] = u_paths;
+                        side.next.push_back(w);
+                    } else if (side.dist[w] == next_dist) {
+                        side.paths[w] += u_paths;
+                    }
+                }
+            }
+            side.frontier.swap(side.next);
+        }
+        if (cut.empty()) return;
+
+        uniform_real_distribution<double> unit(0.0, 1.0);
+        double pick = unit(rng) * total;
+        const Cut *chosen = &cut.back();
+        for (const Cut &c : cut) {
+            if (pick < c.paths) {
+                chosen = &c;
+                break;
+            }
+            pick -= c.paths;
+        }
+        // Walk each half back to its end, taking each step in proportion to
+        // the shortest paths through it.
+        for (int d = 0; d < 2; ++d) {
+            const Side &side = sides[d];
+            const Csr &back = *adjacent[1 - d];
+            uint32_t v = d == 0 ? chosen->forward : chosen->backward;
+            while (side.dist[v] > 0) {
+                path.push_back(v);
+                double r = unit(rng) * side.paths[v];
+                uint32_t step = v;
+                for (size_t i = back.offsets[v]; i < back.offsets[v + 1]; ++i) {
+                    const uint32_t p = back.targets[i];
+                    if (side.stamp[p] != gen || side.dist[p] + 1 != side.dist[v]) continue;
+                    step = p;
+                    if (r < side.paths[p]) break;
+                    r -= side.paths[p];
+                }
+                v = step;
+            }
+        }
+    }
+
+    Side sides[2];
+    uint32_t generation = 0;
+    vector<Cut> cut;
+    vector<uint32_t> path;
+};
+
+void sample_betweenness(const Csr &out, const Csr &in, const CentralityOptions &options, CentralityScores &scores) {
+    const size_t n = out.offsets.size() - 1;
+    // Sample size from the vertex diameter (most vertices on any shortest
+    // path). A directed shortest path stays inside one weakly connected
+    // component, so the largest one bounds it; eccentricities from a few
+    // sources would not, since a source may reach nothing at all.
+    const ComponentLabels weak = weak_components(out.offsets, out.targets);
+    const double diameter = static_cast<double>(*max_element(weak.sizes.begin(), weak.sizes.end()));
+    const double eps = options.betweenness_error;
+    const double delta = min(max(options.failure_probability, 1e-12), 1.0);
+    const size_t samples = static_cast<size_t>(ceil(0.5 / (eps * eps) *
+        (floor(log2(max(diameter - 2.0, 1.0))) + 1.0 + log(1.0 / delta))));
+
+    const size_t workers = parallel_workers(samples, 64);
+    vector<unique_ptr<PathSampler>> samplers(workers);
+    vector<vector<uint32_t>> hits(workers);
+    parallel_for_dynamic(samples, workers, 64, [&](size_t w, size_t begin, size_t end) {
+        if (!samplers[w]) {
+            samplers[w] = make_unique<PathSampler>(n);
+            hits[w].assign(n, 0);
+        }
+        PathSampler &sampler = *samplers[w];
+        for (size_t i = begin; i < end; ++i) {
+            // seeded per sample, so the result does not depend on which thread drew it
+            mt19937_64 sample_rng(options.seed ^ (0x9e3779b97f4a7c15ull * (i + 1)));
+            const uint32_t s = static_cast<uint32_t>(sample_rng() % n);
+            uint32_t t = static_cast<uint32_t>(sample_rng() % (n - 1));
+            if (t >= s) ++t;
+            sampler.sample(out, in, s, t, sample_rng);
+            for (uint32_t v : sampler.path) ++hits[w][v];
+        }
+    });
+    for (const auto &counts : hits) {
+        for (size_t v = 0; v < counts.size(); ++v) scores.betweenness[v] += counts[v];
+    }
+    for (double &b : scores.betweenness) b /= static_cast<double>(samples);
+    scores.samples = samples;
+}
+
+void hyperball_closeness(const Csr &in, const CentralityOptions &options, CentralityScores &scores) {
+    const size_t n = in.offsets.size() - 1;
+    // standard error is about 1.04 / sqrt(registers)
+    const double wanted = pow(1.04 / options.closeness_error, 2.0);
+    size_t m = 16;
+    while (static_cast<double>(m) < wanted && m < HllSketch::kRegisters) m *= 2;
+
+    vector<uint8_t> current(n * m, 0);
+    vector<double> reached(n);
+    for (size_t v = 0; v < n; ++v) {
+        hll::add(&current[v * m], m, hll::hash(v));
+        reached[v] = hll::estimate(&current[v * m], m);
+    }
+    vector<uint8_t> next(current);
+    vector<unsigned char> changed(n, 1), grew(n, 0);
+    const size_t workers = parallel_workers(n, 1024);
+    for (size_t round = 1;; ++round) {
+        // Pull: a vertex reads its in-neighbours' counters from the last
+        // round and writes only its own, so threads never share a write.
+        parallel_for_ranges(n, workers, [&](size_t, size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) {
+                grew[v] = 0;
+                uint8_t *counter = &next[v * m];
+                for (size_t i = in.offsets[v]; i < in.offsets[v + 1]; ++i) {
+                    const uint32_t y = in.targets[i];
+                    if (changed[y] && hll::merge(counter, &current[y * m], m)) grew[v] = 1;
+                }
+                if (!grew[v]) continue;
+                const double now = hll::estimate(counter, m);
+                if (now > reached[v]) {
+                    scores.closeness[v] += (now - reached[v]) / static_cast<double>(round);
+                    reached[v] = now;
+                }
+            }
+        });
+        size_t grown = 0;
+        for (size_t v = 0; v < n; ++v) {
+            if (!grew[v]) continue;
+            copy_n(&next[v * m], m, &current[v * m]);
+            ++grown;
+        }
+        if (grown == 0) break;
+        changed.swap(grew);
+        scores.rounds = round;
+    }
+    for (double &c : scores.closeness) c /= static_cast<double>(n - 1);
+}
+
+} // namespace
+
+CentralityScores compute_centrality(const vector<size_t> &offsets, const vector<uint32_t> &targets,
+                                    const CentralityOptions &options) {
+    CentralityScores scores;
+    const size_t n = offsets.empty() ? 0 : offsets.size() - 1;
+    scores.betweenness.assign(n, 0.0);
+    scores.closeness.assign(n, 0.0);
+    if (n < 2) return scores;
+    const OwnedCsr reversed = transpose(offsets, targets);
+    const Csr out{offsets, targets}, in{reversed.offsets, reversed.targets};
+    if (options.betweenness_error > 0.0 && n >= 3) sample_betweenness(out, in, options, scores);
+    if (options.closeness_error > 0.0) hyperball_closeness(in, options, scores);
+    return scores;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct CentralityOptions {
+    // Betweenness: with probability 1 - failure_probability every score is
+    // within betweenness_error of the exact one (additive, on the 0..1 scale).
+    // 0 skips betweenness.
+    double betweenness_error = 0.02;
+    double failure_probability = 0.1;
+    // Closeness: relative standard error of each HyperBall counter, which
+    // sets its register count. 0 skips closeness.
+    double closeness_error = 0.15;
+    std::uint64_t seed = 0x2545f4914f6cdd1dull;
+};
+
+struct CentralityScores {
+    std::vector<double> betweenness;  // by vertex: share of all shortest paths passing through it
+    std::vector<double> closeness;    // by vertex: mean of 1 / distance from each other vertex (0 if unreachable)
+    std::size_t samples = 0;          // shortest paths sampled for betweenness
+    std::size_t rounds = 0;           // HyperBall rounds until no counter grew
+};
+
+// Centrality over a directed graph given as CSR: the out-neighbours of v are
+// targets[offsets[v] .. offsets[v + 1]). Edges point from follower to
+// followee, so closeness counts how near others are to reaching v.
+//
+// Betweenness follows Riondato and Kornaropoulos: sample vertex pairs, draw
+// one shortest path between each uniformly at random, and count the inner
+// vertices. The sample size comes from the error bound and the size of the
+// largest weakly connected component, which bounds the longest shortest
+// path; it grows only with the log of that size. Each path is found by
+// a balanced bidirectional BFS that counts paths from both ends.
+//
+// Closeness is HyperBall (Boldi and Vigna): every vertex keeps an HLL counter
+// of the vertices within r hops of it, grown one hop per round by merging
+// the counters of its in-neighbours; the growth at round r adds 1 / r for
+// each newly reached vertex.
+//
+// Both parallelize across sources; results do not depend on the thread count.
+CentralityScores compute_centrality(const std::vector<std::size_t> &offsets, const std::vector<std::uint32_t> &targets,
+                                    const CentralityOptions &options);
@@ -1,17 +1,36 @@
 #pragma once
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <limits>
 #include <map>
+#include <memory_resource>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
-#include "hll.hpp"
 #include "trie.hpp"
 #include "dsu.hpp"
+#include "content_arena.hpp"
+#include "dense_id_map.hpp"
+#include "moderation_engine.hpp"
+#include "trending_heap.hpp"
+#include "interaction_window.hpp"
+#include "hll_sketch.hpp"
+#include "graph_stats.hpp"
+#include "instrumented_mutex.hpp"
+#include "random_walks.hpp"
+#include "weighted_paths.hpp"
+#include "centrality.hpp"
+#include "components.hpp"
 
 
 struct RankedUser {
@@ -20,6 +39,17 @@ struct RankedUser {
     double third;         // score
 };
 
+// A page of a listing plus an opaque token for the page after it.
+struct UserPage {
+    std::vector<std::pair<int, std::string>> users;
+    std::string next_cursor;  // empty on the last page
+};
+
+struct RankedPage {
+    std::vector<RankedUser> users;
+    std::string next_cursor;  // empty on the last page
+};
+
 struct PostInfo {
     int post_id;
     int user_id;
@@ -30,19 +60,87 @@ struct PostInfo {
     std::string content;
 };
 
+// One post as seen by Graph::for_each_post. content points into a pinned
+// copy of the text storage and is valid until the visitor returns.
+struct PostView {
+    int post_id = 0;
+    int user_id = 0;
+    int likes = 0;
+    std::uint64_t unique_views = 0;
+    double score = 0.0;
+    double interaction_weight = 0.0;
+    std::string_view content;
+};
+
+struct PostScanOptions {
+    enum Field : unsigned {
+        Likes = 1u << 0,
+        UniqueViews = 1u << 1,
+        Score = 1u << 2,
+        InteractionWeight = 1u << 3,
+        Content = 1u << 4,
+        AllFields = (1u << 5) - 1,
+    };
+    unsigned fields = AllFields;  // fields left out stay zero/empty and are never computed
+    int min_post_id = 0;          // inclusive id range
+    int max_post_id = std::numeric_limits<int>::max();
+    int author_id = -1;           // -1 = any author
+};
+
+struct PostImportResult {
+    int post_id = -1;       // -1 if rejected
+    bool moderated = false; // rejected by the moderation filter
+};
+
+struct InteractionRecord {
+    enum class Type { Like, View };
+    Type type = Type::View;
+    int user_id = 0;
+    int post_id = 0;
+    double weight = 1.0;
+    std::int64_t timestamp = 0;  // <= 0 means "now"
+};
+
+enum class InteractionStatus {
+    Ok,
+    InvalidWeight,
+    UnknownUser,
+    UnknownPost,
+    NotFollowingAuthor,  // likes require following the post's author
+};
+
+class GraphSnapshot;
+class ReplicationLog;
+
+struct PostPatternMatches {
+    int post_id;
+    std::vector<int> patterns;  // indices into the query's pattern list
+};
+
 class Graph {
 public:
     Graph();
+    // Persists to db_path; moderation terms are read from the same directory.
+    explicit Graph(const std::string &db_path);
     ~Graph();
 
     // user management
     int add_user(const std::string &username);
+    // Case-insensitive (ASCII) lookup; -1 if no such user.
+    int find_user_by_username(const std::string &username);
 
     // posts & interactions
     int add_post(int user_id, const std::string &content);
+    // Moderates and tokenizes on worker threads, then applies the whole batch
+    // under one lock acquisition with a single persistence write.
+    std::vector<PostImportResult> add_posts_bulk(const std::vector<std::pair<int, std::string>> &batch,
+                                                 bool moderate = true);
     bool add_follow(int a, int b);
     bool add_like(int user_id, int post_id, double weight = 3.0, std::int64_t timestamp = 0);
     bool add_view(int user_id, int post_id, double weight = 1.0, std::int64_t timestamp = 0);
+    // Applies likes/views grouped by post under one lock, with a single
+    // persistence write; statuses line up with the input records.
+    std::vector<InteractionStatus> add_interactions(const std::vector<InteractionRecord> &records);
     bool delete_post(int post_id);
     bool delete_user(int user_id);
 
@@ -54,15 +152,60 @@ public:
     void persist_follow(int a, int b);
     void persist_like(int user_id, int post_id, double weight, std::int64_t timestamp);
     void persist_view(int user_id, int post_id, double weight, std::int64_t timestamp);
+    // Pre-formatted lines. The persist_* calls queue records in order and
+    // flush_persisted() writes everything queued so far with one write on an
+    // append stream kept open; every writer here flushes once its graph locks
+    // are released, so concurrent writers share a write (group commit).
+    void persist_records(const std::string &records);
+    void flush_persisted();
+
+    // replication (see replication_server.hpp and graph_replica.hpp)
+    // From now on every record persist_* writes (deletions included) also
+    // goes to log, in the order the writes took effect.
+    void attach_replication_log(std::shared_ptr<ReplicationLog> log);
+    struct ReplicationSnapshot {
+        std::string records;       // db file format
+        std::uint64_t log_id = 0;  // 0 if no log is attached
+        std::uint64_t offset = 0;  // log offset the records are current to
+    };
+    // Every writer is held off while the records are written out, so
+    // applying the log from offset on top of them reproduces this graph.
+    ReplicationSnapshot replication_snapshot();
+    // Replaces the whole graph with records from replication_snapshot() and
+    // rewrites the db file to match.
+    void load_snapshot(const std::string &records);
 
     // moderation
     bool moderate_content(const std::string &content);
+    bool reload_moderation_terms(const std::string &path = "db/moderation_terms.txt");
+    std::vector<ModerationEngine::RuleStats> moderation_stats() const;
 
     // analytics
     void recompute_analytics();
+    // Pages over the ranking published by the last analytics run (users who
+    // joined since rank last, by id); both cost O(limit), not O(users).
     std::vector<RankedUser> get_ranked(int page, int limit);
-    std::vector<PostInfo> top_posts();
+    RankedPage get_ranked_after(const std::string &cursor, int limit);  // "" = first page
+    // Trending by time-decayed like/view weight, maintained on every interaction.
+    std::vector<PostInfo> top_posts(std::size_t k = 10);
+    // The shared presorted trending array itself (no copy); it holds at least
+    // min(k, post count) entries. Scores are relative to the decay epoch, so
+    // only their order is meaningful.
+    std::shared_ptr<const std::vector<TrendingEntry>> trending_posts(std::size_t k = 10);
+    // Top posts by raw like/view weight received in the last window_seconds
+    // (up to 7 days), read from per-stripe hourly buckets of active posts.
+    std::vector<PostInfo> trending_window(std::int64_t window_seconds, std::size_t k = 10);
     std::vector<PostInfo> all_posts();
+    // Visits matching posts in id order without copying their text. Only a
+    // snapshot of the requested columns is taken under the locks; the visit
+    // runs lock-free, so writers are not blocked. Return false to stop early.
+    // Returns the number of posts visited.
+    std::size_t for_each_post(const std::function<bool(const PostView &)> &visit,
+                              const PostScanOptions &options = {});
+    // Consistent read-only view for long-running queries (see graph_snapshot.hpp).
+    // Repeated calls share the parts that have not changed in between, and
+    // return the same snapshot while nothing has been written.
+    std::shared_ptr<const GraphSnapshot> snapshot();
     
     // user metrics and queries
     struct UserMetrics {
@@ -70,7 +213,21 @@ public:
         int followings = 0;
         int posts = 0;
         int total_likes = 0;
+        std::uint64_t unique_reach = 0;
         double score = 0.0;
+        // In the undirected follow graph as of the last recompute_analytics:
+        // triangles through the user, and the share of pairs of the user's
+        // neighbours that are connected themselves.
+        std::uint64_t triangles = 0;
+        double clustering = 0.0;
+        // Estimated share of all shortest follow paths passing through the
+        // user, and mean 1 / distance at which other users reach it.
+        double betweenness = 0.0;
+        double closeness = 0.0;
+        // Lowest user id in the user's weakly / strongly connected component
+        // of the follow graph at the last recompute_analytics (0 before one).
+        int weak_component = 0;
+        int strong_component = 0;
     };
     struct PostMetrics {
         int likes = 0;
@@ -79,7 +236,38 @@ public:
         double interaction_weight = 0.0;
     };
     UserMetrics get_user_metrics(int user_id);
+    struct ClusteringSummary {
+        std::uint64_t triangles = 0;
+        std::uint64_t wedges = 0;         // pairs of neighbours around a user, summed over users
+        double transitivity = 0.0;        // 3 * triangles / wedges
+        double average_clustering = 0.0;  // mean local coefficient over all users
+    };
+    // Whole-graph figures from the last recompute_analytics.
+    ClusteringSummary clustering_summary();
+    // Users with the highest betweenness at the last recompute_analytics,
+    // best first: the ones bridging otherwise distant parts of the graph.
+    std::vector<std::pair<int, double>> top_brokers(std::size_t k = 10);
+    // Error bounds (and so cost) of the centrality pass in recompute_analytics.
+    void set_centrality_options(const CentralityOptions &options);
+    struct ComponentSummary {
+        std::size_t weak = 0;            // weakly connected components
+        std::size_t strong = 0;          // strongly connected components
+        std::size_t largest_weak = 0;    // users in the largest one
+        std::size_t largest_strong = 0;
+        // (component size, number of components of that size), ascending by size
+        std::vector<std::pair<std::size_t, std::size_t>> weak_sizes;
+        std::vector<std::pair<std::size_t, std::size_t>> strong_sizes;
+    };
+    // Follow-graph connectivity at the last recompute_analytics.
+    ComponentSummary component_summary();
     PostMetrics get_post_metrics(int post_id);
+    // Estimated distinct viewers across all of a user's posts, kept as one
+    // union sketch per author and updated on every view.
+    std::uint64_t user_unique_reach(int user_id);
+    // Estimated distinct viewers of any post authored by a member of community
+    // cid as of the last recompute_analytics (0 if it had no such community),
+    // merged on demand from the members' current author sketches.
+    std::uint64_t community_unique_reach(int cid);
     std::vector<int> get_followers(int user_id);
     std::vector<int> get_followings(int user_id);
     std::vector<int> get_liked_posts(int user_id);
@@ -87,8 +275,16 @@ public:
 
     // queries
     std::vector<std::pair<int,std::string>> users_list(int page, int limit);
+    UserPage users_list_after(const std::string &cursor, int limit);  // "" = first page
     std::vector<int> bfs_path(int u1, int u2);
+    // Cheapest directed path by follow and interaction strength (see
+    // WeightedUserGraph), over the edge costs of the last recompute_analytics().
+    // Users deleted since then may still appear in the middle of a path.
+    WeightedPath weighted_path(int u1, int u2, const WeightedPathOptions &options = {});
     std::vector<int> recommendations(int u);
+    // Personalized PageRank from u over follows and weighted likes/views:
+    // top-k users u doesn't follow yet and posts it hasn't seen, not its own.
+    WalkRecommendations personalized_recommendations(int u, std::size_t k = 10);
     std::vector<std::pair<int,std::vector<int>>> communities();
     std::vector<int> community_members(int cid);
     std::vector<int> search_posts(const std::string &q);
@@ -96,26 +292,102 @@ public:
     std::vector<std::string> autocomplete_users(const std::string &prefix);
     std::vector<std::string> autocomplete_posts(const std::string &prefix);
     std::vector<int> search_posts_aho(const std::string &pattern);
+    std::vector<PostPatternMatches> search_posts_aho_multi(const std::vector<std::string> &patterns);
+
+    // instrumentation
+    // Operation latencies, lock wait/hold times, PageRank convergence and size
+    // gauges; render with GraphStats::to_prometheus(). The gauges walk every
+    // structure under shared locks, so this is for scrapes, not hot paths.
+    GraphStats stats();
+    // On by default. When off, timers and locks read no clocks at all.
+    void set_metrics_enabled(bool enabled);
+    void reset_metrics();
 
 private:
-    std::shared_mutex mutex_;
+    // Locks, always acquired in this order (skip any you don't need):
+    //   users_mutex_ -> follow_mutex_ -> posts_mutex_ -> post_stripes_ (ascending)
+    //   -> index_mutex_ -> reach_mutex_ -> analytics_mutex_ -> flush_mutex_ -> persist_mutex_
+    // Interaction writers hold posts_mutex_ shared plus their post's stripe
+    // exclusively, so holding posts_mutex_ exclusively also covers every stripe.
+    // The graph's own locks record wait/hold times into metrics_ (declared
+    // first, attached in the constructor).
+    GraphMetrics metrics_;
+    using Mutex = InstrumentedSharedMutex;
+    Mutex users_mutex_;     // user_slots_, usernames_, username_index_, next_user_id_, username_trie_
+    Mutex follow_mutex_;    // followers_, followees_
+    Mutex posts_mutex_;     // post_slots_, posts_ column shape, post_text_, next_post_id_
+    static constexpr std::size_t kPostStripes = 64;
+    std::array<Mutex, kPostStripes> post_stripes_;  // per-post interaction columns
+    Mutex index_mutex_;     // inverted_index_, post_content_trie_, content corpus
+    Mutex reach_mutex_;     // author_reach_ (exclusive only)
+    Mutex analytics_mutex_; // PageRank scores, ranking_
+    Mutex persist_mutex_;   // persist_pending_, db file rewrites, replication_log_ (exclusive only)
+    // Writes to the db file: after every graph lock, before persist_mutex_.
+    // Writers take it only once their graph locks are released.
+    std::mutex flush_mutex_;
+    std::mutex snapshot_mutex_;         // snapshot_, follow_snapshot_; taken before any other lock
+    std::mutex analytics_run_mutex_;    // one analytics run at a time; taken before any other lock
+    // Fed edge changes under whichever graph locks the writer holds; it locks
+    // internally and never calls back into the graph, so it nests under all of them.
+    RandomWalkIndex walks_;
+    // Same arrangement: unions under follow_mutex_ exclusive, reset by
+    // recompute_analytics under follow_mutex_ shared.
+    FollowComponents follow_components_;
+
+    // Bumped by every write to the part they cover, under that part's lock,
+    // so snapshot() can tell which parts of the last snapshot are still current.
+    std::uint64_t users_version_ = 0;    // users_mutex_
+    std::uint64_t follows_version_ = 0;  // follow_mutex_
+    std::uint64_t posts_version_ = 0;    // posts_mutex_: slots, content, decay epoch
+    std::array<std::uint64_t, kPostStripes> stripe_versions_{};  // per stripe: interactions
+    std::uint64_t analytics_version_ = 0;  // analytics_mutex_
+    std::shared_ptr<const GraphSnapshot> snapshot_;
+    std::shared_ptr<const GraphSnapshot> follow_snapshot_;  // users and follows only
+    // Users whose followees changed since the newest follows part of either
+    // snapshot was built; the next one rebuilds only their lists. Written
+    // under follow_mutex_ exclusive, or shared plus snapshot_mutex_.
+    std::unordered_set<int> followees_changed_;
+    bool followees_reset_ = true;  // same guard: no list can be reused
+
     int next_user_id_ = 1;
     int next_post_id_ = 1;
-    std::map<int,std::string> users_; // stable ordering for pagination
 
-    struct WeightedInteraction {
+    // Users and posts live in dense slots: slot order is id order, and every
+    // field is a column indexed by slot, so full scans are linear sweeps.
+    DenseIdMap user_slots_;
+    std::vector<std::string> usernames_;  // by user slot
+    std::unordered_map<std::string, int> username_index_;  // lowercased name -> user id
+
+    struct Interaction {
+        int user_id = 0;
         double weight = 0.0;
         std::int64_t timestamp = 0;
+        double landmark = 0.0;  // weight scaled to decay_epoch_, see landmark_weight()
     };
-    struct Post {
-        int id = 0;
-        int user_id = 0;
-        std::string content;
-        std::unordered_map<int, WeightedInteraction> likes;
-        std::unordered_map<int, WeightedInteraction> views;
-        HyperLogLog unique_viewers;
+    using InteractionList = std::pmr::vector<Interaction>;  // sorted by user_id
+
+    // Structure (size, slot order) changes under posts_mutex_ exclusively;
+    // a slot's interaction fields are guarded by its post stripe.
+    struct PostColumns {
+        std::vector<int> author;
+        std::vector<ContentArena::Span> content;  // into post_text_
+        std::vector<double> decayed_weight;       // sum of like/view landmarks
+        std::vector<InteractionList> likes;
+        std::vector<InteractionList> views;
+        std::vector<HllSketch> unique_viewers;    // sparse until thousands of viewers
+    };
+    // One pool per post stripe, guarded by that stripe's lock: interaction
+    // vectors come out of shared slabs instead of one heap block per edge, and
+    // load_from_db releases whole slabs. Declared before posts_ so it outlives it.
+    struct EdgePool : std::pmr::unsynchronized_pool_resource {
+        EdgePool();
     };
-    std::map<int, Post> posts_;
+    std::array<EdgePool, kPostStripes> edge_pools_;
+    DenseIdMap post_slots_;
+    PostColumns posts_;
+    ContentArena post_text_;
+    // author -> union of unique_viewers over the author's posts
+    std::unordered_map<int, HllSketch> author_reach_;
 
     // follow graph: user -> set of followers (incoming) and followees (outgoing)
     std::unordered_map<int,std::unordered_set<int>> followers_; // who follows the user
@@ -124,46 +396,154 @@ private:
     // inverted index: token -> set of post ids
     std::unordered_map<std::string,std::unordered_set<int>> inverted_index_;
 
+    // pre-lowercased post text for substring scans, entries kept in post id order
+    struct CorpusEntry {
+        int post_id = 0;
+        ContentArena::Span span;
+    };
+    ContentArena lower_corpus_;
+    std::vector<CorpusEntry> corpus_entries_;
+
     // computed analytics
     std::unordered_map<int,double> pagerank_scores_;      // user scores
     std::unordered_map<int,double> post_pagerank_scores_; // post scores
-    std::unordered_map<int,double> post_interaction_weights_;
-
-    struct TrendingEntry {
-        double score = 0.0;
-        int post_id = 0;
+    struct RankEntry {
+        double score;
+        int user_id;
     };
-    struct TrendingMinCompare {
-        bool operator()(const TrendingEntry &a, const TrendingEntry &b) const {
-            if (a.score != b.score) return a.score > b.score;
-            return a.post_id < b.post_id;
-        }
+    std::vector<RankEntry> ranking_;  // live users at the last publish, best first
+    int ranking_max_user_id_ = 0;     // later ids joined since and rank after ranking_
+    std::shared_ptr<const WeightedUserGraph> path_graph_;  // edge costs at the last publish
+    struct UserClustering {
+        std::uint64_t triangles;
+        double coefficient;
     };
-    std::priority_queue<TrendingEntry, std::vector<TrendingEntry>, TrendingMinCompare> top_k_posts_;
-    std::size_t top_k_limit_ = 10;
+    std::unordered_map<int, UserClustering> clustering_;  // users in at least one triangle
+    ClusteringSummary clustering_summary_;
+    std::unordered_map<int,double> betweenness_scores_;  // users on at least one sampled path
+    std::unordered_map<int,double> closeness_scores_;    // users reached by anyone
+    CentralityOptions centrality_options_;
+    std::size_t betweenness_samples_ = 0;
+    std::size_t hyperball_rounds_ = 0;
+    struct UserComponents {
+        int weak;
+        int strong;
+    };
+    std::unordered_map<int, UserComponents> components_;
+    ComponentSummary component_summary_;
+    std::unordered_map<int, std::vector<int>> community_members_;  // communities() keys -> user ids
+
+    // Streaming trending: decayed weights are kept relative to decay_epoch_
+    // (w * 2^((t - epoch) / half-life)), so their order never changes with time
+    // and no rescoring pass is needed. Each stripe owns an indexed heap guarded
+    // by that stripe's lock; readers share a merged, presorted top array that is
+    // rebuilt only after a write has dirtied it.
+    static constexpr double kDecayHalfLifeSeconds = 72.0 * 60.0 * 60.0;
+    static constexpr std::size_t kMaxTrendingCapacity = 1000;
+    std::int64_t decay_epoch_ = 0;  // written only under exclusive posts_mutex_
+    std::array<TrendingHeap, kPostStripes> trending_heaps_;
+    // Raw like/view weight per post and hour over the last week, one ring per
+    // stripe and guarded by it; trending_window reads only posts active in range.
+    std::array<InteractionWindow, kPostStripes> windows_;
+    std::mutex trending_publish_mutex_;  // taken before any other lock
+    std::shared_ptr<const std::vector<TrendingEntry>> trending_published_;  // atomic_load/store
+    std::atomic<bool> trending_dirty_{true};
+    std::atomic<std::size_t> trending_capacity_{100};
 
-    // file path for persistence (used by simple file-based persistence)
+    // file path for persistence (used by simple file-based persistence);
+    // changed only under persist_mutex_ as well
     std::string db_path_;
+    std::string persist_pending_;                 // persist_mutex_: queued records, in write order
+    std::unique_ptr<std::ofstream> persist_out_;  // flush_mutex_: append stream on persist_out_path_
+    std::string persist_out_path_;                // flush_mutex_
+    std::shared_ptr<ReplicationLog> replication_log_;  // persist_mutex_
     
+    // term list is swapped atomically, so moderation never takes mutex_
+    ModerationEngine moderation_;
+
     // Trie for username autocomplete (Person 2's data structure)
     Trie username_trie_;
     
     // Trie for post content autocomplete (Person 2's data structure)
     Trie post_content_trie_;
 
+    // Declared ahead of a writer's locks, so it flushes after they are released.
+    struct PersistFlush {
+        Graph &graph;
+        ~PersistFlush() { graph.flush_persisted(); }
+    };
+    // Caller holds flush_mutex_.
+    void write_persisted_unlocked(const std::string &path, const std::string &records);
+
+    // Users and follows only, for communities(): it neither locks nor copies
+    // posts or scores, which every like and view would make stale.
+    std::shared_ptr<const GraphSnapshot> follow_snapshot();
+    std::shared_ptr<const GraphSnapshot> take_snapshot(bool full);
+    // Caller holds follow_mutex_ exclusively and users_mutex_.
+    void followees_changed_unlocked(int user_id);
+
     // helper
     std::vector<std::string> tokenize_lower(const std::string &s) const;
-    double jaccard_sets(const std::unordered_set<int> &a, const std::unordered_set<int> &b) const;
-    bool username_exists_unlocked(const std::string &username) const;
     bool user_exists_unlocked(int user_id) const;
     const std::unordered_set<int>& followees_for_unlocked(int user_id) const;
     const std::unordered_set<int>& followers_for_unlocked(int user_id) const;
+    Mutex &post_stripe(int post_id);
+    static std::size_t post_stripe_index(int post_id);
+    std::pmr::memory_resource *edge_pool(int post_id);
+    std::vector<std::shared_lock<Mutex>> lock_post_stripes_shared();
     void rebuild_tries_and_index_unlocked();
-    void rebuild_unique_viewers_unlocked();
-    void recompute_analytics_unlocked(std::int64_t now);
-    void rebuild_top_k_unlocked();
+    void rebuild_post_index_unlocked();
+    void rebuild_corpus_unlocked();
+    void corpus_append_unlocked(int post_id, const std::string &content);
+    void corpus_erase_unlocked(int post_id);
+    void erase_post_tokens_unlocked(int post_id, std::string_view content);
+    void append_post_unlocked(int post_id, int user_id, std::string_view content);
+    void erase_posts_unlocked(const std::vector<int> &post_ids);
+    std::string_view post_content_unlocked(std::size_t slot) const;
+    PostInfo post_info_unlocked(std::size_t slot, double interaction_weight) const;
+    void rebuild_unique_viewers_unlocked(std::size_t slot);
+    void rebuild_author_reach_unlocked(const std::unordered_set<int> &authors);
+    void recompute_analytics_unlocked();
+    // Follow edges by user slot, swept from followees_ once per analytics run.
+    struct FollowSlots {
+        std::vector<std::size_t> offsets;    // by slot, user_slots_.size() + 1
+        std::vector<std::uint32_t> targets;  // followee slots
+    };
+    FollowSlots follow_slots_unlocked() const;
+    // Everything an analytics run reads, copied out under the graph locks so
+    // the run itself holds none of them.
+    struct AnalyticsInput {
+        std::uint64_t follows_version = 0;
+        DenseIdMap users;
+        FollowSlots follows;
+        DenseIdMap posts;
+        std::vector<int> author_slot;        // by post slot, -1 if the author is gone
+        std::vector<double> unique_viewers;  // estimates, by post slot
+        struct Edge {
+            std::uint32_t post_slot;
+            std::uint32_t user_slot;
+            double landmark;
+        };
+        std::vector<Edge> interactions;  // likes then views of each post, posts in slot order
+        double decay_scale = 1.0;        // landmarks -> current weights at the copy
+    };
+    AnalyticsInput copy_analytics_input_unlocked() const;
+    static std::shared_ptr<const WeightedUserGraph> build_path_graph(const AnalyticsInput &in);
+    static ClusteringSummary compute_clustering(const AnalyticsInput &in,
+                                                std::unordered_map<int, UserClustering> &users);
+    ComponentSummary compute_components(const AnalyticsInput &in, std::unordered_map<int, UserComponents> &users);
+    std::size_t ranked_count_unlocked() const;
+    std::vector<RankedUser> ranked_range_unlocked(std::size_t position, std::size_t limit) const;
+    double landmark_weight(double weight, std::int64_t timestamp, std::int64_t now) const;
+    double decay_scale(std::int64_t now) const;
+    bool record_interaction_unlocked(std::size_t slot, InteractionList &edges,
+                                     int user_id, double weight, std::int64_t timestamp, std::int64_t now);
+    bool drop_interaction_unlocked(std::size_t slot, InteractionList &edges, int user_id);
+    void rebuild_trending_unlocked();
+    void maybe_rebase_decay_epoch();
+    void load_records(std::istream &in, const std::string &path);
     void save_to_db_unlocked(const std::string &path);
+    void write_records_unlocked(std::ostream &out) const;
     static std::int64_t current_epoch_seconds();
-    static double decay_factor(std::int64_t timestamp, std::int64_t now);
-    double post_interaction_weight_unlocked(const Post &post, std::int64_t now) const;
+    double post_interaction_weight_unlocked(std::size_t slot, std::int64_t now) const;
 };
@@ -1,9 +1,16 @@
 #include "graph.hpp"
+#include "graph_snapshot.hpp"
 #include "aho_corasick.hpp"
+#include "parallel.hpp"
+#include "triangles.hpp"
+#include "replication_log.hpp"
+#include "post_record.hpp"
 #include <algorithm>
 #include <cctype>
 #include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <functional>
 #include <iostream>
@@ -12,6 +19,7 @@
 #include <sstream>
 #include <string>
 #include <filesystem>
+#include <thread>
 #include <unordered_set>
 #include <unordered_map>
 #include <vector>
@@ -25,9 +33,89 @@ static string lower(const string &s) {
     return out;
 }
 
-Graph::Graph() {
-    try { filesystem::create_directories("db"); } catch(...) {}
-    load_from_db("db/social_graph.db");
+// Weights are written with enough digits to read back exactly, so a reload
+// or a replica applying the records gets the primary's values.
+static constexpr int kRecordPrecision = numeric_limits<double>::max_digits10;
+
+// Interaction lists are sorted by user id.
+template <class List>
+static auto interaction_lower_bound(List &edges, int user_id) {
+    return lower_bound(edges.begin(), edges.end(), user_id,
+                       [](const auto &e, int id) { return e.user_id < id; });
+}
+
+// Best score first, ties by lower id.
+template <class Entry>
+static bool ranks_higher(const Entry &a, const Entry &b) {
+    if (a.score != b.score) return a.score > b.score;
+    return a.user_id < b.user_id;
+}
+
+// Ranking cursors carry the last row's (score, id); %a round-trips the double exactly.
+static string encode_rank_cursor(double score, int user_id) {
+    char buf[64];
+    snprintf(buf, sizeof buf, "%a:%d", score, user_id);
+    return buf;
+}
+
+static bool decode_rank_cursor(const string &cursor, double &score, int &user_id) {
+    if (cursor.empty()) return false;
+    char *end = nullptr;
+    score = strtod(cursor.c_str(), &end);
+    if (end == cursor.c_str() || *end != ':') return false;
+    const char *id_begin = end + 1;
+    const long id = strtol(id_begin, &end, 10);
+    if (end == id_begin || *end != '\0') return false;
+    user_id = static_cast<int>(id);
+    return true;
+}
+
+Graph::Graph() : Graph("db/social_graph.db") {}
+
+Graph::Graph(const string &db_path) {
+    users_mutex_.attach(&metrics_.lock(GraphLock::Users), &metrics_.enabled);
+    follow_mutex_.attach(&metrics_.lock(GraphLock::Follow), &metrics_.enabled);
+    posts_mutex_.attach(&metrics_.lock(GraphLock::Posts), &metrics_.enabled);
+    for (auto &stripe : post_stripes_) stripe.attach(&metrics_.lock(GraphLock::PostStripes), &metrics_.enabled);
+    index_mutex_.attach(&metrics_.lock(GraphLock::Index), &metrics_.enabled);
+    reach_mutex_.attach(&metrics_.lock(GraphLock::Reach), &metrics_.enabled);
+    analytics_mutex_.attach(&metrics_.lock(GraphLock::Analytics), &metrics_.enabled);
+    persist_mutex_.attach(&metrics_.lock(GraphLock::Persist), &metrics_.enabled);
+    const auto dir = filesystem::path(db_path).parent_path();
+    try { if (!dir.empty()) filesystem::create_directories(dir); } catch(...) {}
+    moderation_.load_terms((dir / "moderation_terms.txt").string());
+    load_from_db(db_path);
+}
+
+Graph::Mutex &Graph::post_stripe(int post_id) {
+    return post_stripes_[post_stripe_index(post_id)];
+}
+
+size_t Graph::post_stripe_index(int post_id) {
+    return static_cast<size_t>(static_cast<unsigned>(post_id)) % kPostStripes;
+}
+
+// Pools only serve small interaction lists (up to 8 edges, the long tail of
+// posts): larger size classes would strand every block a growing list leaves
+// behind, so those go straight to the heap, which recycles across sizes.
+Graph::EdgePool::EdgePool() : unsynchronized_pool_resource(pmr::pool_options{0, 256}) {}
+
+pmr::memory_resource *Graph::edge_pool(int post_id) {
+    return &edge_pools_[post_stripe_index(post_id)];
+}
+
+vector<shared_lock<Graph::Mutex>> Graph::lock_post_stripes_shared() {
+    vector<shared_lock<Mutex>> locks;
+    locks.reserve(kPostStripes);
+    // one wait sample for the whole sweep rather than 64 clock pairs
+    const bool timed = metrics_.enabled.load(memory_order_relaxed);
+    const uint64_t start = timed ? monotonic_nanos() : 0;
+    for (auto &stripe : post_stripes_) {
+        stripe.lock_shared_untimed();
+        locks.emplace_back(stripe, adopt_lock);
+    }
+    if (timed) metrics_.lock(GraphLock::PostStripes).shared_wait.record(monotonic_nanos() - start);
+    return locks;
 }
 
 Graph::~Graph() {
@@ -35,10 +123,16 @@ Graph::~Graph() {
 }
 
 int Graph::add_user(const string &username) {
-    unique_lock lock(mutex_);
-    if (username_exists_unlocked(username)) return -1;
+    auto timer = metrics_.time(GraphOp::AddUser);
+    PersistFlush flush{*this};
+    string key = lower(username);
+    unique_lock users_lock(users_mutex_);
+    if (username_index_.count(key)) return -1;
     int id = next_user_id_++;
-    users_[id] = username;
+    user_slots_.insert(id);
+    usernames_.push_back(username);
+    username_index_.emplace(move(key), id);
+    ++users_version_;
     
     // Insert username into Trie for autocomplete
     username_trie_.insert(username);
@@ -48,73 +142,241 @@ int Graph::add_user(const string &username) {
 }
 
 int Graph::add_post(int user_id, const string &content) {
-    unique_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::AddPost);
+    PersistFlush flush{*this};
+    const auto tokens = tokenize_lower(content);
+    shared_lock users_lock(users_mutex_);
     if (!user_exists_unlocked(user_id)) return -1;
 
+    unique_lock posts_lock(posts_mutex_);
     int pid = next_post_id_++;
-    Post p; p.id = pid; p.user_id = user_id; p.content = content;
-    posts_[pid] = move(p);
+    append_post_unlocked(pid, user_id, content);
+    trending_heaps_[post_stripe_index(pid)].update(pid, 0.0);
+    trending_dirty_.store(true);
     
     // Build inverted index for keyword search
-    for (auto &tok : tokenize_lower(content)) {
+    unique_lock index_lock(index_mutex_);
+    for (auto &tok : tokens) {
         inverted_index_[tok].insert(pid);
         // Also insert tokens into Trie for autocomplete
         post_content_trie_.insert(tok);
     }
+    corpus_append_unlocked(pid, content);
     
     persist_post(pid, user_id, content);
     return pid;
 }
 
+vector<PostImportResult> Graph::add_posts_bulk(const vector<pair<int, string>> &batch, bool moderate) {
+    auto timer = metrics_.time(GraphOp::AddPostsBulk);
+    PersistFlush flush{*this};
+    vector<PostImportResult> results(batch.size());
+    if (batch.empty()) return results;
+
+    // Phase 1: moderation and tokenization need no graph state, so run them in parallel.
+    vector<vector<string>> tokens(batch.size());
+    const size_t workers = parallel_workers(batch.size(), 256);
+    parallel_for_ranges(batch.size(), workers, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (moderate && moderate_content(batch[i].second)) {
+                results[i].moderated = true;
+                continue;
+            }
+            tokens[i] = tokenize_lower(batch[i].second);
+        }
+    });
+
+    // Phase 2: apply every mutation under a single writer lock per structure.
+    shared_lock users_lock(users_mutex_);
+    unique_lock posts_lock(posts_mutex_);
+    unique_lock index_lock(index_mutex_);
+    unordered_set<string> trie_seen;
+    ostringstream records;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (results[i].moderated) continue;
+        const int user_id = batch[i].first;
+        const string &content = batch[i].second;
+        if (!user_exists_unlocked(user_id)) continue;
+
+        const int pid = next_post_id_++;
+        append_post_unlocked(pid, user_id, content);
+        trending_heaps_[post_stripe_index(pid)].update(pid, 0.0);
+        for (auto &tok : tokens[i]) {
+            inverted_index_[tok].insert(pid);
+            if (trie_seen.insert(tok).second) post_content_trie_.insert(tok);
+        }
+        corpus_append_unlocked(pid, content);
+        records << post_record(pid, user_id, content);
+        results[i].post_id = pid;
+    }
+    trending_dirty_.store(true);
+    persist_records(records.str());
+    return results;
+}
+
 bool Graph::add_follow(int a, int b) {
-    unique_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::AddFollow);
+    PersistFlush flush{*this};
+    shared_lock users_lock(users_mutex_);
     if (a == b || !user_exists_unlocked(a) || !user_exists_unlocked(b)) return false;
+    unique_lock follow_lock(follow_mutex_);
     const bool inserted = followees_[a].insert(b).second;
     followers_[b].insert(a);
-    if (inserted) persist_follow(a, b);
+    if (inserted) {
+        ++follows_version_;
+        followees_changed_unlocked(a);
+        walks_.add_follow(a, b);
+        follow_components_.add_follow(a, b);
+        persist_follow(a, b);
+    }
     return true;
 }
 
 bool Graph::add_like(int user_id, int post_id, double weight, int64_t timestamp) {
-    unique_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::AddLike);
+    PersistFlush flush{*this};
+    shared_lock users_lock(users_mutex_);
     if (!user_exists_unlocked(user_id) || weight <= 0.0) return false;
-    auto it = posts_.find(post_id);
-    if (it == posts_.end()) return false;
-    int author = it->second.user_id;
+    shared_lock follow_lock(follow_mutex_);
+    shared_lock posts_lock(posts_mutex_);
+    const int slot = post_slots_.slot(post_id);
+    if (slot < 0) return false;
+    int author = posts_.author[slot];
     const auto followees_it = followees_.find(user_id);
     if (followees_it == followees_.end() || followees_it->second.find(author) == followees_it->second.end()) return false;
-    if (timestamp <= 0) timestamp = current_epoch_seconds();
-    auto &interaction = it->second.likes[user_id];
-    const bool changed = interaction.timestamp != timestamp || interaction.weight != weight;
-    interaction = {weight, timestamp};
+    const int64_t now = current_epoch_seconds();
+    if (timestamp <= 0) timestamp = now;
+    unique_lock stripe_lock(post_stripe(post_id));
+    const bool changed = record_interaction_unlocked(slot, posts_.likes[slot], user_id, weight, timestamp, now);
     if (changed) persist_like(user_id, post_id, weight, timestamp);
     return true;
 }
 
 bool Graph::add_view(int user_id, int post_id, double weight, int64_t timestamp) {
-    unique_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::AddView);
+    PersistFlush flush{*this};
+    shared_lock users_lock(users_mutex_);
     if (!user_exists_unlocked(user_id) || weight <= 0.0) return false;
-    auto it = posts_.find(post_id);
-    if (it == posts_.end()) return false;
-    if (timestamp <= 0) timestamp = current_epoch_seconds();
-
-    auto &interaction = it->second.views[user_id];
-    const bool changed = interaction.timestamp != timestamp || interaction.weight != weight;
-    interaction = {weight, timestamp};
-    it->second.unique_viewers.add(static_cast<uint64_t>(user_id));
+    shared_lock posts_lock(posts_mutex_);
+    const int slot = post_slots_.slot(post_id);
+    if (slot < 0) return false;
+    const int64_t now = current_epoch_seconds();
+    if (timestamp <= 0) timestamp = now;
+    unique_lock stripe_lock(post_stripe(post_id));
+
+    const bool changed = record_interaction_unlocked(slot, posts_.views[slot], user_id, weight, timestamp, now);
+    posts_.unique_viewers[slot].add(static_cast<uint64_t>(user_id));
+    {
+        lock_guard reach_lock(reach_mutex_);
+        author_reach_[posts_.author[slot]].add(static_cast<uint64_t>(user_id));
+    }
     if (changed) persist_view(user_id, post_id, weight, timestamp);
     return true;
 }
 
+vector<InteractionStatus> Graph::add_interactions(const vector<InteractionRecord> &records) {
+    auto timer = metrics_.time(GraphOp::AddInteractions);
+    PersistFlush flush{*this};
+    vector<InteractionStatus> status(records.size(), InteractionStatus::Ok);
+    if (records.empty()) return status;
+
+    // Group by stripe, then by post, so each stripe lock is taken once and each
+    // post looked up once; stable so later records for the same pair win.
+    vector<size_t> order(records.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const size_t sa = post_stripe_index(records[a].post_id);
+        const size_t sb = post_stripe_index(records[b].post_id);
+        if (sa != sb) return sa < sb;
+        return records[a].post_id < records[b].post_id;
+    });
+
+    const int64_t now = current_epoch_seconds();
+    ostringstream persisted;
+    persisted.precision(kRecordPrecision);
+    shared_lock users_lock(users_mutex_);
+    shared_lock follow_lock(follow_mutex_);
+    shared_lock posts_lock(posts_mutex_);
+    vector<int> new_viewers;  // reused across posts
+    for (size_t stripe_begin = 0; stripe_begin < order.size();) {
+        const size_t stripe = post_stripe_index(records[order[stripe_begin]].post_id);
+        size_t stripe_end = stripe_begin;
+        while (stripe_end < order.size() && post_stripe_index(records[order[stripe_end]].post_id) == stripe) ++stripe_end;
+
+        unique_lock stripe_lock(post_stripes_[stripe]);
+        for (size_t begin = stripe_begin; begin < stripe_end;) {
+            const int post_id = records[order[begin]].post_id;
+            size_t end = begin;
+            while (end < stripe_end && records[order[end]].post_id == post_id) ++end;
+
+            const int slot = post_slots_.slot(post_id);
+            const unordered_set<int> *author_followers = slot >= 0 ? &followers_for_unlocked(posts_.author[slot]) : nullptr;
+            new_viewers.clear();
+            for (size_t k = begin; k < end; ++k) {
+                const size_t idx = order[k];
+                const auto &r = records[idx];
+                if (r.weight <= 0.0) { status[idx] = InteractionStatus::InvalidWeight; continue; }
+                if (!user_exists_unlocked(r.user_id)) { status[idx] = InteractionStatus::UnknownUser; continue; }
+                if (slot < 0) { status[idx] = InteractionStatus::UnknownPost; continue; }
+
+                const int64_t timestamp = r.timestamp > 0 ? r.timestamp : now;
+                const bool like = r.type == InteractionRecord::Type::Like;
+                if (like && !author_followers->count(r.user_id)) {
+                    status[idx] = InteractionStatus::NotFollowingAuthor;
+                    continue;
+                }
+                const bool changed = record_interaction_unlocked(
+                    slot, like ? posts_.likes[slot] : posts_.views[slot], r.user_id, r.weight, timestamp, now);
+                if (!like) new_viewers.push_back(r.user_id);  // sketch adds are idempotent
+                if (changed) {
+                    persisted << (like ? "L|" : "V|") << r.user_id << "|" << post_id << "|"
+                              << r.weight << "|" << timestamp << "\n";
+                }
+            }
+            if (!new_viewers.empty()) {
+                lock_guard reach_lock(reach_mutex_);
+                HllSketch &reach = author_reach_[posts_.author[slot]];
+                for (int viewer : new_viewers) {
+                    posts_.unique_viewers[slot].add(static_cast<uint64_t>(viewer));
+                    reach.add(static_cast<uint64_t>(viewer));
+                }
+            }
+            begin = end;
+        }
+        stripe_begin = stripe_end;
+    }
+    persist_records(persisted.str());
+    return status;
+}
+
 vector<pair<int,string>> Graph::users_list(int page, int limit) {
-    shared_lock lock(mutex_);
-    vector<pair<int,string>> out;
-    for (auto &p : users_) out.emplace_back(p.first, p.second);
+    shared_lock lock(users_mutex_);
+    // slots are in id order, so a page is a contiguous slot range
     int start = (page - 1) * limit;
     if (start < 0) start = 0;
-    if (start >= (int)out.size()) return {};
-    int end = min((int)out.size(), start + limit);
-    return vector<pair<int,string>>(out.begin() + start, out.begin() + end);
+    if (start >= (int)user_slots_.size()) return {};
+    int end = min((int)user_slots_.size(), start + limit);
+    vector<pair<int,string>> out;
+    out.reserve(end - start);
+    for (int s = start; s < end; ++s) out.emplace_back(user_slots_.id_at(s), usernames_[s]);
+    return out;
+}
+
+UserPage Graph::users_list_after(const string &cursor, int limit) {
+    UserPage page;
+    if (limit <= 0) return page;
+    // the cursor is the last id returned; anything unparsable starts over
+    char *end = nullptr;
+    const long after = cursor.empty() ? 0 : strtol(cursor.c_str(), &end, 10);
+    const int after_id = cursor.empty() || *end != '\0' || after < 0 ? 0 : static_cast<int>(min<long>(after, numeric_limits<int>::max() - 1));
+
+    shared_lock lock(users_mutex_);
+    const size_t begin = user_slots_.lower_bound_slot(after_id + 1);
+    const size_t stop = min(user_slots_.size(), begin + static_cast<size_t>(limit));
+    page.users.reserve(stop - begin);
+    for (size_t s = begin; s < stop; ++s) page.users.emplace_back(user_slots_.id_at(s), usernames_[s]);
+    if (stop < user_slots_.size()) page.next_cursor = to_string(page.users.back().first);
+    return page;
 }
 
 vector<string> Graph::tokenize_lower(const string &s) const {
@@ -128,35 +390,116 @@ vector<string> Graph::tokenize_lower(const string &s) const {
     return out;
 }
 
-double Graph::jaccard_sets(const unordered_set<int> &a, const unordered_set<int> &b) const {
-    if (a.empty() && b.empty()) return 0.0;
-    size_t inter = 0;
-    for (int x : a) if (b.find(x) != b.end()) ++inter;
-    size_t uni = a.size() + b.size() - inter;
-    return uni ? (double)inter / (double)uni : 0.0;
-}
-
 int64_t Graph::current_epoch_seconds() {
     using namespace chrono;
     return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
 }
 
-double Graph::decay_factor(int64_t timestamp, int64_t now) {
-    constexpr double half_life_seconds = 72.0 * 60.0 * 60.0;
-    if (timestamp <= 0) return 1.0;
-    const double age_seconds = static_cast<double>(max<int64_t>(0, now - timestamp));
-    return exp(-log(2.0) * age_seconds / half_life_seconds);
+double Graph::landmark_weight(double weight, int64_t timestamp, int64_t now) const {
+    // future timestamps count as "now": an interaction never weighs more than its raw weight
+    const int64_t t = timestamp <= 0 ? now : min(timestamp, now);
+    return weight * exp2(static_cast<double>(t - decay_epoch_) / kDecayHalfLifeSeconds);
+}
+
+double Graph::decay_scale(int64_t now) const {
+    return exp2(-static_cast<double>(now - decay_epoch_) / kDecayHalfLifeSeconds);
+}
+
+// Caller holds the post's stripe exclusively (or posts_mutex_ exclusively).
+bool Graph::record_interaction_unlocked(size_t slot, InteractionList &edges,
+                                        int user_id, double weight, int64_t timestamp, int64_t now) {
+    auto it = interaction_lower_bound(edges, user_id);
+    const bool inserted = it == edges.end() || it->user_id != user_id;
+    if (inserted) it = edges.insert(it, Interaction{user_id});
+    Interaction &interaction = *it;
+    const bool changed = interaction.timestamp != timestamp || interaction.weight != weight;
+    if (!changed) return false;
+    const double landmark = landmark_weight(weight, timestamp, now);
+    walks_.add_interaction(user_id, post_slots_.id_at(slot), landmark - interaction.landmark, inserted ? 1 : 0);
+    double &decayed = posts_.decayed_weight[slot];
+    decayed = max(0.0, decayed - interaction.landmark + landmark);
+    const int post_id = post_slots_.id_at(slot);
+    auto &window = windows_[post_stripe_index(post_id)];
+    if (interaction.weight > 0.0) window.add(interaction.timestamp, post_id, -interaction.weight);
+    window.add(timestamp, post_id, weight);
+    interaction = {user_id, weight, timestamp, landmark};
+    trending_heaps_[post_stripe_index(post_id)].update(post_id, decayed);
+    trending_dirty_.store(true);
+    ++stripe_versions_[post_stripe_index(post_id)];
+    return true;
+}
+
+bool Graph::drop_interaction_unlocked(size_t slot, InteractionList &edges, int user_id) {
+    auto it = interaction_lower_bound(edges, user_id);
+    if (it == edges.end() || it->user_id != user_id) return false;
+    double &decayed = posts_.decayed_weight[slot];
+    decayed = max(0.0, decayed - it->landmark);
+    walks_.add_interaction(user_id, post_slots_.id_at(slot), -it->landmark, -1);
+    const int post_id = post_slots_.id_at(slot);
+    windows_[post_stripe_index(post_id)].add(it->timestamp, post_id, -it->weight);
+    edges.erase(it);
+    trending_heaps_[post_stripe_index(post_id)].update(post_id, decayed);  // decrease-key
+    trending_dirty_.store(true);
+    ++stripe_versions_[post_stripe_index(post_id)];
+    return true;
+}
+
+// Caller holds posts_mutex_ exclusively.
+void Graph::rebuild_trending_unlocked() {
+    const int64_t now = current_epoch_seconds();
+    decay_epoch_ = now;
+    for (auto &heap : trending_heaps_) heap.clear();
+    for (auto &window : windows_) window.clear();
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        double &decayed = posts_.decayed_weight[s];
+        const int post_id = post_slots_.id_at(s);
+        auto &window = windows_[post_stripe_index(post_id)];
+        decayed = 0.0;
+        for (auto *edges : {&posts_.likes[s], &posts_.views[s]}) {
+            for (auto &e : *edges) {
+                e.landmark = landmark_weight(e.weight, e.timestamp, now);
+                decayed += e.landmark;
+                window.add(e.timestamp, post_id, e.weight);
+            }
+        }
+        trending_heaps_[post_stripe_index(post_id)].update(post_id, decayed);
+    }
+    trending_dirty_.store(true);
+}
+
+void Graph::maybe_rebase_decay_epoch() {
+    // Landmarks grow by 2x per half-life; move the epoch forward long before
+    // they could lose precision or overflow.
+    constexpr double max_half_lives = 64.0;
+    const int64_t now = current_epoch_seconds();
+    {
+        shared_lock posts_lock(posts_mutex_);
+        if (static_cast<double>(now - decay_epoch_) < max_half_lives * kDecayHalfLifeSeconds) return;
+    }
+    unique_lock posts_lock(posts_mutex_);
+    const double factor = decay_scale(now);
+    for (double &w : posts_.decayed_weight) w *= factor;
+    for (auto *lists : {&posts_.likes, &posts_.views}) {
+        for (auto &edges : *lists) {
+            for (auto &e : edges) e.landmark *= factor;
+        }
+    }
+    for (auto &heap : trending_heaps_) heap.scale(factor);
+    walks_.scale_weights(factor);
+    decay_epoch_ = now;
+    trending_dirty_.store(true);
+    ++posts_version_;
 }
 
 bool Graph::user_exists_unlocked(int user_id) const {
-    return users_.find(user_id) != users_.end();
+    return user_slots_.contains(user_id);
 }
 
-bool Graph::username_exists_unlocked(const string &username) const {
-    const string target = lower(username);
-    return any_of(users_.begin(), users_.end(), [&](const auto &entry) {
-        return lower(entry.second) == target;
-    });
+int Graph::find_user_by_username(const string &username) {
+    const string key = lower(username);
+    shared_lock lock(users_mutex_);
+    auto it = username_index_.find(key);
+    return it == username_index_.end() ? -1 : it->second;
 }
 
 const unordered_set<int>& Graph::followees_for_unlocked(int user_id) const {
@@ -171,321 +514,1219 @@ const unordered_set<int>& Graph::followers_for_unlocked(int user_id) const {
     return it == followers_.end() ? empty : it->second;
 }
 
+void Graph::followees_changed_unlocked(int user_id) {
+    if (followees_reset_) return;
+    followees_changed_.insert(user_id);
+    // past this many, rebuilding every list costs about the same
+    if (followees_changed_.size() > user_slots_.size() / 2) {
+        followees_changed_.clear();
+        followees_reset_ = true;
+    }
+}
+
 void Graph::rebuild_tries_and_index_unlocked() {
     username_trie_.clear();
+    for (const auto &name : usernames_) username_trie_.insert(name);
+    rebuild_post_index_unlocked();
+}
+
+void Graph::rebuild_post_index_unlocked() {
     post_content_trie_.clear();
     inverted_index_.clear();
-
-    for (const auto &u : users_) username_trie_.insert(u.second);
-    for (const auto &p : posts_) {
-        for (const auto &tok : tokenize_lower(p.second.content)) {
-            inverted_index_[tok].insert(p.first);
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        for (const auto &tok : tokenize_lower(string(post_content_unlocked(s)))) {
+            inverted_index_[tok].insert(post_slots_.id_at(s));
             post_content_trie_.insert(tok);
         }
     }
 }
 
-void Graph::rebuild_unique_viewers_unlocked() {
-    for (auto &p : posts_) {
-        p.second.unique_viewers.clear();
-        for (const auto &view : p.second.views) {
-            p.second.unique_viewers.add(static_cast<uint64_t>(view.first));
-        }
+// Caller holds index_mutex_ exclusively. A token no other post uses leaves
+// the index and autocomplete with it.
+void Graph::erase_post_tokens_unlocked(int post_id, string_view content) {
+    for (const auto &tok : tokenize_lower(string(content))) {
+        auto it = inverted_index_.find(tok);
+        if (it == inverted_index_.end() || !it->second.erase(post_id) || !it->second.empty()) continue;
+        inverted_index_.erase(it);
+        post_content_trie_.erase(tok);
     }
 }
 
-double Graph::post_interaction_weight_unlocked(const Post &post, int64_t now) const {
-    double total = 0.0;
-    for (const auto &like : post.likes) {
-        total += like.second.weight * decay_factor(like.second.timestamp, now);
+void Graph::rebuild_corpus_unlocked() {
+    lower_corpus_.clear();
+    corpus_entries_.clear();
+    corpus_entries_.reserve(post_slots_.size());
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        corpus_entries_.push_back({post_slots_.id_at(s), lower_corpus_.append_lower(post_content_unlocked(s))});
     }
-    for (const auto &view : post.views) {
-        total += view.second.weight * decay_factor(view.second.timestamp, now);
+}
+
+void Graph::corpus_append_unlocked(int post_id, const string &content) {
+    // post ids are handed out in increasing order, so appending keeps entries sorted
+    corpus_entries_.push_back({post_id, lower_corpus_.append_lower(content)});
+}
+
+void Graph::corpus_erase_unlocked(int post_id) {
+    auto it = lower_bound(corpus_entries_.begin(), corpus_entries_.end(), post_id,
+                          [](const CorpusEntry &e, int id) { return e.post_id < id; });
+    if (it == corpus_entries_.end() || it->post_id != post_id) return;
+    lower_corpus_.release(it->span);
+    corpus_entries_.erase(it);
+    if (!lower_corpus_.should_compact()) return;
+
+    ContentArena compacted(lower_corpus_.chunk_bytes());
+    for (auto &e : corpus_entries_) e.span = compacted.append(lower_corpus_.view(e.span));
+    lower_corpus_ = move(compacted);
+}
+
+// Caller holds posts_mutex_ exclusively. Post ids only grow, so this appends.
+void Graph::append_post_unlocked(int post_id, int user_id, string_view content) {
+    post_slots_.insert(post_id);
+    posts_.author.push_back(user_id);
+    posts_.content.push_back(post_text_.append(content));
+    posts_.decayed_weight.push_back(0.0);
+    posts_.likes.emplace_back(edge_pool(post_id));
+    posts_.views.emplace_back(edge_pool(post_id));
+    posts_.unique_viewers.emplace_back();
+    walks_.add_post(post_id, user_id);
+    ++posts_version_;
+}
+
+// Caller holds posts_mutex_ exclusively. Compacts every column in one pass.
+void Graph::erase_posts_unlocked(const vector<int> &post_ids) {
+    for (int id : post_ids) {
+        const int s = post_slots_.slot(id);
+        if (s < 0) continue;
+        post_text_.release(posts_.content[s]);
+        windows_[post_stripe_index(id)].erase(id);
+        walks_.remove_post(id);
+    }
+    const auto keep = post_slots_.erase(post_ids);
+    DenseIdMap::compact_column(posts_.author, keep);
+    DenseIdMap::compact_column(posts_.content, keep);
+    DenseIdMap::compact_column(posts_.decayed_weight, keep);
+    DenseIdMap::compact_column(posts_.likes, keep);
+    DenseIdMap::compact_column(posts_.views, keep);
+    DenseIdMap::compact_column(posts_.unique_viewers, keep);
+    ++posts_version_;
+    if (!post_text_.should_compact()) return;
+
+    ContentArena compacted(post_text_.chunk_bytes());
+    for (auto &span : posts_.content) span = compacted.append(post_text_.view(span));
+    post_text_ = move(compacted);
+}
+
+string_view Graph::post_content_unlocked(size_t slot) const {
+    return post_text_.view(posts_.content[slot]);
+}
+
+// Caller holds posts_mutex_ and the slot's stripe (shared is enough). Score is
+// left at 0 for the caller to fill from the analytics maps.
+PostInfo Graph::post_info_unlocked(size_t slot, double interaction_weight) const {
+    return {
+        post_slots_.id_at(slot),
+        posts_.author[slot],
+        static_cast<int>(posts_.likes[slot].size()),
+        static_cast<uint64_t>(llround(posts_.unique_viewers[slot].estimate())),
+        0.0,
+        interaction_weight,
+        string(post_content_unlocked(slot))
+    };
+}
+
+// Sketches cannot forget a viewer, so retracting one means re-adding the rest.
+void Graph::rebuild_unique_viewers_unlocked(size_t slot) {
+    HllSketch &sketch = posts_.unique_viewers[slot];
+    sketch.clear();
+    for (const auto &view : posts_.views[slot]) sketch.add(static_cast<uint64_t>(view.user_id));
+}
+
+// Caller holds posts_mutex_ exclusively and reach_mutex_. Merges post sketches
+// rather than re-adding viewers, so the cost is per post, not per view.
+void Graph::rebuild_author_reach_unlocked(const unordered_set<int> &authors) {
+    for (int author : authors) author_reach_.erase(author);
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        if (posts_.views[s].empty() || !authors.count(posts_.author[s])) continue;
+        author_reach_[posts_.author[s]].merge(posts_.unique_viewers[s]);
     }
-    return total;
+}
+
+double Graph::post_interaction_weight_unlocked(size_t slot, int64_t now) const {
+    return posts_.decayed_weight[slot] * decay_scale(now);
 }
 
 bool Graph::moderate_content(const string &content) {
-    static AhoCorasick ac = []() {
-        AhoCorasick a;
-        vector<string> vulgar = {"badword", "vulgar", "shit", "fuck", "bitch", "asshole", "damn", "crap"};
-        for (auto &word : vulgar) a.add_pattern(word);
-        a.build();
-        return a;
-    }();
-    
-    string low = lower(content);
-    auto matches = ac.search(low);
-    if (!matches.empty()) return true;
-
-    string cleaned;
-    cleaned.reserve(low.size());
-    for (char c : low) cleaned.push_back(isalnum((unsigned char)c) ? c : ' ');
-    istringstream iss(cleaned);
-    string tok;
-    while (iss >> tok) {
-        auto tok_matches = ac.search(tok);
-        if (!tok_matches.empty()) return true;
-    }
-    string letters; letters.reserve(cleaned.size());
-    for (char c : cleaned) if (isalpha((unsigned char)c)) letters.push_back(c);
-    auto letter_matches = ac.search(letters);
-    if (!letter_matches.empty()) return true;
-    return false;
+    moderation_.reload_if_changed();
+    return moderation_.matches(content);
 }
 
-void Graph::recompute_analytics() {
-    unique_lock lock(mutex_);
-    recompute_analytics_unlocked(current_epoch_seconds());
+bool Graph::reload_moderation_terms(const string &path) {
+    return moderation_.load_terms(path);
 }
 
-void Graph::recompute_analytics_unlocked(int64_t now) {
-    pagerank_scores_.clear();
-    post_pagerank_scores_.clear();
-    post_interaction_weights_.clear();
+vector<ModerationEngine::RuleStats> Graph::moderation_stats() const {
+    return moderation_.rule_stats();
+}
 
-    if (users_.empty()) {
-        rebuild_top_k_unlocked();
-        return;
+GraphStats Graph::stats() {
+    GraphStats out;
+    metrics_.collect(out);
+    auto gauge = [&](const char *name, string labels, double value) {
+        out.gauges.push_back({name, move(labels), value});
+    };
+
+    shared_lock users_lock(users_mutex_);
+    shared_lock follow_lock(follow_mutex_);
+    shared_lock posts_lock(posts_mutex_);
+    auto stripe_locks = lock_post_stripes_shared();
+    shared_lock index_lock(index_mutex_);
+
+    size_t follow_edges = 0;
+    for (const auto &f : followees_) follow_edges += f.second.size();
+    size_t likes = 0, views = 0, edge_bytes = 0, sketch_bytes = 0, windows = 0;
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        likes += posts_.likes[s].size();
+        views += posts_.views[s].size();
+        edge_bytes += (posts_.likes[s].capacity() + posts_.views[s].capacity()) * sizeof(Interaction);
+        sketch_bytes += posts_.unique_viewers[s].memory_bytes();
     }
+    for (const auto &window : windows_) windows += window.entries();
+    size_t postings = 0, token_bytes = 0;
+    for (const auto &inv : inverted_index_) {
+        postings += inv.second.size();
+        token_bytes += inv.first.capacity();
+    }
+    size_t reach_bytes = 0;
+    {
+        lock_guard reach_lock(reach_mutex_);
+        for (const auto &r : author_reach_) reach_bytes += r.second.memory_bytes();
+    }
+    size_t scored = 0, ranking_bytes = 0, path_bytes = 0, clustered = 0, samples = 0, rounds = 0;
+    size_t component_entries = 0, components = 0, strong_components = 0, largest_component = 0,
+        largest_strong_component = 0, communities = 0;
+    ClusteringSummary clustering;
+    {
+        shared_lock analytics_lock(analytics_mutex_);
+        scored = pagerank_scores_.size() + post_pagerank_scores_.size() + betweenness_scores_.size() +
+            closeness_scores_.size();
+        clustered = clustering_.size();
+        samples = betweenness_samples_;
+        rounds = hyperball_rounds_;
+        component_entries = components_.size();
+        communities = community_members_.size();
+        components = component_summary_.weak;
+        strong_components = component_summary_.strong;
+        largest_component = component_summary_.largest_weak;
+        largest_strong_component = component_summary_.largest_strong;
+        clustering = clustering_summary_;
+        ranking_bytes = ranking_.capacity() * sizeof(RankEntry);
+        if (path_graph_) path_bytes = path_graph_->memory_bytes();
+    }
+    const RandomWalkIndex::Stats walk_stats = walks_.stats();
+
+    gauge("users", "", static_cast<double>(user_slots_.size()));
+    gauge("posts", "", static_cast<double>(post_slots_.size()));
+    gauge("follow_edges", "", static_cast<double>(follow_edges));
+    gauge("interaction_edges", "type=\"like\"", static_cast<double>(likes));
+    gauge("interaction_edges", "type=\"view\"", static_cast<double>(views));
+    gauge("interaction_windows", "", static_cast<double>(windows));
+    gauge("index_tokens", "", static_cast<double>(inverted_index_.size()));
+    gauge("index_postings", "", static_cast<double>(postings));
+    gauge("trie_nodes", "trie=\"usernames\"", static_cast<double>(username_trie_.node_count));
+    gauge("trie_nodes", "trie=\"post_tokens\"", static_cast<double>(post_content_trie_.node_count));
+    gauge("trie_words", "trie=\"usernames\"", static_cast<double>(username_trie_.word_count));
+    gauge("trie_words", "trie=\"post_tokens\"", static_cast<double>(post_content_trie_.word_count));
+    gauge("trending_capacity", "", static_cast<double>(trending_capacity_.load()));
+    gauge("triangles", "", static_cast<double>(clustering.triangles));
+    gauge("transitivity", "", clustering.transitivity);
+    gauge("components", "kind=\"weak\"", static_cast<double>(components));
+    gauge("components", "kind=\"strong\"", static_cast<double>(strong_components));
+    gauge("largest_component_users", "kind=\"weak\"", static_cast<double>(largest_component));
+    gauge("largest_component_users", "kind=\"strong\"", static_cast<double>(largest_strong_component));
+    gauge("betweenness_samples", "", static_cast<double>(samples));
+    gauge("hyperball_rounds", "", static_cast<double>(rounds));
+    gauge("walk_segments", "", static_cast<double>(walk_stats.segments));
+    gauge("walk_steps", "", static_cast<double>(walk_stats.steps));
+    gauge("walk_pending_changes", "", static_cast<double>(walk_stats.pending));
+    gauge("arena_live_bytes", "arena=\"post_text\"", static_cast<double>(post_text_.live_bytes()));
+    gauge("arena_live_bytes", "arena=\"lower_corpus\"", static_cast<double>(lower_corpus_.live_bytes()));
+    gauge("arena_garbage_bytes", "arena=\"post_text\"", static_cast<double>(post_text_.garbage_bytes()));
+    gauge("arena_garbage_bytes", "arena=\"lower_corpus\"", static_cast<double>(lower_corpus_.garbage_bytes()));
+    // Estimates from element counts and container capacities; node-based
+    // containers are charged a rough per-node overhead.
+    constexpr double kNodeBytes = 32.0;
+    auto memory = [&](const char *structure, double bytes) {
+        gauge("memory_bytes", string("structure=\"") + structure + "\"", bytes);
+    };
+    memory("post_columns", static_cast<double>(post_slots_.size()) *
+        (sizeof(int) + sizeof(ContentArena::Span) + sizeof(double) + 2 * sizeof(InteractionList) +
+         sizeof(HllSketch)));
+    memory("interaction_edges", static_cast<double>(edge_bytes));
+    memory("interaction_windows", static_cast<double>(windows) * (sizeof(int) + sizeof(float) + kNodeBytes) +
+        static_cast<double>(windows_.size() * sizeof(InteractionWindow)));
+    memory("view_sketches", static_cast<double>(sketch_bytes));
+    memory("author_reach", static_cast<double>(reach_bytes));
+    memory("follow_sets", static_cast<double>(2 * follow_edges) * (sizeof(int) + kNodeBytes));
+    memory("inverted_index", static_cast<double>(token_bytes) +
+        static_cast<double>(inverted_index_.size()) * (sizeof(string) + kNodeBytes) +
+        static_cast<double>(postings) * (sizeof(int) + kNodeBytes));
+    memory("tries", static_cast<double>(username_trie_.node_count + post_content_trie_.node_count) *
+        (sizeof(TrieNode) + 2 * kNodeBytes));
+    memory("scores", static_cast<double>(scored) * (sizeof(int) + sizeof(double) + kNodeBytes) +
+        static_cast<double>(ranking_bytes));
+    memory("clustering", static_cast<double>(clustered) * (sizeof(int) + sizeof(UserClustering) + kNodeBytes));
+    memory("components", static_cast<double>(component_entries) * (sizeof(int) + sizeof(UserComponents) + kNodeBytes));
+    memory("communities", static_cast<double>(communities) * (sizeof(int) + sizeof(vector<int>) + kNodeBytes) +
+        static_cast<double>(user_slots_.size() * sizeof(int)));
+    memory("path_weights", static_cast<double>(path_bytes));
+    memory("random_walks", static_cast<double>(walk_stats.memory_bytes));
+    lock_guard persist_lock(persist_mutex_);
+    if (replication_log_) {
+        gauge("replication_log_offset", "", static_cast<double>(replication_log_->end_offset()));
+        gauge("replication_log_retained_bytes", "", static_cast<double>(replication_log_->retained_bytes()));
+    }
+    return out;
+}
 
-    vector<int> user_ids;
-    user_ids.reserve(users_.size());
-    for (const auto &u : users_) user_ids.push_back(u.first);
+void Graph::set_metrics_enabled(bool enabled) {
+    metrics_.enabled.store(enabled);
+}
 
-    vector<int> post_ids;
-    post_ids.reserve(posts_.size());
-    for (const auto &p : posts_) post_ids.push_back(p.first);
+void Graph::reset_metrics() {
+    metrics_.reset();
+}
 
-    const size_t user_count = user_ids.size();
-    const size_t post_count = post_ids.size();
-    const double damping = 0.85;
-    const double epsilon = 1e-9;
-    const int max_iterations = 200;
+void Graph::recompute_analytics() {
+    auto timer = metrics_.time(GraphOp::RecomputeAnalytics);
+    lock_guard run_lock(analytics_run_mutex_);
+    recompute_analytics_unlocked();
+}
 
+// Caller holds analytics_run_mutex_ and no other lock. The graph locks are
+// held only while the inputs are copied out; everything after that runs on
+// the copy, and only the final swap takes the analytics lock.
+void Graph::recompute_analytics_unlocked() {
+    maybe_rebase_decay_epoch();
+    AnalyticsInput in;
+    {
+        shared_lock users_lock(users_mutex_);
+        shared_lock follow_lock(follow_mutex_);
+        shared_lock posts_lock(posts_mutex_);
+        auto stripe_locks = lock_post_stripes_shared();
+        in = copy_analytics_input_unlocked();
+    }
     unordered_map<int, double> user_scores;
     unordered_map<int, double> post_scores;
-    unordered_map<int, double> outgoing_user_weight;
+    const DenseIdMap &users = in.users;
+    // The path graph only reads what PageRank reads, so it is built alongside.
+    shared_ptr<const WeightedUserGraph> path_graph;
+    thread path_builder;
+    if (parallel_workers(users.size(), 4096) > 1) {
+        path_builder = thread([&] { path_graph = build_path_graph(in); });
+    } else {
+        path_graph = build_path_graph(in);
+    }
+    unordered_map<int, UserClustering> clustering;
+    const ClusteringSummary clustering_summary = compute_clustering(in, clustering);
+    unordered_map<int, UserComponents> components;
+    ComponentSummary component_summary = compute_components(in, components);
+    unordered_map<int, vector<int>> community_members;
+    for (auto &c : followee_communities(in.follows.offsets, in.follows.targets, users.ids())) {
+        community_members.emplace(c.first, move(c.second));
+    }
+    CentralityOptions centrality_options;
+    {
+        shared_lock analytics_lock(analytics_mutex_);
+        centrality_options = centrality_options_;
+    }
+    const CentralityScores centrality = compute_centrality(in.follows.offsets, in.follows.targets, centrality_options);
+    unordered_map<int, double> betweenness, closeness;
+    for (size_t u = 0; u < users.size(); ++u) {
+        if (centrality.betweenness[u] > 0.0) betweenness[users.id_at(u)] = centrality.betweenness[u];
+        if (centrality.closeness[u] > 0.0) closeness[users.id_at(u)] = centrality.closeness[u];
+    }
+    auto publish = [&]() {
+        if (path_builder.joinable()) path_builder.join();
+        vector<RankEntry> ranking;
+        ranking.reserve(user_scores.size());
+        for (const auto &s : user_scores) ranking.push_back({s.second, s.first});
+        sort(ranking.begin(), ranking.end(), ranks_higher<RankEntry>);
+        const int max_user_id = users.empty() ? 0 : users.ids().back();
+        // Users deleted since the copy are dropped here; holding users_mutex_
+        // through the swap keeps ranking_ to live users, so its size is exact.
+        shared_lock users_lock(users_mutex_);
+        ranking.erase(remove_if(ranking.begin(), ranking.end(),
+                                [&](const RankEntry &e) { return !user_slots_.contains(e.user_id); }), ranking.end());
+        unique_lock analytics_lock(analytics_mutex_);
+        pagerank_scores_ = move(user_scores);
+        post_pagerank_scores_ = move(post_scores);
+        ranking_ = move(ranking);
+        ranking_max_user_id_ = max_user_id;
+        path_graph_ = move(path_graph);
+        clustering_ = move(clustering);
+        clustering_summary_ = clustering_summary;
+        betweenness_scores_ = move(betweenness);
+        closeness_scores_ = move(closeness);
+        betweenness_samples_ = centrality.samples;
+        hyperball_rounds_ = centrality.rounds;
+        components_ = move(components);
+        component_summary_ = move(component_summary);
+        community_members_ = move(community_members);
+        ++analytics_version_;
+    };
+
+    const size_t user_count = users.size();
+    const size_t post_count = in.posts.size();
+    if (user_count == 0) {
+        publish();
+        return;
+    }
+
+    const double damping = 0.85;
+    const double epsilon = 1e-9;
+    const int max_iterations = 200;
 
-    for (int uid : user_ids) user_scores[uid] = 1.0 / static_cast<double>(user_count);
+    // Iterate over slot-indexed arrays; ids only come back in at publish time.
+    vector<double> user_rank(user_count, 1.0 / static_cast<double>(user_count));
+    auto publish_ranks = [&](const vector<double> &post_rank) {
+        user_scores.reserve(user_count);
+        for (size_t u = 0; u < user_count; ++u) user_scores[users.id_at(u)] = user_rank[u];
+        post_scores.reserve(post_rank.size());
+        for (size_t p = 0; p < post_rank.size(); ++p) post_scores[in.posts.id_at(p)] = post_rank[p];
+        publish();
+    };
     if (post_count == 0) {
-        pagerank_scores_ = user_scores;
-        rebuild_top_k_unlocked();
+        publish_ranks({});
         return;
     }
 
-    for (int pid : post_ids) {
-        post_scores[pid] = 1.0 / static_cast<double>(post_count);
-        const double interaction_weight = post_interaction_weight_unlocked(posts_.at(pid), now);
-        post_interaction_weights_[pid] = interaction_weight;
-        for (const auto &like : posts_.at(pid).likes) {
-            outgoing_user_weight[like.first] += like.second.weight * decay_factor(like.second.timestamp, now);
-        }
-        for (const auto &view : posts_.at(pid).views) {
-            outgoing_user_weight[view.first] += view.second.weight * decay_factor(view.second.timestamp, now);
+    // Landmarks all share the factor 2^(-(now - epoch) / half-life), which
+    // cancels in each edge's share of its user's outgoing weight, so the
+    // decayed transition shares need no exp() at all.
+    vector<double> outgoing_user_weight(user_count, 0.0);
+    for (const auto &e : in.interactions) outgoing_user_weight[e.user_slot] += e.landmark;
+    struct EdgeShare {
+        int post_slot;
+        int user_slot;
+        double share;  // fraction of the user's outgoing weight on this edge
+    };
+    vector<EdgeShare> edges;
+    for (const auto &e : in.interactions) {
+        const double outgoing = outgoing_user_weight[e.user_slot];
+        if (e.landmark > 0.0 && outgoing > 0.0) {
+            edges.push_back({static_cast<int>(e.post_slot), static_cast<int>(e.user_slot), e.landmark / outgoing});
         }
     }
-
-    for (int iteration = 0; iteration < max_iterations; ++iteration) {
-        unordered_map<int, double> next_post_scores;
+    vector<double> view_boost(post_count);
+    for (size_t p = 0; p < post_count; ++p) view_boost[p] = 1.0 + 0.05 * log1p(max(0.0, in.unique_viewers[p]));
+    const vector<int> &author_slot = in.author_slot;
+
+    vector<double> post_rank(post_count, 1.0 / static_cast<double>(post_count));
+    vector<double> next_post_rank(post_count);
+    vector<double> next_user_rank(user_count);
+    int iterations = 0;
+    double residual = 0.0;
+    while (iterations < max_iterations) {
+        ++iterations;
         double dangling_user_mass = 0.0;
-        for (int uid : user_ids) {
-            if (outgoing_user_weight[uid] <= 0.0) dangling_user_mass += user_scores[uid];
+        for (size_t u = 0; u < user_count; ++u) {
+            if (outgoing_user_weight[u] <= 0.0) dangling_user_mass += user_rank[u];
         }
 
         const double post_base =
             (1.0 - damping) / static_cast<double>(post_count) +
             damping * dangling_user_mass / static_cast<double>(post_count);
-        for (int pid : post_ids) next_post_scores[pid] = post_base;
-
-        for (int pid : post_ids) {
-            const auto &post = posts_.at(pid);
-            for (const auto &like : post.likes) {
-                const double effective_weight =
-                    like.second.weight * decay_factor(like.second.timestamp, now);
-                if (effective_weight > 0.0 && outgoing_user_weight[like.first] > 0.0) {
-                    next_post_scores[pid] +=
-                        damping * user_scores[like.first] * effective_weight / outgoing_user_weight[like.first];
-                }
-            }
-            for (const auto &view : post.views) {
-                const double effective_weight =
-                    view.second.weight * decay_factor(view.second.timestamp, now);
-                if (effective_weight > 0.0 && outgoing_user_weight[view.first] > 0.0) {
-                    next_post_scores[pid] +=
-                        damping * user_scores[view.first] * effective_weight / outgoing_user_weight[view.first];
-                }
-            }
+        fill(next_post_rank.begin(), next_post_rank.end(), post_base);
+
+        for (const auto &edge : edges) {
+            next_post_rank[edge.post_slot] += damping * user_rank[edge.user_slot] * edge.share;
         }
 
         double boosted_sum = 0.0;
-        for (int pid : post_ids) {
-            const double unique_views = posts_.at(pid).unique_viewers.estimate();
-            const double boost = 1.0 + 0.05 * log1p(max(0.0, unique_views));
-            next_post_scores[pid] *= boost;
-            boosted_sum += next_post_scores[pid];
+        for (size_t p = 0; p < post_count; ++p) {
+            next_post_rank[p] *= view_boost[p];
+            boosted_sum += next_post_rank[p];
         }
         if (boosted_sum > 0.0) {
-            for (int pid : post_ids) next_post_scores[pid] /= boosted_sum;
+            for (double &r : next_post_rank) r /= boosted_sum;
         }
 
-        unordered_map<int, double> next_user_scores;
         const double user_base = (1.0 - damping) / static_cast<double>(user_count);
-        for (int uid : user_ids) next_user_scores[uid] = user_base;
-        for (int pid : post_ids) {
-            const int author = posts_.at(pid).user_id;
-            if (user_exists_unlocked(author)) {
-                next_user_scores[author] += damping * next_post_scores[pid];
-            }
+        fill(next_user_rank.begin(), next_user_rank.end(), user_base);
+        for (size_t p = 0; p < post_count; ++p) {
+            if (author_slot[p] >= 0) next_user_rank[author_slot[p]] += damping * next_post_rank[p];
         }
 
         double delta = 0.0;
-        for (int uid : user_ids) delta += fabs(next_user_scores[uid] - user_scores[uid]);
-        for (int pid : post_ids) delta += fabs(next_post_scores[pid] - post_scores[pid]);
+        for (size_t u = 0; u < user_count; ++u) delta += fabs(next_user_rank[u] - user_rank[u]);
+        for (size_t p = 0; p < post_count; ++p) delta += fabs(next_post_rank[p] - post_rank[p]);
 
-        user_scores.swap(next_user_scores);
-        post_scores.swap(next_post_scores);
+        user_rank.swap(next_user_rank);
+        post_rank.swap(next_post_rank);
+        residual = delta;
         if (delta < epsilon) break;
     }
 
-    pagerank_scores_ = move(user_scores);
-    post_pagerank_scores_ = move(post_scores);
-    rebuild_top_k_unlocked();
+    metrics_.record_pagerank(iterations, residual, residual < epsilon, edges.size());
+    publish_ranks(post_rank);
+}
+
+// Caller holds users/follows/posts/stripes (shared is enough).
+Graph::AnalyticsInput Graph::copy_analytics_input_unlocked() const {
+    AnalyticsInput in;
+    in.follows_version = follows_version_;
+    in.users = user_slots_;
+    in.follows = follow_slots_unlocked();
+    in.posts = post_slots_;
+    in.decay_scale = decay_scale(current_epoch_seconds());
+    const size_t post_count = post_slots_.size();
+    in.author_slot.resize(post_count);
+    in.unique_viewers.resize(post_count);
+    size_t edge_count = 0;
+    for (size_t p = 0; p < post_count; ++p) edge_count += posts_.likes[p].size() + posts_.views[p].size();
+    in.interactions.reserve(edge_count);
+    for (size_t p = 0; p < post_count; ++p) {
+        in.author_slot[p] = user_slots_.slot(posts_.author[p]);
+        in.unique_viewers[p] = posts_.unique_viewers[p].estimate();
+        for (const auto *interactions : {&posts_.likes[p], &posts_.views[p]}) {
+            for (const auto &e : *interactions) {
+                const int u = user_slots_.slot(e.user_id);
+                if (u >= 0) in.interactions.push_back({static_cast<uint32_t>(p), static_cast<uint32_t>(u), e.landmark});
+            }
+        }
+    }
+    return in;
+}
+
+// Caller holds users/follows (shared is enough).
+Graph::FollowSlots Graph::follow_slots_unlocked() const {
+    const size_t n = user_slots_.size();
+    FollowSlots follows;
+    follows.offsets.assign(n + 1, 0);
+    for (const auto &f : followees_) {
+        const int from = user_slots_.slot(f.first);
+        if (from >= 0) follows.offsets[from + 1] = f.second.size();
+    }
+    for (size_t u = 0; u < n; ++u) follows.offsets[u + 1] += follows.offsets[u];
+    follows.targets.resize(follows.offsets[n]);
+    vector<size_t> filled(n, 0);
+    for (const auto &f : followees_) {
+        const int from = user_slots_.slot(f.first);
+        if (from < 0) continue;
+        size_t at = follows.offsets[from];
+        for (int b : f.second) {
+            const int to = user_slots_.slot(b);
+            if (to >= 0) follows.targets[at++] = static_cast<uint32_t>(to);
+        }
+        filled[from] = at - follows.offsets[from];
+    }
+    // Follows of users that are gone leave gaps; close them.
+    size_t packed = 0;
+    for (size_t u = 0; u < n; ++u) {
+        const size_t from = follows.offsets[u];
+        follows.offsets[u] = packed;
+        if (packed != from) {
+            copy(follows.targets.begin() + static_cast<ptrdiff_t>(from),
+                 follows.targets.begin() + static_cast<ptrdiff_t>(from + filled[u]),
+                 follows.targets.begin() + static_cast<ptrdiff_t>(packed));
+        }
+        packed += filled[u];
+    }
+    follows.offsets[n] = packed;
+    follows.targets.resize(packed);
+    return follows;
+}
+
+
+shared_ptr<const WeightedUserGraph> Graph::build_path_graph(const AnalyticsInput &in) {
+    // Collect every follow and interaction in one sweep, bucket them by
+    // source slot (counting sort), then sort and merge each source's short
+    // list by target.
+    struct Tie {
+        uint32_t from;
+        uint32_t to;
+        double strength;
+    };
+    const FollowSlots &follows = in.follows;
+    const size_t user_count = in.users.size();
+    vector<Tie> collected;
+    collected.reserve(follows.targets.size() + in.interactions.size());
+    for (size_t u = 0; u < user_count; ++u) {
+        for (size_t i = follows.offsets[u]; i < follows.offsets[u + 1]; ++i) {
+            collected.push_back({static_cast<uint32_t>(u), follows.targets[i], 1.0});
+        }
+    }
+    for (const auto &e : in.interactions) {
+        const int author = in.author_slot[e.post_slot];
+        if (author < 0 || e.user_slot == static_cast<uint32_t>(author) || e.landmark <= 0.0) continue;
+        collected.push_back({e.user_slot, static_cast<uint32_t>(author), e.landmark * in.decay_scale});
+    }
+    vector<size_t> offsets(user_count + 1, 0);
+    for (const Tie &t : collected) ++offsets[t.from + 1];
+    for (size_t u = 0; u < user_count; ++u) offsets[u + 1] += offsets[u];
+    vector<pair<uint32_t, double>> ties(collected.size());  // (target slot, strength)
+    {
+        vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (const Tie &t : collected) ties[next[t.from]++] = {t.to, t.strength};
+    }
+    collected = vector<Tie>();
+
+    vector<WeightedUserGraph::Edge> edges;
+    edges.reserve(ties.size());
+    for (size_t u = 0; u < user_count; ++u) {
+        const auto begin = ties.begin() + static_cast<ptrdiff_t>(offsets[u]);
+        const auto end = ties.begin() + static_cast<ptrdiff_t>(offsets[u + 1]);
+        sort(begin, end, [](const auto &a, const auto &b) { return a.first < b.first; });
+        for (auto it = begin; it != end;) {
+            const uint32_t to = it->first;
+            double total = 0.0;
+            for (; it != end && it->first == to; ++it) total += it->second;
+            if (total > 0.0) edges.push_back({static_cast<uint32_t>(u), to, 1.0 / total});
+        }
+    }
+    return make_shared<const WeightedUserGraph>(in.users, edges);
+}
+
+Graph::ClusteringSummary Graph::compute_clustering(const AnalyticsInput &in, unordered_map<int, UserClustering> &users) {
+    // Undirected adjacency by slot: each follow listed at both ends, then
+    // every user's list sorted, deduplicated (mutual follows) and packed.
+    const FollowSlots &follows = in.follows;
+    const size_t n = in.users.size();
+    vector<size_t> offsets(n + 1, 0);
+    for (size_t u = 0; u < n; ++u) {
+        for (size_t i = follows.offsets[u]; i < follows.offsets[u + 1]; ++i) {
+            if (follows.targets[i] == u) continue;
+            ++offsets[u + 1];
+            ++offsets[follows.targets[i] + 1];
+        }
+    }
+    for (size_t u = 0; u < n; ++u) offsets[u + 1] += offsets[u];
+    vector<uint32_t> neighbours(offsets[n]);
+    {
+        vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t u = 0; u < n; ++u) {
+            for (size_t i = follows.offsets[u]; i < follows.offsets[u + 1]; ++i) {
+                const uint32_t v = follows.targets[i];
+                if (v == u) continue;
+                neighbours[next[u]++] = v;
+                neighbours[next[v]++] = static_cast<uint32_t>(u);
+            }
+        }
+    }
+    vector<size_t> degree(n, 0);
+    parallel_for_ranges(n, parallel_workers(neighbours.size(), 1 << 16), [&](size_t, size_t begin, size_t end) {
+        for (size_t u = begin; u < end; ++u) {
+            const auto first = neighbours.begin() + static_cast<ptrdiff_t>(offsets[u]);
+            const auto last = neighbours.begin() + static_cast<ptrdiff_t>(offsets[u + 1]);
+            sort(first, last);
+            degree[u] = static_cast<size_t>(unique(first, last) - first);
+        }
+    });
+    size_t packed = 0;
+    for (size_t u = 0; u < n; ++u) {
+        const size_t from = offsets[u];
+        offsets[u] = packed;
+        copy(neighbours.begin() + static_cast<ptrdiff_t>(from),
+             neighbours.begin() + static_cast<ptrdiff_t>(from + degree[u]),
+             neighbours.begin() + static_cast<ptrdiff_t>(packed));
+        packed += degree[u];
+    }
+    offsets[n] = packed;
+    neighbours.resize(packed);
+
+    const TriangleCounts counts = count_triangles(offsets, neighbours);
+    ClusteringSummary summary;
+    summary.triangles = counts.triangles;
+    summary.wedges = counts.wedges;
+    if (counts.wedges > 0) {
+        summary.transitivity = 3.0 * static_cast<double>(counts.triangles) / static_cast<double>(counts.wedges);
+    }
+    double coefficient_sum = 0.0;
+    for (size_t v = 0; v < n; ++v) {
+        if (counts.per_vertex[v] == 0) continue;
+        const double coefficient = TriangleCounts::local_clustering(counts.per_vertex[v], degree[v]);
+        users.emplace(in.users.id_at(v), UserClustering{counts.per_vertex[v], coefficient});
+        coefficient_sum += coefficient;
+    }
+    if (n > 0) summary.average_clustering = coefficient_sum / static_cast<double>(n);
+    return summary;
+}
+
+// Also resets follow_components_ to the exact components, unless follows
+// changed since the copy: the live union-find then has edges the copy lacks.
+Graph::ComponentSummary Graph::compute_components(const AnalyticsInput &in, unordered_map<int, UserComponents> &users) {
+    const FollowSlots &follows = in.follows;
+    const DenseIdMap &user_slots = in.users;
+    const ComponentLabels weak = weak_components(follows.offsets, follows.targets);
+    const ComponentLabels strong = strong_components(follows.offsets, follows.targets);
+    {
+        shared_lock follow_lock(follow_mutex_);
+        if (follows_version_ == in.follows_version) follow_components_.reset(user_slots.ids(), weak);
+    }
+
+    // Slots run in id order, so a component's first slot holds its lowest id.
+    auto lowest_ids = [&](const ComponentLabels &labels) {
+        vector<int> lowest(labels.sizes.size(), -1);
+        for (size_t u = 0; u < labels.of.size(); ++u) {
+            if (lowest[labels.of[u]] < 0) lowest[labels.of[u]] = user_slots.id_at(u);
+        }
+        return lowest;
+    };
+    const vector<int> weak_ids = lowest_ids(weak), strong_ids = lowest_ids(strong);
+    users.reserve(user_slots.size());
+    for (size_t u = 0; u < user_slots.size(); ++u) {
+        users.emplace(user_slots.id_at(u), UserComponents{weak_ids[weak.of[u]], strong_ids[strong.of[u]]});
+    }
+    ComponentSummary summary;
+    summary.weak = weak.sizes.size();
+    summary.strong = strong.sizes.size();
+    if (!weak.sizes.empty()) summary.largest_weak = *max_element(weak.sizes.begin(), weak.sizes.end());
+    if (!strong.sizes.empty()) summary.largest_strong = *max_element(strong.sizes.begin(), strong.sizes.end());
+    summary.weak_sizes = size_histogram(weak.sizes);
+    summary.strong_sizes = size_histogram(strong.sizes);
+    return summary;
+}
+
+Graph::ComponentSummary Graph::component_summary() {
+    shared_lock analytics_lock(analytics_mutex_);
+    return component_summary_;
+}
+
+Graph::ClusteringSummary Graph::clustering_summary() {
+    shared_lock analytics_lock(analytics_mutex_);
+    return clustering_summary_;
+}
+
+vector<pair<int, double>> Graph::top_brokers(size_t k) {
+    shared_lock analytics_lock(analytics_mutex_);
+    vector<pair<int, double>> out(betweenness_scores_.begin(), betweenness_scores_.end());
+    auto better = [](const pair<int, double> &a, const pair<int, double> &b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    };
+    if (out.size() > k) {
+        nth_element(out.begin(), out.begin() + static_cast<ptrdiff_t>(k), out.end(), better);
+        out.resize(k);
+    }
+    sort(out.begin(), out.end(), better);
+    return out;
+}
+
+void Graph::set_centrality_options(const CentralityOptions &options) {
+    unique_lock analytics_lock(analytics_mutex_);
+    centrality_options_ = options;
 }
 
 Graph::UserMetrics Graph::get_user_metrics(int user_id) {
-    shared_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::UserMetrics);
+    shared_lock users_lock(users_mutex_);
     UserMetrics m;
-    if (!users_.count(user_id)) return m;
-    m.followers = (int)followers_for_unlocked(user_id).size();
-    m.followings = (int)followees_for_unlocked(user_id).size();
+    if (!user_exists_unlocked(user_id)) return m;
+    {
+        shared_lock follow_lock(follow_mutex_);
+        m.followers = (int)followers_for_unlocked(user_id).size();
+        m.followings = (int)followees_for_unlocked(user_id).size();
+    }
     m.posts = 0; m.total_likes = 0;
-    for (auto &p : posts_) if (p.second.user_id == user_id) { m.posts++; m.total_likes += (int)p.second.likes.size(); }
+    {
+        shared_lock posts_lock(posts_mutex_);
+        auto stripe_locks = lock_post_stripes_shared();
+        for (size_t s = 0; s < post_slots_.size(); ++s) {
+            if (posts_.author[s] != user_id) continue;
+            m.posts++;
+            m.total_likes += (int)posts_.likes[s].size();
+        }
+        lock_guard reach_lock(reach_mutex_);
+        auto it = author_reach_.find(user_id);
+        if (it != author_reach_.end()) m.unique_reach = static_cast<uint64_t>(llround(it->second.estimate()));
+    }
+    shared_lock analytics_lock(analytics_mutex_);
     m.score = pagerank_scores_.count(user_id) ? pagerank_scores_[user_id] : 0.0;
+    auto clustering = clustering_.find(user_id);
+    if (clustering != clustering_.end()) {
+        m.triangles = clustering->second.triangles;
+        m.clustering = clustering->second.coefficient;
+    }
+    auto betweenness = betweenness_scores_.find(user_id);
+    if (betweenness != betweenness_scores_.end()) m.betweenness = betweenness->second;
+    auto closeness = closeness_scores_.find(user_id);
+    if (closeness != closeness_scores_.end()) m.closeness = closeness->second;
+    auto components = components_.find(user_id);
+    if (components != components_.end()) {
+        m.weak_component = components->second.weak;
+        m.strong_component = components->second.strong;
+    }
     return m;
 }
 
-vector<int> Graph::get_followers(int user_id) { shared_lock lock(mutex_); vector<int> out; for (int u : followers_for_unlocked(user_id)) out.push_back(u); sort(out.begin(), out.end()); return out; }
-vector<int> Graph::get_followings(int user_id) { shared_lock lock(mutex_); vector<int> out; for (int u : followees_for_unlocked(user_id)) out.push_back(u); sort(out.begin(), out.end()); return out; }
-vector<int> Graph::get_liked_posts(int user_id) { shared_lock lock(mutex_); vector<int> out; for (auto &p : posts_) if (p.second.likes.count(user_id)) out.push_back(p.second.id); return out; }
-vector<int> Graph::get_user_posts(int user_id) { shared_lock lock(mutex_); vector<int> out; for (auto &p : posts_) if (p.second.user_id == user_id) out.push_back(p.second.id); return out; }
+vector<int> Graph::get_followers(int user_id) { shared_lock lock(follow_mutex_); vector<int> out; for (int u : followers_for_unlocked(user_id)) out.push_back(u); sort(out.begin(), out.end()); return out; }
+vector<int> Graph::get_followings(int user_id) { shared_lock lock(follow_mutex_); vector<int> out; for (int u : followees_for_unlocked(user_id)) out.push_back(u); sort(out.begin(), out.end()); return out; }
+vector<int> Graph::get_liked_posts(int user_id) {
+    shared_lock lock(posts_mutex_);
+    auto stripe_locks = lock_post_stripes_shared();
+    vector<int> out;
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        const auto &likes = posts_.likes[s];
+        auto it = interaction_lower_bound(likes, user_id);
+        if (it != likes.end() && it->user_id == user_id) out.push_back(post_slots_.id_at(s));
+    }
+    return out;
+}
+vector<int> Graph::get_user_posts(int user_id) { shared_lock lock(posts_mutex_); vector<int> out; for (size_t s = 0; s < post_slots_.size(); ++s) if (posts_.author[s] == user_id) out.push_back(post_slots_.id_at(s)); return out; }
 
 vector<RankedUser> Graph::get_ranked(int page, int limit) {
-    shared_lock lock(mutex_);
-    vector<RankedUser> all;
-    for (auto &u : users_) { RankedUser r; r.first = u.first; r.second = u.second; r.third = pagerank_scores_.count(u.first) ? pagerank_scores_[u.first] : 0.0; all.push_back(r); }
-    sort(all.begin(), all.end(), [](const RankedUser &a, const RankedUser &b){
-        if (a.third != b.third) return a.third > b.third;
-        return a.first < b.first;
-    });
-    int start = (page - 1) * limit; if (start < 0) start = 0; if (start >= (int)all.size()) return {};
-    int end = min((int)all.size(), start + limit);
-    return vector<RankedUser>(all.begin() + start, all.begin() + end);
+    auto timer = metrics_.time(GraphOp::GetRanked);
+    if (limit <= 0) return {};
+    shared_lock users_lock(users_mutex_);
+    shared_lock analytics_lock(analytics_mutex_);
+    const long long start = max(0LL, static_cast<long long>(page - 1) * limit);
+    return ranked_range_unlocked(static_cast<size_t>(start), static_cast<size_t>(limit));
+}
+
+RankedPage Graph::get_ranked_after(const string &cursor, int limit) {
+    auto timer = metrics_.time(GraphOp::GetRanked);
+    RankedPage page;
+    if (limit <= 0) return page;
+    shared_lock users_lock(users_mutex_);
+    shared_lock analytics_lock(analytics_mutex_);
+    size_t position = 0;
+    double score = 0.0;
+    int after_id = 0;
+    if (decode_rank_cursor(cursor, score, after_id)) {
+        if (after_id > ranking_max_user_id_) {
+            // inside the unranked tail, which is in id order
+            const size_t tail_begin = user_slots_.lower_bound_slot(ranking_max_user_id_ + 1);
+            position = ranking_.size() + (user_slots_.lower_bound_slot(after_id + 1) - tail_begin);
+        } else {
+            position = static_cast<size_t>(upper_bound(ranking_.begin(), ranking_.end(), RankEntry{score, after_id},
+                                                       ranks_higher<RankEntry>) - ranking_.begin());
+        }
+    }
+    page.users = ranked_range_unlocked(position, static_cast<size_t>(limit));
+    if (!page.users.empty() && position + page.users.size() < ranked_count_unlocked()) {
+        page.next_cursor = encode_rank_cursor(page.users.back().third, page.users.back().first);
+    }
+    return page;
+}
+
+// Caller holds users_mutex_ and analytics_mutex_ (shared is enough).
+size_t Graph::ranked_count_unlocked() const {
+    return ranking_.size() + (user_slots_.size() - user_slots_.lower_bound_slot(ranking_max_user_id_ + 1));
 }
 
-vector<PostInfo> Graph::top_posts() {
-    shared_lock lock(mutex_);
-    auto heap = top_k_posts_;
+// Rows [position, position + limit) of ranking_ followed by the users who
+// joined after it was published (score 0, id order). Caller holds users_mutex_
+// and analytics_mutex_ (shared is enough).
+vector<RankedUser> Graph::ranked_range_unlocked(size_t position, size_t limit) const {
+    vector<RankedUser> out;
+    const size_t tail_begin = user_slots_.lower_bound_slot(ranking_max_user_id_ + 1);
+    for (size_t p = position; out.size() < limit; ++p) {
+        if (p < ranking_.size()) {
+            const RankEntry &e = ranking_[p];
+            const int slot = user_slots_.slot(e.user_id);
+            if (slot >= 0) out.push_back({e.user_id, usernames_[slot], e.score});
+            continue;
+        }
+        const size_t slot = tail_begin + (p - ranking_.size());
+        if (slot >= user_slots_.size()) break;
+        out.push_back({user_slots_.id_at(slot), usernames_[slot], 0.0});
+    }
+    return out;
+}
+
+shared_ptr<const vector<TrendingEntry>> Graph::trending_posts(size_t k) {
+    auto timer = metrics_.time(GraphOp::TrendingPosts);
+    k = min(k, kMaxTrendingCapacity);
+    size_t capacity = trending_capacity_.load();
+    while (capacity < k && !trending_capacity_.compare_exchange_weak(capacity, k)) {}
+    if (capacity < k) trending_dirty_.store(true);
+
+    auto current = atomic_load(&trending_published_);
+    if (current && !trending_dirty_.load()) return current;
+
+    unique_lock publish_lock(trending_publish_mutex_, try_to_lock);
+    if (!publish_lock.owns_lock()) {
+        // another reader is already merging; the previous array is good enough if it is long enough
+        if (current && current->size() >= k) return current;
+        publish_lock.lock();
+    }
+
+    trending_dirty_.store(false);  // writes from here on dirty it again
+    auto next = make_shared<vector<TrendingEntry>>();
+    const size_t keep = trending_capacity_.load();
+    {
+        shared_lock posts_lock(posts_mutex_);
+        auto stripe_locks = lock_post_stripes_shared();
+        for (const auto &heap : trending_heaps_) heap.top(keep, *next);
+    }
+    const size_t n = min(keep, next->size());
+    partial_sort(next->begin(), next->begin() + n, next->end(), TrendingHeap::ranks_before);
+    next->resize(n);
+    shared_ptr<const vector<TrendingEntry>> published = move(next);
+    atomic_store(&trending_published_, published);
+    return published;
+}
+
+vector<PostInfo> Graph::top_posts(size_t k) {
+    auto timer = metrics_.time(GraphOp::TopPosts);
+    const auto ranked = trending_posts(k);
     vector<PostInfo> out;
-    out.reserve(heap.size());
-    while (!heap.empty()) {
-        const auto entry = heap.top();
-        heap.pop();
-        auto it = posts_.find(entry.post_id);
-        if (it == posts_.end()) continue;
-        out.push_back({
-            it->second.id,
-            it->second.user_id,
-            static_cast<int>(it->second.likes.size()),
-            static_cast<uint64_t>(llround(it->second.unique_viewers.estimate())),
-            entry.score,
-            post_interaction_weights_.count(entry.post_id) ? post_interaction_weights_.at(entry.post_id) : 0.0,
-            it->second.content
+    out.reserve(min(k, ranked->size()));
+    {
+        shared_lock posts_lock(posts_mutex_);
+        const double scale = decay_scale(current_epoch_seconds());
+        for (const auto &entry : *ranked) {
+            if (out.size() >= k) break;
+            const int slot = post_slots_.slot(entry.post_id);
+            if (slot < 0) continue;
+            shared_lock stripe_lock(post_stripe(entry.post_id));
+            out.push_back(post_info_unlocked(slot, posts_.decayed_weight[slot] * scale));
+        }
+    }
+    shared_lock analytics_lock(analytics_mutex_);
+    for (auto &pi : out) {
+        auto score = post_pagerank_scores_.find(pi.post_id);
+        if (score != post_pagerank_scores_.end()) pi.score = score->second;
+    }
+    return out;
+}
+
+vector<PostInfo> Graph::trending_window(int64_t window_seconds, size_t k) {
+    auto timer = metrics_.time(GraphOp::TrendingWindow);
+    const int64_t now = current_epoch_seconds();
+    vector<PostInfo> out;
+    {
+        shared_lock posts_lock(posts_mutex_);
+        // Copy out the (post, hour weight) entries inside the window one stripe
+        // at a time and sum them per slot outside the stripe lock; only posts
+        // active in range are touched. Hours come oldest first within a post.
+        vector<double> sums(post_slots_.size(), 0.0);
+        vector<bool> seen(post_slots_.size());
+        vector<size_t> touched;
+        vector<pair<int, float>> active;
+        for (size_t i = 0; i < kPostStripes; ++i) {
+            active.clear();
+            {
+                shared_lock stripe_lock(post_stripes_[i]);
+                windows_[i].collect(now, window_seconds, active);
+            }
+            for (const auto &[post_id, weight] : active) {
+                const int slot = post_slots_.slot(post_id);
+                if (slot < 0) continue;
+                if (!seen[slot]) {
+                    seen[slot] = true;
+                    touched.push_back(slot);
+                }
+                sums[slot] += weight;
+            }
+        }
+        vector<pair<double, size_t>> scored;  // (weight, slot)
+        for (size_t slot : touched) {
+            if (sums[slot] > 0.0) scored.emplace_back(sums[slot], slot);
+        }
+        const size_t n = min(k, scored.size());
+        partial_sort(scored.begin(), scored.begin() + n, scored.end(), [](const auto &a, const auto &b) {
+            if (a.first != b.first) return a.first > b.first;
+            return a.second < b.second;  // slot order is id order
         });
+        out.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            shared_lock stripe_lock(post_stripe(post_slots_.id_at(scored[i].second)));
+            out.push_back(post_info_unlocked(scored[i].second, scored[i].first));
+        }
+    }
+    shared_lock analytics_lock(analytics_mutex_);
+    for (auto &pi : out) {
+        auto score = post_pagerank_scores_.find(pi.post_id);
+        if (score != post_pagerank_scores_.end()) pi.score = score->second;
     }
-    sort(out.begin(), out.end(), [](const PostInfo &a, const PostInfo &b){
-        if (a.score != b.score) return a.score > b.score;
-        return a.post_id < b.post_id;
-    });
     return out;
 }
 
 vector<PostInfo> Graph::all_posts() {
-    shared_lock lock(mutex_);
     vector<PostInfo> all;
-    for (auto &p : posts_) {
-        PostInfo pi;
-        pi.post_id = p.second.id;
-        pi.user_id = p.second.user_id;
-        pi.likes = static_cast<int>(p.second.likes.size());
-        pi.unique_views = static_cast<uint64_t>(llround(p.second.unique_viewers.estimate()));
-        pi.score = post_pagerank_scores_.count(p.first) ? post_pagerank_scores_.at(p.first) : 0.0;
-        pi.interaction_weight = post_interaction_weights_.count(p.first) ? post_interaction_weights_.at(p.first) : 0.0;
-        pi.content = p.second.content;
-        all.push_back(pi);
-    }
-    sort(all.begin(), all.end(), [](const PostInfo &a, const PostInfo &b){ return a.post_id < b.post_id; });
+    for_each_post([&](const PostView &v) {
+        all.push_back({v.post_id, v.user_id, v.likes, v.unique_views, v.score, v.interaction_weight, string(v.content)});
+        return true;
+    });
     return all;
 }
 
-void Graph::rebuild_top_k_unlocked() {
-    top_k_posts_ = decltype(top_k_posts_)();
-    for (const auto &p : posts_) {
-        const double score = post_pagerank_scores_.count(p.first) ? post_pagerank_scores_.at(p.first) : 0.0;
-        TrendingEntry entry{score, p.first};
-        if (top_k_posts_.size() < top_k_limit_) {
-            top_k_posts_.push(entry);
-        } else {
-            const auto &minimum = top_k_posts_.top();
-            if (entry.score > minimum.score ||
-                (entry.score == minimum.score && entry.post_id < minimum.post_id)) {
-                top_k_posts_.pop();
-                top_k_posts_.push(entry);
+size_t Graph::for_each_post(const function<bool(const PostView &)> &visit, const PostScanOptions &options) {
+    auto timer = metrics_.time(GraphOp::ScanPosts);
+    using Field = PostScanOptions::Field;
+    const unsigned fields = options.fields;
+    const bool wants_interactions = fields & (Field::Likes | Field::UniqueViews | Field::InteractionWeight);
+
+    // Copy only the requested scalar columns, and pin the text chunks instead
+    // of copying content; the visit below runs without any lock held.
+    vector<PostView> rows;
+    vector<ContentArena::Span> spans;
+    ContentArena::Pinned text;
+    {
+        shared_lock posts_lock(posts_mutex_);
+        vector<shared_lock<Mutex>> stripe_locks;
+        if (wants_interactions) stripe_locks = lock_post_stripes_shared();
+        const size_t begin = post_slots_.lower_bound_slot(max(0, options.min_post_id));
+        const size_t end = options.max_post_id == numeric_limits<int>::max()
+            ? post_slots_.size() : post_slots_.lower_bound_slot(options.max_post_id + 1);
+        const double scale = decay_scale(current_epoch_seconds());
+        for (size_t s = begin; s < end; ++s) {
+            if (options.author_id >= 0 && posts_.author[s] != options.author_id) continue;
+            PostView v;
+            v.post_id = post_slots_.id_at(s);
+            v.user_id = posts_.author[s];
+            if (fields & Field::Likes) v.likes = static_cast<int>(posts_.likes[s].size());
+            if (fields & Field::UniqueViews) v.unique_views = static_cast<uint64_t>(llround(posts_.unique_viewers[s].estimate()));
+            if (fields & Field::InteractionWeight) v.interaction_weight = posts_.decayed_weight[s] * scale;
+            rows.push_back(v);
+            if (fields & Field::Content) spans.push_back(posts_.content[s]);
+        }
+        if (fields & Field::Content) text = post_text_.pin();
+    }
+    if (fields & Field::Score) {
+        shared_lock analytics_lock(analytics_mutex_);
+        for (auto &v : rows) {
+            auto score = post_pagerank_scores_.find(v.post_id);
+            if (score != post_pagerank_scores_.end()) v.score = score->second;
+        }
+    }
+
+    size_t visited = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (fields & Field::Content) rows[i].content = text.view(spans[i]);
+        ++visited;
+        if (!visit(rows[i])) break;
+    }
+    return visited;
+}
+
+shared_ptr<const GraphSnapshot> Graph::snapshot() {
+    return take_snapshot(true);
+}
+
+shared_ptr<const GraphSnapshot> Graph::follow_snapshot() {
+    return take_snapshot(false);
+}
+
+// A follow-only snapshot locks and copies nothing beyond users and follows,
+// so likes and views (which only touch post stripes) never make follow-graph
+// queries rebuild or wait for the post columns. Parts still current in
+// either cached snapshot are shared rather than copied again.
+shared_ptr<const GraphSnapshot> Graph::take_snapshot(bool full) {
+    auto timer = metrics_.time(GraphOp::Snapshot);
+    lock_guard snapshot_lock(snapshot_mutex_);
+    shared_lock users_lock(users_mutex_);
+    shared_lock follow_lock(follow_mutex_);
+    shared_lock posts_lock(posts_mutex_, defer_lock);
+    vector<shared_lock<Mutex>> stripe_locks;
+    shared_lock analytics_lock(analytics_mutex_, defer_lock);
+    // every counter only grows, so the sum changes whenever any part does
+    uint64_t posts_version = 0;
+    if (full) {
+        posts_lock.lock();
+        stripe_locks = lock_post_stripes_shared();
+        analytics_lock.lock();
+        posts_version = posts_version_;
+        for (uint64_t v : stripe_versions_) posts_version += v;
+    }
+
+    const GraphSnapshot *with_users = nullptr, *with_follows = nullptr;
+    for (const GraphSnapshot *s : {snapshot_.get(), follow_snapshot_.get()}) {
+        if (!s || s->users_->version != users_version_) continue;
+        with_users = s;
+        if (s->follows_->version == follows_version_) with_follows = s;
+    }
+    shared_ptr<const GraphSnapshot> &cached = full ? snapshot_ : follow_snapshot_;
+    const GraphSnapshot *last = cached.get();
+    const bool posts_current = full && last && last->posts_->version == posts_version;
+    const bool scores_current = full && last && last->scores_->version == analytics_version_;
+    if (last && last->users_->version == users_version_ && last->follows_->version == follows_version_ &&
+        (!full || (posts_current && scores_current))) {
+        return cached;
+    }
+
+    shared_ptr<GraphSnapshot> next(new GraphSnapshot());
+    if (with_users) {
+        next->users_ = with_users->users_;
+    } else {
+        auto users = make_shared<GraphSnapshot::Users>();
+        users->version = users_version_;
+        users->slots = user_slots_;
+        users->names = usernames_;
+        next->users_ = move(users);
+    }
+    if (with_follows) {
+        next->follows_ = with_follows->follows_;
+    } else {
+        // Start from the newest follows part: followees_changed_ lists every
+        // user whose followees differ from it, so all other lists are shared.
+        const GraphSnapshot *base = nullptr;
+        for (const GraphSnapshot *s : {snapshot_.get(), follow_snapshot_.get()}) {
+            if (s && !followees_reset_ && (!base || s->follows_->version > base->follows_->version)) base = s;
+        }
+        static const vector<int> empty;
+        const vector<int> &base_ids = base ? base->users_->slots.ids() : empty;
+        auto follows = make_shared<GraphSnapshot::Follows>();
+        follows->version = follows_version_;
+        follows->lists.resize(user_slots_.size());
+        size_t b = 0;
+        for (size_t slot = 0; slot < user_slots_.size(); ++slot) {
+            const int id = user_slots_.id_at(slot);
+            while (b < base_ids.size() && base_ids[b] < id) ++b;
+            if (b < base_ids.size() && base_ids[b] == id && !followees_changed_.count(id)) {
+                follows->lists[slot] = base->follows_->lists[b];
+                continue;
             }
+            const auto &followees = followees_for_unlocked(id);
+            if (followees.empty()) continue;
+            auto list = make_shared<vector<int>>(followees.begin(), followees.end());
+            sort(list->begin(), list->end());
+            follows->lists[slot] = move(list);
+        }
+        followees_changed_.clear();
+        followees_reset_ = false;
+        next->follows_ = move(follows);
+    }
+    if (!full) {
+        cached = move(next);
+        return cached;
+    }
+    if (posts_current) {
+        next->posts_ = last->posts_;
+    } else {
+        auto posts = make_shared<GraphSnapshot::Posts>();
+        posts->version = posts_version;
+        posts->slots = post_slots_;
+        posts->author = posts_.author;
+        posts->likes.reserve(post_slots_.size());
+        posts->unique_views.reserve(post_slots_.size());
+        for (size_t s = 0; s < post_slots_.size(); ++s) {
+            posts->likes.push_back(static_cast<int>(posts_.likes[s].size()));
+            posts->unique_views.push_back(static_cast<uint64_t>(llround(posts_.unique_viewers[s].estimate())));
         }
+        posts->decayed_weight = posts_.decayed_weight;
+        posts->decay_epoch = decay_epoch_;
+        posts->half_life_seconds = kDecayHalfLifeSeconds;
+        posts->content = posts_.content;
+        posts->text = post_text_.pin();
+        next->posts_ = move(posts);
+    }
+    if (scores_current) {
+        next->scores_ = last->scores_;
+    } else {
+        auto scores = make_shared<GraphSnapshot::Scores>();
+        scores->version = analytics_version_;
+        scores->users = pagerank_scores_;
+        scores->posts = post_pagerank_scores_;
+        next->scores_ = move(scores);
     }
+    cached = move(next);
+    return cached;
 }
 
 bool Graph::delete_post(int post_id) {
-    unique_lock lock(mutex_);
-    auto it = posts_.find(post_id);
-    if (it == posts_.end()) return false;
-    for (auto &inv : inverted_index_) inv.second.erase(post_id);
-    posts_.erase(it);
-    rebuild_tries_and_index_unlocked();
-    string path = db_path_.empty() ? string("db/social_graph.db") : db_path_;
-    try {
-        save_to_db_unlocked(path);
-    } catch(...) {}
+    auto timer = metrics_.time(GraphOp::DeletePost);
+    PersistFlush flush{*this};
+    unique_lock posts_lock(posts_mutex_);
+    const int slot = post_slots_.slot(post_id);
+    if (slot < 0) return false;
+    unique_lock index_lock(index_mutex_);
+    erase_post_tokens_unlocked(post_id, post_content_unlocked(slot));
+    corpus_erase_unlocked(post_id);
+    trending_heaps_[post_stripe_index(post_id)].erase(post_id);
+    trending_dirty_.store(true);
+    const int author = posts_.author[slot];
+    const bool had_views = !posts_.views[slot].empty();
+    erase_posts_unlocked({post_id});
+    if (had_views) {
+        lock_guard reach_lock(reach_mutex_);
+        rebuild_author_reach_unlocked({author});
+    }
+    persist_records("DP|" + to_string(post_id) + "\n");
     return true;
 }
 
+// Point queries search the live follow sets under shared locks and stop as
+// soon as they have their answer, so they never pay for copying the graph.
+// Balanced bidirectional search: each round expands a whole level of the
+// smaller side, forwards along followees from u1 or back along followers from
+// u2. The first user both sides reach is on a shortest path (the sides were
+// disjoint up to the previous level), so the search ends there.
 vector<int> Graph::bfs_path(int u1, int u2) {
-    shared_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::BfsPath);
+    shared_lock users_lock(users_mutex_);
     if (!user_exists_unlocked(u1) || !user_exists_unlocked(u2)) return {};
     if (u1 == u2) return {u1};
-    queue<int> q; q.push(u1); unordered_map<int,int> par; par[u1] = -1;
-    while (!q.empty()) {
-        int u = q.front(); q.pop();
-        for (int v : followees_for_unlocked(u)) {
-            if (!par.count(v)) { par[v] = u; q.push(v); if (v == u2) break; }
+    shared_lock follow_lock(follow_mutex_);
+    // no follow chain joins them in any direction
+    if (!follow_components_.connected(u1, u2)) return {};
+    unordered_map<int, int> from_u1{{u1, u1}}, to_u2{{u2, u2}};  // user -> neighbour towards that end
+    vector<int> front{u1}, back{u2}, next;
+    int meet = -1;
+    while (meet < 0 && !front.empty() && !back.empty()) {
+        const bool forward = front.size() <= back.size();
+        vector<int> &frontier = forward ? front : back;
+        auto &seen = forward ? from_u1 : to_u2;
+        const auto &other = forward ? to_u2 : from_u1;
+        next.clear();
+        for (int u : frontier) {
+            for (int v : forward ? followees_for_unlocked(u) : followers_for_unlocked(u)) {
+                if (!seen.emplace(v, u).second) continue;
+                if (other.count(v)) {
+                    meet = v;
+                    break;
+                }
+                next.push_back(v);
+            }
+            if (meet >= 0) break;
         }
-        if (par.count(u2)) break;
+        frontier.swap(next);
+    }
+    if (meet < 0) return {};
+    vector<int> path;
+    for (int x = meet; x != u1; x = from_u1[x]) path.push_back(x);
+    path.push_back(u1);
+    reverse(path.begin(), path.end());
+    for (int x = meet; x != u2;) {
+        x = to_u2[x];
+        path.push_back(x);
+    }
+    return path;
+}
+
+WeightedPath Graph::weighted_path(int u1, int u2, const WeightedPathOptions &options) {
+    auto timer = metrics_.time(GraphOp::WeightedPath);
+    shared_ptr<const WeightedUserGraph> paths;
+    {
+        shared_lock users_lock(users_mutex_);
+        if (!user_exists_unlocked(u1) || !user_exists_unlocked(u2)) return {};
+        shared_lock analytics_lock(analytics_mutex_);
+        paths = path_graph_;
     }
-    if (!par.count(u2)) return {};
-    vector<int> path; for (int x = u2; x != -1; x = par[x]) path.push_back(x); reverse(path.begin(), path.end()); return path;
+    return paths ? paths->shortest_path(u1, u2, options) : WeightedPath{};
 }
 
+// Only users sharing a followee with u score above zero, so the candidates
+// are the other followers of u's followees, counted once per shared followee.
 vector<int> Graph::recommendations(int u) {
-    shared_lock lock(mutex_);
-    if (!user_exists_unlocked(u)) return {};
+    auto timer = metrics_.time(GraphOp::Recommendations);
     vector<pair<double,int>> scores;
-    const auto &u_follow = followees_for_unlocked(u);
-    for (auto &p : users_) {
-        int v = p.first;
-        if (v == u || u_follow.count(v)) continue;
-        double sim = jaccard_sets(u_follow, followees_for_unlocked(v));
-        if (sim > 0.0) scores.emplace_back(sim, v);
+    {
+        shared_lock users_lock(users_mutex_);
+        if (!user_exists_unlocked(u)) return {};
+        shared_lock follow_lock(follow_mutex_);
+        const auto &mine = followees_for_unlocked(u);
+        unordered_map<int, size_t> shared;
+        for (int f : mine) {
+            for (int v : followers_for_unlocked(f)) {
+                if (v != u && !mine.count(v)) ++shared[v];
+            }
+        }
+        scores.reserve(shared.size());
+        for (const auto &[v, inter] : shared) {
+            const size_t uni = mine.size() + followees_for_unlocked(v).size() - inter;
+            scores.emplace_back((double)inter / (double)uni, v);
+        }
     }
     sort(scores.begin(), scores.end(), [](const auto &a, const auto &b){
         if (a.first != b.first) return a.first > b.first;
@@ -496,41 +1737,18 @@ vector<int> Graph::recommendations(int u) {
     return out;
 }
 
-vector<pair<int,vector<int>>> Graph::communities() {
-    shared_lock lock(mutex_);
-
-    if (users_.empty()) return {};
-    const int max_user_id = users_.rbegin()->first;
-    int n = max_user_id + 1;
-    DSU dsu(n);
-    
-    for (auto &a : users_) {
-        for (auto &b : users_) {
-            if (a.first < b.first) {
-                double sim = jaccard_sets(followees_for_unlocked(a.first), followees_for_unlocked(b.first));
-                if (sim > 0.1) {
-                    dsu.unite(a.first, b.first);
-                }
-            }
-        }
-    }
-    
-    auto components = dsu.get_components();
-    
-    vector<pair<int,vector<int>>> out;
-    for (auto &comp : components) {
-        vector<int> members;
-        for (int uid : comp.second) {
-            if (users_.count(uid)) {
-                members.push_back(uid);
-            }
-        }
-        if (!members.empty()) {
-            out.emplace_back(comp.first, members);
-        }
+WalkRecommendations Graph::personalized_recommendations(int u, size_t k) {
+    auto timer = metrics_.time(GraphOp::PersonalizedRecommendations);
+    {
+        shared_lock users_lock(users_mutex_);
+        if (!user_exists_unlocked(u)) return {};
     }
-    
-    return out;
+    return walks_.query(u, k);
+}
+
+vector<pair<int,vector<int>>> Graph::communities() {
+    auto timer = metrics_.time(GraphOp::Communities);
+    return follow_snapshot()->communities();
 }
 
 vector<int> Graph::community_members(int cid) {
@@ -539,20 +1757,51 @@ vector<int> Graph::community_members(int cid) {
     return {};
 }
 
+uint64_t Graph::user_unique_reach(int user_id) {
+    lock_guard reach_lock(reach_mutex_);
+    auto it = author_reach_.find(user_id);
+    if (it == author_reach_.end()) return 0;
+    return static_cast<uint64_t>(llround(it->second.estimate()));
+}
+
+uint64_t Graph::community_unique_reach(int cid) {
+    vector<int> members;
+    {
+        shared_lock analytics_lock(analytics_mutex_);
+        auto it = community_members_.find(cid);
+        if (it == community_members_.end()) return 0;
+        members = it->second;
+    }
+    HllSketch reach;
+    {
+        lock_guard reach_lock(reach_mutex_);
+        for (int uid : members) {
+            auto it = author_reach_.find(uid);
+            if (it != author_reach_.end()) reach.merge(it->second);
+        }
+    }
+    return static_cast<uint64_t>(llround(reach.estimate()));
+}
+
 Graph::PostMetrics Graph::get_post_metrics(int post_id) {
-    shared_lock lock(mutex_);
+    shared_lock posts_lock(posts_mutex_);
     PostMetrics m;
-    auto it = posts_.find(post_id);
-    if (it == posts_.end()) return m;
-    m.likes = static_cast<int>(it->second.likes.size());
-    m.unique_views = static_cast<uint64_t>(llround(it->second.unique_viewers.estimate()));
+    const int slot = post_slots_.slot(post_id);
+    if (slot < 0) return m;
+    {
+        shared_lock stripe_lock(post_stripe(post_id));
+        m.likes = static_cast<int>(posts_.likes[slot].size());
+        m.unique_views = static_cast<uint64_t>(llround(posts_.unique_viewers[slot].estimate()));
+        m.interaction_weight = post_interaction_weight_unlocked(slot, current_epoch_seconds());
+    }
+    shared_lock analytics_lock(analytics_mutex_);
     m.score = post_pagerank_scores_.count(post_id) ? post_pagerank_scores_.at(post_id) : 0.0;
-    m.interaction_weight = post_interaction_weights_.count(post_id) ? post_interaction_weights_.at(post_id) : 0.0;
     return m;
 }
 
 vector<int> Graph::search_posts(const string &q) {
-    shared_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::SearchPosts);
+    shared_lock lock(index_mutex_);
     auto toks = tokenize_lower(q); if (toks.empty()) return {};
     auto first_it = inverted_index_.find(toks[0]);
     if (first_it == inverted_index_.end()) return {};
@@ -568,7 +1817,9 @@ vector<int> Graph::search_posts(const string &q) {
 }
 
 vector<string> Graph::autocomplete(const string &prefix) {
-    shared_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::Autocomplete);
+    shared_lock users_lock(users_mutex_);
+    shared_lock index_lock(index_mutex_);
     // Use Trie data structure for efficient prefix-based autocomplete
     // Returns both usernames and post keywords
     vector<string> results;
@@ -588,86 +1839,202 @@ vector<string> Graph::autocomplete(const string &prefix) {
 }
 
 vector<string> Graph::autocomplete_users(const string &prefix) {
-    shared_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::Autocomplete);
+    shared_lock lock(users_mutex_);
     // Use Trie for username autocomplete only
     return username_trie_.autocomplete(prefix, 10);
 }
 
 vector<string> Graph::autocomplete_posts(const string &prefix) {
-    shared_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::Autocomplete);
+    shared_lock lock(index_mutex_);
     // Use Trie for post content keyword autocomplete
     return post_content_trie_.autocomplete(prefix, 10);
 }
 
 vector<int> Graph::search_posts_aho(const string &pattern) {
-    shared_lock lock(mutex_);
-    // Use Aho-Corasick for efficient multi-pattern matching in posts
-    if (pattern.empty()) return {};
-    
+    vector<int> matching_posts;
+    for (const auto &m : search_posts_aho_multi({pattern})) matching_posts.push_back(m.post_id);
+    return matching_posts;
+}
+
+vector<PostPatternMatches> Graph::search_posts_aho_multi(const vector<string> &patterns) {
+    auto timer = metrics_.time(GraphOp::SearchPostsAho);
+    // Build one automaton for the whole batch before taking the lock.
     AhoCorasick ac;
-    // Add the search pattern (can be extended to multiple patterns)
-    string low_pattern;
-    for (char c : pattern) low_pattern.push_back(tolower((unsigned char)c));
-    ac.add_pattern(low_pattern);
+    vector<int> query_index;  // automaton pattern id -> position in `patterns`
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        if (patterns[i].empty()) continue;
+        ac.add_pattern(lower(patterns[i]));
+        query_index.push_back(static_cast<int>(i));
+    }
+    if (query_index.empty()) return {};
     ac.build();
-    
-    vector<int> matching_posts;
-    for (auto &p : posts_) {
-        string low_content;
-        for (char c : p.second.content) low_content.push_back(tolower((unsigned char)c));
-        auto matches = ac.search(low_content);
-        if (!matches.empty()) {
-            matching_posts.push_back(p.second.id);
+
+    // Pin the lowered text and copy the entry list, then scan without the
+    // index lock so add_post is not held up for the whole scan.
+    vector<CorpusEntry> entries;
+    ContentArena::Pinned corpus;
+    {
+        shared_lock lock(index_mutex_);
+        entries = corpus_entries_;
+        corpus = lower_corpus_.pin();
+    }
+    const size_t n = entries.size();
+    const size_t workers = parallel_workers(n, 512);
+    vector<vector<PostPatternMatches>> partial(workers);
+    parallel_for_ranges(n, workers, [&](size_t w, size_t begin, size_t end) {
+        vector<int> hits;
+        vector<unsigned char> seen(ac.patterns.size(), 0);
+        for (size_t i = begin; i < end; ++i) {
+            const auto &entry = entries[i];
+            hits.clear();
+            ac.match_ids(corpus.view(entry.span), hits, seen);
+            if (hits.empty()) continue;
+            PostPatternMatches m{entry.post_id, {}};
+            m.patterns.reserve(hits.size());
+            for (int id : hits) m.patterns.push_back(query_index[id]);
+            sort(m.patterns.begin(), m.patterns.end());
+            partial[w].push_back(move(m));
         }
+    });
+
+    vector<PostPatternMatches> out;
+    for (auto &part : partial) {
+        out.insert(out.end(), make_move_iterator(part.begin()), make_move_iterator(part.end()));
     }
-    
-    sort(matching_posts.begin(), matching_posts.end());
-    return matching_posts;
+    return out;
 }
 
+// Both hold analytics_run_mutex_ across the load and the analytics run on
+// the new graph, so a run that copied the old graph cannot publish after it.
 void Graph::load_from_db(const string &path) {
-    unique_lock lock(mutex_);
-    db_path_ = path;
+    lock_guard run_lock(analytics_run_mutex_);
+    ifstream in(path);
+    load_records(in, path);
+    recompute_analytics_unlocked();
+}
 
-    users_.clear();
-    posts_.clear();
+void Graph::load_snapshot(const string &records) {
+    lock_guard run_lock(analytics_run_mutex_);
+    istringstream in(records);
+    load_records(in, db_path_);
+    if (!db_path_.empty()) save_to_db(db_path_);  // the old file no longer matches
+    recompute_analytics_unlocked();
+}
+
+// Replaces everything with the records read from in and persists to path
+// from then on; a stream that failed to open leaves the graph empty.
+// Analytics are cleared, not recomputed: the caller runs them afterwards.
+void Graph::load_records(istream &in, const string &path) {
+    auto timer = metrics_.time(GraphOp::LoadFromDb);
+    unique_lock users_lock(users_mutex_);
+    unique_lock follow_lock(follow_mutex_);
+    unique_lock posts_lock(posts_mutex_);
+    unique_lock index_lock(index_mutex_);
+
+    user_slots_.clear();
+    usernames_.clear();
+    username_index_.clear();
+    post_slots_.clear();
+    posts_ = PostColumns();
+    for (auto &pool : edge_pools_) pool.release();  // every interaction vector is gone
+    post_text_.clear();
     followers_.clear();
     followees_.clear();
+    followees_changed_.clear();
+    followees_reset_ = true;
     inverted_index_.clear();
-    pagerank_scores_.clear();
-    post_pagerank_scores_.clear();
-    post_interaction_weights_.clear();
+    walks_.clear();
+    follow_components_.clear();
+    ++users_version_;
+    ++follows_version_;
+    ++posts_version_;
+    {
+        lock_guard reach_lock(reach_mutex_);
+        author_reach_.clear();
+    }
+    {
+        unique_lock analytics_lock(analytics_mutex_);
+        pagerank_scores_.clear();
+        post_pagerank_scores_.clear();
+        ranking_.clear();
+        ranking_max_user_id_ = 0;
+        path_graph_.reset();
+        clustering_.clear();
+        clustering_summary_ = ClusteringSummary();
+        betweenness_scores_.clear();
+        closeness_scores_.clear();
+        betweenness_samples_ = hyperball_rounds_ = 0;
+        components_.clear();
+        component_summary_ = ComponentSummary();
+        community_members_.clear();
+        ++analytics_version_;
+    }
     next_user_id_ = 1;
     next_post_id_ = 1;
     username_trie_.clear();
     post_content_trie_.clear();
-    
-    ifstream in(path);
+    lower_corpus_.clear();
+    corpus_entries_.clear();
+    {
+        lock_guard flush_lock(flush_mutex_);
+        lock_guard persist_lock(persist_mutex_);
+        // what the old graph queued still belongs in the old file
+        if (!persist_pending_.empty()) write_persisted_unlocked(db_path_, persist_pending_);
+        persist_pending_.clear();
+        persist_out_.reset();
+        db_path_ = path;
+        if (replication_log_) replication_log_->restart();  // followers must re-bootstrap
+    }
+
     if (!in) {
-        rebuild_top_k_unlocked();
+        rebuild_trending_unlocked();
         return;
     }
+    // parse into ordered maps first: records may repeat or arrive out of id
+    // order, while the slot columns must be filled in id order. Interactions
+    // are appended raw and deduplicated per post afterwards (last record wins).
+    struct LoadedPost {
+        int user_id = 0;
+        string content;
+        vector<Interaction> likes;
+        vector<Interaction> views;
+    };
+    map<int, string> users;
+    map<int, LoadedPost> posts;
     string l;
     while (getline(in, l)) {
         if (l.empty()) continue;
-        if (l[0] == 'U') {
+        if (l[0] == 'I') {
+            // id counters, so ids of deleted users and posts are not handed out again
+            size_t p1 = l.find('|', 2);
+            if (p1 == string::npos) continue;
+            next_user_id_ = max(next_user_id_, stoi(l.substr(2, p1 - 2)));
+            next_post_id_ = max(next_post_id_, stoi(l.substr(p1 + 1)));
+        } else if (l[0] == 'U') {
             size_t p1 = l.find('|', 2);
             if (p1 == string::npos) continue;
             int id = stoi(l.substr(2, p1 - 2));
             string name = l.substr(p1 + 1);
-            users_[id] = name;
+            users[id] = name;
             next_user_id_ = max(next_user_id_, id + 1);
-        } else if (l[0] == 'P') {
-            size_t p1 = l.find('|', 2);
+        } else if (const size_t tag = post_record_tag(l)) {
+            size_t p1 = l.find('|', tag);
             if (p1 == string::npos) continue;
             size_t p2 = l.find('|', p1 + 1);
             if (p2 == string::npos) continue;
-            int id = stoi(l.substr(2, p1 - 2));
+            int id = stoi(l.substr(tag, p1 - tag));
             int uid = stoi(l.substr(p1 + 1, p2 - (p1 + 1)));
-            string content = l.substr(p2 + 1);
-            Post p; p.id = id; p.user_id = uid; p.content = content; posts_[id] = p;
+            string content = post_record_content(tag, string_view(l).substr(p2 + 1));
+            posts[id] = LoadedPost{uid, move(content), {}, {}};
             
             next_post_id_ = max(next_post_id_, id + 1);
+        } else if (l.compare(0, 3, "DU|") == 0) {
+            // follows, posts and interactions of a user that is gone are dropped below
+            users.erase(stoi(l.substr(3)));
+        } else if (l.compare(0, 3, "DP|") == 0) {
+            posts.erase(stoi(l.substr(3)));
         } else if (l[0] == 'F') {
             size_t p1 = l.find('|', 2);
             if (p1 == string::npos) continue;
@@ -694,7 +2061,8 @@ void Graph::load_from_db(const string &path) {
                     timestamp = stoll(l.substr(p3 + 1));
                 }
             }
-            if (posts_.count(p)) posts_[p].likes[u] = {weight, timestamp};
+            auto post = posts.find(p);
+            if (post != posts.end()) post->second.likes.push_back({u, weight, timestamp});
         } else if (l[0] == 'V') {
             size_t p1 = l.find('|', 2);
             if (p1 == string::npos) continue;
@@ -711,13 +2079,36 @@ void Graph::load_from_db(const string &path) {
                 weight = stod(l.substr(p2 + 1, p3 - (p2 + 1)));
                 timestamp = stoll(l.substr(p3 + 1));
             }
-            if (posts_.count(p)) posts_[p].views[u] = {weight, timestamp};
+            auto post = posts.find(p);
+            if (post != posts.end()) post->second.views.push_back({u, weight, timestamp});
         }
     }
 
-    for (auto it = posts_.begin(); it != posts_.end();) {
-        if (!user_exists_unlocked(it->second.user_id)) it = posts_.erase(it);
-        else ++it;
+    username_index_.reserve(users.size());
+    for (auto &u : users) {
+        user_slots_.insert(u.first);
+        username_index_.try_emplace(lower(u.second), u.first);  // older files may hold case variants; lowest id keeps the name
+        usernames_.push_back(move(u.second));
+    }
+    unordered_set<int> authors;
+    for (auto &p : posts) {
+        if (!user_exists_unlocked(p.second.user_id)) continue;
+        append_post_unlocked(p.first, p.second.user_id, p.second.content);
+        const size_t slot = post_slots_.size() - 1;
+        for (auto [src, dst] : {make_pair(&p.second.likes, &posts_.likes[slot]),
+                                make_pair(&p.second.views, &posts_.views[slot])}) {
+            stable_sort(src->begin(), src->end(), [](const Interaction &a, const Interaction &b) {
+                return a.user_id < b.user_id;
+            });
+            dst->reserve(src->size());
+            for (size_t i = 0; i < src->size(); ++i) {
+                const Interaction &e = (*src)[i];
+                if (i + 1 < src->size() && (*src)[i + 1].user_id == e.user_id) continue;
+                if (user_exists_unlocked(e.user_id)) dst->push_back(e);
+            }
+        }
+        rebuild_unique_viewers_unlocked(slot);
+        authors.insert(p.second.user_id);
     }
     for (auto it = followees_.begin(); it != followees_.end();) {
         if (!user_exists_unlocked(it->first)) {
@@ -734,125 +2125,243 @@ void Graph::load_from_db(const string &path) {
     for (const auto &f : followees_) {
         for (int v : f.second) followers_[v].insert(f.first);
     }
-    for (auto &p : posts_) {
-        for (auto it = p.second.likes.begin(); it != p.second.likes.end();) {
-            if (!user_exists_unlocked(it->first)) it = p.second.likes.erase(it);
-            else ++it;
-        }
-        for (auto it = p.second.views.begin(); it != p.second.views.end();) {
-            if (!user_exists_unlocked(it->first)) it = p.second.views.erase(it);
-            else ++it;
+    {
+        lock_guard reach_lock(reach_mutex_);
+        rebuild_author_reach_unlocked(authors);
+    }
+    rebuild_trending_unlocked();
+    // follows and interactions were filled in directly; landmarks are set by now
+    for (const auto &f : followees_) {
+        for (int v : f.second) walks_.add_follow(f.first, v);
+    }
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        for (const auto *edges : {&posts_.likes[s], &posts_.views[s]}) {
+            for (const auto &e : *edges) walks_.add_interaction(e.user_id, post_slots_.id_at(s), e.landmark, 1);
         }
     }
-    rebuild_unique_viewers_unlocked();
     rebuild_tries_and_index_unlocked();
-    recompute_analytics_unlocked(current_epoch_seconds());
+    rebuild_corpus_unlocked();
 }
 
 void Graph::save_to_db(const string &path) {
-    unique_lock lock(mutex_);
+    auto timer = metrics_.time(GraphOp::SaveToDb);
+    shared_lock users_lock(users_mutex_);
+    shared_lock follow_lock(follow_mutex_);
+    shared_lock posts_lock(posts_mutex_);
+    auto stripe_locks = lock_post_stripes_shared();
     save_to_db_unlocked(path);
 }
 
 void Graph::save_to_db_unlocked(const string &path) {
+    lock_guard flush_lock(flush_mutex_);
+    lock_guard persist_lock(persist_mutex_);
     try {
         auto parent = filesystem::path(path).parent_path();
         if (!parent.empty()) filesystem::create_directories(parent);
     } catch(...) {}
-    ofstream out(path, ios::trunc);
-    if (!out) return;
-    for (auto &u : users_) out << "U|" << u.first << "|" << u.second << "\n";
-    for (auto &p : posts_) {
-        if (users_.count(p.second.user_id)) {
-            out << "P|" << p.second.id << "|" << p.second.user_id << "|" << p.second.content << "\n";
+    // written aside and renamed over the file, so a failed save leaves both
+    // the old file and the queue as they were
+    const string temp = path + ".tmp";
+    {
+        ofstream out(temp, ios::trunc);
+        if (!out) return;
+        write_records_unlocked(out);
+        if (!out.flush()) {
+            out.close();
+            error_code ignored;
+            filesystem::remove(temp, ignored);
+            return;
+        }
+    }
+    error_code error;
+    filesystem::rename(temp, path, error);
+    if (error) {
+        filesystem::remove(temp, error);
+        return;
+    }
+    if (path == persist_out_path_) persist_out_.reset();  // still open on the replaced file
+    // queued records are writes the caller's locks have let finish, so the
+    // file now holds them
+    if (path == db_path_) persist_pending_.clear();
+}
+
+// Caller holds users/follows/posts/stripes (shared is enough).
+void Graph::write_records_unlocked(ostream &out) const {
+    out.precision(kRecordPrecision);
+    out << "I|" << next_user_id_ << "|" << next_post_id_ << "\n";
+    for (size_t s = 0; s < user_slots_.size(); ++s) out << "U|" << user_slots_.id_at(s) << "|" << usernames_[s] << "\n";
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        if (user_exists_unlocked(posts_.author[s])) {
+            out << post_record(post_slots_.id_at(s), posts_.author[s], post_content_unlocked(s));
         }
     }
     for (auto &f : followees_) {
-        if (!users_.count(f.first)) continue;
+        if (!user_exists_unlocked(f.first)) continue;
         for (int v : f.second) {
-            if (users_.count(v)) {
+            if (user_exists_unlocked(v)) {
                 out << "F|" << f.first << "|" << v << "\n";
             }
         }
     }
-    for (auto &p : posts_) {
-        if (users_.count(p.second.user_id)) {
-            for (const auto &like : p.second.likes) {
-                int uid = like.first;
-                if (users_.count(uid)) {
-                    out << "L|" << uid << "|" << p.second.id << "|" << like.second.weight << "|" << like.second.timestamp << "\n";
-                }
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        if (!user_exists_unlocked(posts_.author[s])) continue;
+        const int pid = post_slots_.id_at(s);
+        for (const auto &like : posts_.likes[s]) {
+            if (user_exists_unlocked(like.user_id)) {
+                out << "L|" << like.user_id << "|" << pid << "|" << like.weight << "|" << like.timestamp << "\n";
             }
-            for (const auto &view : p.second.views) {
-                int uid = view.first;
-                if (users_.count(uid)) {
-                    out << "V|" << uid << "|" << p.second.id << "|" << view.second.weight << "|" << view.second.timestamp << "\n";
-                }
+        }
+        for (const auto &view : posts_.views[s]) {
+            if (user_exists_unlocked(view.user_id)) {
+                out << "V|" << view.user_id << "|" << pid << "|" << view.weight << "|" << view.timestamp << "\n";
             }
         }
     }
 }
 
 void Graph::persist_user(int user_id, const string &username) {
-    if (db_path_.empty()) return;
-    ofstream out(db_path_, ios::app);
-    if (!out) return;
-    out << "U|" << user_id << "|" << username << "\n";
+    ostringstream line;
+    line << "U|" << user_id << "|" << username << "\n";
+    persist_records(line.str());
 }
 
 void Graph::persist_post(int post_id, int user_id, const string &content) {
-    if (db_path_.empty()) return;
-    ofstream out(db_path_, ios::app);
-    if (!out) return;
-    out << "P|" << post_id << "|" << user_id << "|" << content << "\n";
+    persist_records(post_record(post_id, user_id, content));
 }
 
 void Graph::persist_follow(int a, int b) {
-    if (db_path_.empty()) return;
-    ofstream out(db_path_, ios::app);
-    if (!out) return;
-    out << "F|" << a << "|" << b << "\n";
+    ostringstream line;
+    line << "F|" << a << "|" << b << "\n";
+    persist_records(line.str());
 }
 
 void Graph::persist_like(int user_id, int post_id, double weight, int64_t timestamp) {
-    if (db_path_.empty()) return;
-    ofstream out(db_path_, ios::app);
-    if (!out) return;
-    out << "L|" << user_id << "|" << post_id << "|" << weight << "|" << timestamp << "\n";
+    ostringstream line;
+    line.precision(kRecordPrecision);
+    line << "L|" << user_id << "|" << post_id << "|" << weight << "|" << timestamp << "\n";
+    persist_records(line.str());
 }
 
 void Graph::persist_view(int user_id, int post_id, double weight, int64_t timestamp) {
-    if (db_path_.empty()) return;
-    ofstream out(db_path_, ios::app);
-    if (!out) return;
-    out << "V|" << user_id << "|" << post_id << "|" << weight << "|" << timestamp << "\n";
+    ostringstream line;
+    line.precision(kRecordPrecision);
+    line << "V|" << user_id << "|" << post_id << "|" << weight << "|" << timestamp << "\n";
+    persist_records(line.str());
+}
+
+// Every append goes through here, under the writer's graph locks, so the
+// file and the replication log see writes in the order they took effect.
+// Only the queue is touched here; the file write waits for flush_persisted().
+void Graph::persist_records(const string &records) {
+    if (records.empty()) return;
+    lock_guard persist_lock(persist_mutex_);
+    if (replication_log_) replication_log_->append(records);
+    if (!db_path_.empty()) persist_pending_ += records;
+}
+
+// Whoever gets flush_mutex_ first writes the records every writer queued
+// meanwhile; the rest find the queue empty (or their records already
+// written) and return. Records are in the file when the write call returns.
+void Graph::flush_persisted() {
+    lock_guard flush_lock(flush_mutex_);
+    string records, path;
+    {
+        lock_guard persist_lock(persist_mutex_);
+        if (persist_pending_.empty()) return;
+        records.swap(persist_pending_);
+        path = db_path_;
+    }
+    write_persisted_unlocked(path, records);
+}
+
+void Graph::write_persisted_unlocked(const string &path, const string &records) {
+    if (!persist_out_ || persist_out_path_ != path) {
+        persist_out_ = make_unique<ofstream>(path, ios::app);
+        persist_out_path_ = path;
+    }
+    // a failed open or write is retried on a fresh stream next time
+    if (!*persist_out_ || !persist_out_->write(records.data(), static_cast<streamsize>(records.size())).flush()) {
+        persist_out_.reset();
+    }
+}
+
+void Graph::attach_replication_log(shared_ptr<ReplicationLog> log) {
+    lock_guard persist_lock(persist_mutex_);
+    replication_log_ = move(log);
+}
+
+Graph::ReplicationSnapshot Graph::replication_snapshot() {
+    auto timer = metrics_.time(GraphOp::SaveToDb);
+    shared_lock users_lock(users_mutex_);
+    shared_lock follow_lock(follow_mutex_);
+    shared_lock posts_lock(posts_mutex_);
+    auto stripe_locks = lock_post_stripes_shared();
+    ReplicationSnapshot out;
+    ostringstream records;
+    write_records_unlocked(records);
+    out.records = records.str();
+    lock_guard persist_lock(persist_mutex_);
+    if (replication_log_) {
+        out.log_id = replication_log_->id();
+        out.offset = replication_log_->end_offset();
+    }
+    return out;
 }
 
 bool Graph::delete_user(int user_id) {
-    unique_lock lock(mutex_);
-    if (!users_.count(user_id)) return false;
-    users_.erase(user_id);
-    for (auto &p : followees_) p.second.erase(user_id);
-    for (auto &p : followers_) p.second.erase(user_id);
+    auto timer = metrics_.time(GraphOp::DeleteUser);
+    PersistFlush flush{*this};
+    // structural change: every structure exclusively, in lock order
+    unique_lock users_lock(users_mutex_);
+    unique_lock follow_lock(follow_mutex_);
+    unique_lock posts_lock(posts_mutex_);
+    unique_lock index_lock(index_mutex_);
+    if (!user_exists_unlocked(user_id)) return false;
+    const string name = usernames_[user_slots_.slot(user_id)];
+    auto name_it = username_index_.find(lower(name));
+    if (name_it != username_index_.end() && name_it->second == user_id) username_index_.erase(name_it);
+    DenseIdMap::compact_column(usernames_, user_slots_.erase({user_id}));
+    username_trie_.erase(name);
+    // an older file's case variant of the name shares its trie entry
+    name_it = username_index_.find(lower(name));
+    if (name_it != username_index_.end()) username_trie_.insert(usernames_[user_slots_.slot(name_it->second)]);
+    for (int follower : followers_for_unlocked(user_id)) {
+        followees_[follower].erase(user_id);
+        followees_changed_unlocked(follower);
+    }
+    for (int followee : followees_for_unlocked(user_id)) followers_[followee].erase(user_id);
     followees_.erase(user_id);
     followers_.erase(user_id);
-    for (auto &p : posts_) {
-        p.second.likes.erase(user_id);
-        p.second.views.erase(user_id);
-    }
+    ++users_version_;
+    ++follows_version_;
+    unordered_set<int> reach_changed;
     vector<int> to_remove;
-    for (auto &p : posts_) if (p.second.user_id == user_id) to_remove.push_back(p.first);
+    for (size_t s = 0; s < post_slots_.size(); ++s) {
+        drop_interaction_unlocked(s, posts_.likes[s], user_id);
+        if (drop_interaction_unlocked(s, posts_.views[s], user_id)) {
+            rebuild_unique_viewers_unlocked(s);
+            reach_changed.insert(posts_.author[s]);
+        }
+        if (posts_.author[s] == user_id) to_remove.push_back(post_slots_.id_at(s));
+    }
     for (int pid : to_remove) {
-        for (auto &inv : inverted_index_) inv.second.erase(pid);
-        posts_.erase(pid);
+        erase_post_tokens_unlocked(pid, post_content_unlocked(post_slots_.slot(pid)));
+        corpus_erase_unlocked(pid);
+        trending_heaps_[post_stripe_index(pid)].erase(pid);
     }
-    rebuild_unique_viewers_unlocked();
-    rebuild_tries_and_index_unlocked();
-    try {
-        save_to_db_unlocked(db_path_.empty() ? "db/social_graph.db" : db_path_);
-    } catch (const exception &e) {
-        cerr << "ERR: delete_user persist exception: " << e.what() << endl;
-        return false;
+    erase_posts_unlocked(to_remove);
+    walks_.remove_user(user_id);
+    {
+        lock_guard reach_lock(reach_mutex_);
+        reach_changed.erase(user_id);
+        author_reach_.erase(user_id);
+        rebuild_author_reach_unlocked(reach_changed);
+    }
+    {
+        unique_lock analytics_lock(analytics_mutex_);
+        ranking_.erase(remove_if(ranking_.begin(), ranking_.end(),
+                                 [&](const RankEntry &e) { return e.user_id == user_id; }), ranking_.end());
     }
+    persist_records("DU|" + to_string(user_id) + "\n");
     return true;
 }
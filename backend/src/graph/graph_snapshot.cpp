@@ -0,0 +1,150 @@
+#include "graph_snapshot.hpp"
+#include "components.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+using namespace std;
+
+namespace {
+
+// |A ∩ B| / |A ∪ B| over ascending lists.
+double jaccard_sorted(const vector<int> &a, const vector<int> &b) {
+    if (a.empty() && b.empty()) return 0.0;
+    size_t inter = 0;
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+        if (a[i] < b[j]) ++i;
+        else if (b[j] < a[i]) ++j;
+        else { ++inter; ++i; ++j; }
+    }
+    const size_t uni = a.size() + b.size() - inter;
+    return uni ? (double)inter / (double)uni : 0.0;
+}
+
+const vector<int> kNoFollowees;
+
+} // namespace
+
+string_view GraphSnapshot::username(int user_id) const {
+    const int slot = users_->slots.slot(user_id);
+    return slot < 0 ? string_view() : string_view(users_->names[slot]);
+}
+
+const vector<int> &GraphSnapshot::followee_list(size_t slot) const {
+    const auto &list = follows_->lists[slot];
+    return list ? *list : kNoFollowees;
+}
+
+vector<int> GraphSnapshot::followees(int user_id) const {
+    const int slot = users_->slots.slot(user_id);
+    return slot < 0 ? vector<int>() : followee_list(slot);
+}
+
+double GraphSnapshot::user_score(int user_id) const {
+    auto it = scores_->users.find(user_id);
+    return it == scores_->users.end() ? 0.0 : it->second;
+}
+
+double GraphSnapshot::post_score(int post_id) const {
+    auto it = scores_->posts.find(post_id);
+    return it == scores_->posts.end() ? 0.0 : it->second;
+}
+
+size_t GraphSnapshot::for_each_post(const function<bool(const PostView &)> &visit, const PostScanOptions &options) const {
+    using Field = PostScanOptions::Field;
+    const Posts &posts = *posts_;
+    const unsigned fields = options.fields;
+    const size_t begin = posts.slots.lower_bound_slot(max(0, options.min_post_id));
+    const size_t end = options.max_post_id == numeric_limits<int>::max()
+        ? posts.slots.size() : posts.slots.lower_bound_slot(options.max_post_id + 1);
+    const int64_t now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+    const double scale = exp2(-static_cast<double>(now - posts.decay_epoch) / posts.half_life_seconds);
+
+    size_t visited = 0;
+    for (size_t s = begin; s < end; ++s) {
+        if (options.author_id >= 0 && posts.author[s] != options.author_id) continue;
+        PostView v;
+        v.post_id = posts.slots.id_at(s);
+        v.user_id = posts.author[s];
+        if (fields & Field::Likes) v.likes = posts.likes[s];
+        if (fields & Field::UniqueViews) v.unique_views = posts.unique_views[s];
+        if (fields & Field::Score) v.score = post_score(v.post_id);
+        if (fields & Field::InteractionWeight) v.interaction_weight = posts.decayed_weight[s] * scale;
+        if (fields & Field::Content) v.content = posts.text.view(posts.content[s]);
+        ++visited;
+        if (!visit(v)) break;
+    }
+    return visited;
+}
+
+vector<PostInfo> GraphSnapshot::all_posts() const {
+    vector<PostInfo> all;
+    all.reserve(post_count());
+    for_each_post([&](const PostView &v) {
+        all.push_back({v.post_id, v.user_id, v.likes, v.unique_views, v.score, v.interaction_weight, string(v.content)});
+        return true;
+    });
+    return all;
+}
+
+vector<int> GraphSnapshot::bfs_path(int u1, int u2) const {
+    const DenseIdMap &slots = users_->slots;
+    const int from = slots.slot(u1), to = slots.slot(u2);
+    if (from < 0 || to < 0) return {};
+    if (from == to) return {u1};
+    vector<int> parent(slots.size(), -1);
+    parent[from] = from;
+    queue<int> q;
+    q.push(from);
+    while (!q.empty() && parent[to] < 0) {
+        const int u = q.front(); q.pop();
+        for (int id : followee_list(u)) {
+            const int v = slots.slot(id);
+            if (parent[v] >= 0) continue;
+            parent[v] = u;
+            if (v == to) break;
+            q.push(v);
+        }
+    }
+    if (parent[to] < 0) return {};
+    vector<int> path;
+    for (int x = to; x != from; x = parent[x]) path.push_back(slots.id_at(x));
+    path.push_back(u1);
+    reverse(path.begin(), path.end());
+    return path;
+}
+
+vector<int> GraphSnapshot::recommendations(int user_id) const {
+    const int u = users_->slots.slot(user_id);
+    if (u < 0) return {};
+    const vector<int> &mine = followee_list(u);
+    vector<unsigned char> followed(user_count(), 0);
+    for (int id : mine) followed[users_->slots.slot(id)] = 1;
+    vector<pair<double,int>> scores;
+    for (size_t v = 0; v < user_count(); ++v) {
+        if (static_cast<int>(v) == u || followed[v]) continue;
+        double sim = jaccard_sorted(mine, followee_list(v));
+        if (sim > 0.0) scores.emplace_back(sim, users_->slots.id_at(v));
+    }
+    sort(scores.begin(), scores.end(), [](const auto &a, const auto &b){
+        if (a.first != b.first) return a.first > b.first;
+        return a.second < b.second;
+    });
+    vector<int> out;
+    for (size_t i = 0; i < scores.size() && i < 10; ++i) out.push_back(scores[i].second);
+    return out;
+}
+
+vector<pair<int,vector<int>>> GraphSnapshot::communities() const {
+    const DenseIdMap &slots = users_->slots;
+    vector<size_t> offsets{0};
+    vector<uint32_t> targets;
+    offsets.reserve(slots.size() + 1);
+    for (size_t v = 0; v < slots.size(); ++v) {
+        for (int id : followee_list(v)) targets.push_back(static_cast<uint32_t>(slots.slot(id)));
+        offsets.push_back(targets.size());
+    }
+    return followee_communities(offsets, targets, slots.ids());
+}
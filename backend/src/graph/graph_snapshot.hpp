@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+
+// Immutable, consistent view of users, follows, posts and analytics scores,
+// taken by Graph::snapshot(). Queries on it take no locks, so long analytics
+// never hold up writers on the live graph. Each part (users, follows, posts,
+// scores) is shared with neighbouring snapshots until that part changes, and
+// is freed when the last snapshot holding it is released. The graph also
+// keeps follow-only snapshots (no posts or scores) for its own communities();
+// those are never handed out.
+class GraphSnapshot {
+public:
+    std::size_t user_count() const { return users_->slots.size(); }
+    std::size_t post_count() const { return posts_->slots.size(); }
+    const std::vector<int> &user_ids() const { return users_->slots.ids(); }
+    bool has_user(int user_id) const { return users_->slots.contains(user_id); }
+    bool has_post(int post_id) const { return posts_->slots.contains(post_id); }
+    std::string_view username(int user_id) const;  // empty if unknown
+    std::vector<int> followees(int user_id) const;  // ascending ids
+    double user_score(int user_id) const;
+    double post_score(int post_id) const;
+
+    // Same contract as Graph::for_each_post; content stays valid for as long
+    // as the snapshot is held, not just during the visit.
+    std::size_t for_each_post(const std::function<bool(const PostView &)> &visit,
+                              const PostScanOptions &options = {}) const;
+    std::vector<PostInfo> all_posts() const;
+    std::vector<int> bfs_path(int u1, int u2) const;
+    std::vector<int> recommendations(int user_id) const;
+    std::vector<std::pair<int, std::vector<int>>> communities() const;
+
+private:
+    friend class Graph;
+    GraphSnapshot() = default;
+
+    struct Users {
+        std::uint64_t version = 0;
+        DenseIdMap slots;
+        std::vector<std::string> names;  // by slot
+    };
+    // Followee lists by user slot, each ascending user ids (null when empty).
+    // A list is shared with the previous part unless that user's followees
+    // changed in between, so a follow copies one list, not the whole graph.
+    struct Follows {
+        std::uint64_t version = 0;
+        std::vector<std::shared_ptr<const std::vector<int>>> lists;  // user_count
+    };
+    struct Posts {
+        std::uint64_t version = 0;
+        DenseIdMap slots;
+        std::vector<int> author;
+        std::vector<int> likes;
+        std::vector<std::uint64_t> unique_views;
+        std::vector<double> decayed_weight;  // landmarks relative to decay_epoch
+        std::int64_t decay_epoch = 0;
+        double half_life_seconds = 1.0;
+        std::vector<ContentArena::Span> content;
+        ContentArena::Pinned text;
+    };
+    struct Scores {
+        std::uint64_t version = 0;
+        std::unordered_map<int, double> users;
+        std::unordered_map<int, double> posts;
+    };
+
+    const std::vector<int> &followee_list(std::size_t slot) const;
+
+    std::shared_ptr<const Users> users_;
+    std::shared_ptr<const Follows> follows_;
+    std::shared_ptr<const Posts> posts_;
+    std::shared_ptr<const Scores> scores_;
+};
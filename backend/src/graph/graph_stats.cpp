@@ -0,0 +1,124 @@
+#include "graph_stats.hpp"
+#include <cstdio>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+const char *const kOpNames[] = {
+    "add_user", "add_post", "add_posts_bulk", "add_follow", "add_like", "add_view", "add_interactions",
+    "delete_post", "delete_user", "recompute_analytics", "get_ranked", "top_posts", "trending_posts", "trending_window",
+    "scan_posts", "user_metrics", "bfs_path", "weighted_path", "recommendations", "personalized_recommendations", "communities",
+    "search_posts", "search_posts_aho", "autocomplete", "snapshot", "load_from_db", "save_to_db",
+};
+static_assert(sizeof(kOpNames) / sizeof(kOpNames[0]) == static_cast<size_t>(GraphOp::Count), "one name per GraphOp");
+
+const char *const kLockNames[] = {
+    "users", "follow", "posts", "post_stripes", "index", "reach", "analytics", "persist",
+};
+static_assert(sizeof(kLockNames) / sizeof(kLockNames[0]) == static_cast<size_t>(GraphLock::Count), "one name per GraphLock");
+
+const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+string number(double v) {
+    char buf[32];
+    snprintf(buf, sizeof buf, "%.9g", v);
+    return buf;
+}
+
+string join_labels(const string &a, const string &b) {
+    if (a.empty()) return b;
+    if (b.empty()) return a;
+    return a + "," + b;
+}
+
+void write_summary(ostringstream &out, const string &name, const string &labels, const LatencyHistogram::Snapshot &h) {
+    for (double q : kQuantiles) {
+        out << name << "{" << join_labels(labels, "quantile=\"" + number(q) + "\"") << "} "
+            << number(static_cast<double>(h.quantile(q)) / 1e9) << "\n";
+    }
+    const string braces = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << braces << " " << number(static_cast<double>(h.sum_nanos) / 1e9) << "\n";
+    out << name << "_count" << braces << " " << h.count << "\n";
+}
+
+} // namespace
+
+const char *graph_op_name(GraphOp op) { return kOpNames[static_cast<size_t>(op)]; }
+const char *graph_lock_name(GraphLock lock) { return kLockNames[static_cast<size_t>(lock)]; }
+
+void GraphMetrics::record_pagerank(int iterations, double residual, bool converged, size_t edges) {
+    if (!enabled.load(memory_order_relaxed)) return;
+    pagerank_runs_.fetch_add(1, memory_order_relaxed);
+    pagerank_iterations_.fetch_add(static_cast<uint64_t>(iterations), memory_order_relaxed);
+    pagerank_last_iterations_.store(iterations, memory_order_relaxed);
+    pagerank_last_residual_.store(residual, memory_order_relaxed);
+    pagerank_last_converged_.store(converged, memory_order_relaxed);
+    pagerank_last_edges_.store(edges, memory_order_relaxed);
+}
+
+void GraphMetrics::reset() {
+    for (auto &h : ops_) h.reset();
+    for (auto &l : locks_) {
+        l.wait.reset();
+        l.shared_wait.reset();
+        l.hold.reset();
+    }
+    pagerank_runs_.store(0, memory_order_relaxed);
+    pagerank_iterations_.store(0, memory_order_relaxed);
+}
+
+void GraphMetrics::collect(GraphStats &out) const {
+    out.enabled = enabled.load(memory_order_relaxed);
+    out.operations.clear();
+    for (size_t i = 0; i < ops_.size(); ++i) out.operations.push_back({kOpNames[i], ops_[i].snapshot()});
+    out.locks.clear();
+    for (size_t i = 0; i < locks_.size(); ++i) {
+        out.locks.push_back({kLockNames[i], locks_[i].wait.snapshot(), locks_[i].shared_wait.snapshot(),
+                             locks_[i].hold.snapshot()});
+    }
+    out.pagerank.runs = pagerank_runs_.load(memory_order_relaxed);
+    out.pagerank.total_iterations = pagerank_iterations_.load(memory_order_relaxed);
+    out.pagerank.last_iterations = pagerank_last_iterations_.load(memory_order_relaxed);
+    out.pagerank.last_residual = pagerank_last_residual_.load(memory_order_relaxed);
+    out.pagerank.last_converged = pagerank_last_converged_.load(memory_order_relaxed);
+    out.pagerank.last_edges = pagerank_last_edges_.load(memory_order_relaxed);
+}
+
+string GraphStats::to_prometheus() const {
+    ostringstream out;
+    out << "# TYPE graph_metrics_enabled gauge\ngraph_metrics_enabled " << (enabled ? 1 : 0) << "\n";
+
+    out << "# TYPE graph_operation_duration_seconds summary\n";
+    for (const auto &op : operations) {
+        write_summary(out, "graph_operation_duration_seconds", string("op=\"") + op.name + "\"", op.latency);
+    }
+    out << "# TYPE graph_lock_wait_seconds summary\n";
+    for (const auto &lock : locks) {
+        const string name = string("lock=\"") + lock.name + "\"";
+        write_summary(out, "graph_lock_wait_seconds", name + ",mode=\"exclusive\"", lock.wait);
+        write_summary(out, "graph_lock_wait_seconds", name + ",mode=\"shared\"", lock.shared_wait);
+    }
+    out << "# TYPE graph_lock_hold_seconds summary\n";
+    for (const auto &lock : locks) {
+        write_summary(out, "graph_lock_hold_seconds", string("lock=\"") + lock.name + "\",mode=\"exclusive\"", lock.hold);
+    }
+
+    out << "# TYPE graph_pagerank_runs_total counter\ngraph_pagerank_runs_total " << pagerank.runs << "\n"
+        << "# TYPE graph_pagerank_iterations_total counter\ngraph_pagerank_iterations_total " << pagerank.total_iterations << "\n"
+        << "# TYPE graph_pagerank_last_iterations gauge\ngraph_pagerank_last_iterations " << pagerank.last_iterations << "\n"
+        << "# TYPE graph_pagerank_last_residual gauge\ngraph_pagerank_last_residual " << number(pagerank.last_residual) << "\n"
+        << "# TYPE graph_pagerank_last_converged gauge\ngraph_pagerank_last_converged " << (pagerank.last_converged ? 1 : 0) << "\n"
+        << "# TYPE graph_pagerank_last_edges gauge\ngraph_pagerank_last_edges " << pagerank.last_edges << "\n";
+
+    // gauges sharing a name are emitted consecutively under one TYPE line
+    string previous;
+    for (const auto &g : gauges) {
+        const string name = "graph_" + g.name;
+        if (name != previous) out << "# TYPE " << name << " gauge\n";
+        previous = name;
+        out << name << (g.labels.empty() ? "" : "{" + g.labels + "}") << " " << number(g.value) << "\n";
+    }
+    return out.str();
+}
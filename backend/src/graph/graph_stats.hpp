@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "instrumented_mutex.hpp"
+#include "latency_histogram.hpp"
+
+// Public Graph operations with their own latency histogram.
+enum class GraphOp {
+    AddUser, AddPost, AddPostsBulk, AddFollow, AddLike, AddView, AddInteractions,
+    DeletePost, DeleteUser, RecomputeAnalytics, GetRanked, TopPosts, TrendingPosts, TrendingWindow,
+    ScanPosts, UserMetrics, BfsPath, WeightedPath, Recommendations, PersonalizedRecommendations, Communities,
+    SearchPosts, SearchPostsAho, Autocomplete, Snapshot, LoadFromDb, SaveToDb,
+    Count
+};
+
+// Graph's instrumented locks; all post stripes share one entry.
+enum class GraphLock {
+    Users, Follow, Posts, PostStripes, Index, Reach, Analytics, Persist,
+    Count
+};
+
+const char *graph_op_name(GraphOp op);
+const char *graph_lock_name(GraphLock lock);
+
+// Point-in-time copy of a Graph's instrumentation, from Graph::stats().
+struct GraphStats {
+    bool enabled = false;
+    struct Operation {
+        const char *name;
+        LatencyHistogram::Snapshot latency;
+    };
+    struct Lock {
+        const char *name;
+        LatencyHistogram::Snapshot wait, shared_wait, hold;
+    };
+    struct PageRank {
+        std::uint64_t runs = 0;
+        std::uint64_t total_iterations = 0;
+        int last_iterations = 0;
+        double last_residual = 0.0;  // L1 change of the final iteration
+        bool last_converged = false;
+        std::size_t last_edges = 0;
+    };
+    // One sample of a gauge; labels is Prometheus label text without braces.
+    struct Gauge {
+        std::string name;
+        std::string labels;
+        double value = 0.0;
+    };
+    std::vector<Operation> operations;
+    std::vector<Lock> locks;
+    PageRank pagerank;
+    std::vector<Gauge> gauges;
+
+    // Prometheus text exposition format; latencies become summaries in seconds.
+    std::string to_prometheus() const;
+};
+
+// The live counters behind GraphStats. Recording is lock-free; with
+// enabled == false timers and locks skip the clock entirely.
+class GraphMetrics {
+public:
+    class Timer {
+    public:
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+        ~Timer() {
+            if (histogram_) histogram_->record(monotonic_nanos() - start_);
+        }
+
+    private:
+        friend class GraphMetrics;
+        explicit Timer(LatencyHistogram *histogram)
+            : histogram_(histogram), start_(histogram ? monotonic_nanos() : 0) {}
+        LatencyHistogram *histogram_;
+        std::uint64_t start_;
+    };
+
+    Timer time(GraphOp op) {
+        return Timer(enabled.load(std::memory_order_relaxed) ? &ops_[static_cast<std::size_t>(op)] : nullptr);
+    }
+    LockStats &lock(GraphLock lock) { return locks_[static_cast<std::size_t>(lock)]; }
+    void record_pagerank(int iterations, double residual, bool converged, std::size_t edges);
+    void reset();
+    // Fills everything but the gauges, which need the graph's locks.
+    void collect(GraphStats &out) const;
+
+    std::atomic<bool> enabled{true};
+
+private:
+    std::array<LatencyHistogram, static_cast<std::size_t>(GraphOp::Count)> ops_;
+    std::array<LockStats, static_cast<std::size_t>(GraphLock::Count)> locks_;
+    std::atomic<std::uint64_t> pagerank_runs_{0};
+    std::atomic<std::uint64_t> pagerank_iterations_{0};
+    std::atomic<int> pagerank_last_iterations_{0};
+    std::atomic<double> pagerank_last_residual_{0.0};
+    std::atomic<bool> pagerank_last_converged_{false};
+    std::atomic<std::size_t> pagerank_last_edges_{0};
+};
@@ -0,0 +1,46 @@
+#include "interaction_window.hpp"
+#include <algorithm>
+
+using namespace std;
+
+void InteractionWindow::add(int64_t timestamp, int post_id, double weight) {
+    if (timestamp <= 0) return;
+    const int64_t hour = timestamp / kBucketSeconds;
+    if (hour > head_hour_) {
+        // advance the ring, clearing the hours it wraps over
+        const int64_t steps = min<int64_t>(hour - head_hour_, kBuckets);
+        for (int64_t h = hour - steps + 1; h <= hour; ++h) buckets_[h % kBuckets].clear();
+        head_hour_ = hour;
+    }
+    if (hour <= head_hour_ - kBuckets) return;
+    auto &bucket = buckets_[hour % kBuckets];
+    float &total = bucket[post_id];
+    total += static_cast<float>(weight);
+    if (total == 0.0f) bucket.erase(post_id);
+}
+
+void InteractionWindow::erase(int post_id) {
+    for (auto &bucket : buckets_) bucket.erase(post_id);
+}
+
+void InteractionWindow::collect(int64_t now, int64_t window_seconds, vector<pair<int, float>> &out) const {
+    const int64_t now_hour = now / kBucketSeconds;
+    const int64_t hours = min<int64_t>(kBuckets, max<int64_t>(1, (window_seconds + kBucketSeconds - 1) / kBucketSeconds));
+    const int64_t first = max(now_hour - hours + 1, head_hour_ - kBuckets + 1);
+    const int64_t last = min(now_hour, head_hour_);
+    for (int64_t h = first; h <= last; ++h) {
+        const auto &bucket = buckets_[h % kBuckets];
+        out.insert(out.end(), bucket.begin(), bucket.end());
+    }
+}
+
+void InteractionWindow::clear() {
+    head_hour_ = 0;
+    for (auto &bucket : buckets_) bucket.clear();
+}
+
+size_t InteractionWindow::entries() const {
+    size_t n = 0;
+    for (const auto &bucket : buckets_) n += bucket.size();
+    return n;
+}
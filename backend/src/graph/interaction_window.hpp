@@ -0,0 +1,29 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Hourly ring of interaction weight covering the last week, kept per post
+// stripe: each hour maps only the posts that received weight in it, so the
+// weight inside any window up to 7 days is read from the posts active in it.
+class InteractionWindow {
+public:
+    static constexpr std::int64_t kBucketSeconds = 3600;
+    static constexpr int kBuckets = 168;
+
+    // Adds weight (negative to retract) to post_id at timestamp. Older than the ring: dropped.
+    void add(std::int64_t timestamp, int post_id, double weight);
+    void erase(int post_id);
+    // Appends (post id, weight) for every post-hour in (now - window_seconds, now],
+    // window capped at the ring length, oldest hour first.
+    void collect(std::int64_t now, std::int64_t window_seconds, std::vector<std::pair<int, float>> &out) const;
+    void clear();
+    std::size_t entries() const;  // post-hours held
+
+private:
+    std::int64_t head_hour_ = 0;  // newest hour the ring holds
+    std::array<std::unordered_map<int, float>, kBuckets> buckets_;
+};
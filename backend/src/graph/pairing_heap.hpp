@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Min pairing heap over caller-numbered items 0..n-1, with O(1) push and
+// decrease-key and amortized O(log n) pop (two-pass pairing). Item storage is
+// kept across clear(), so one heap can serve many searches without
+// reallocating.
+template <class Key>
+class PairingHeap {
+public:
+    static constexpr std::uint32_t kNil = 0xffffffffu;
+
+    bool empty() const { return root_ == kNil; }
+    std::uint32_t top() const { return root_; }
+    const Key &top_key() const { return nodes_[root_].key; }
+    const Key &key(std::uint32_t item) const { return nodes_[item].key; }
+    void clear() { root_ = kNil; }
+
+    // item must not be in the heap.
+    void push(std::uint32_t item, Key key) {
+        if (item >= nodes_.size()) nodes_.resize(item + 1);
+        nodes_[item] = Node{std::move(key), kNil, kNil, kNil};
+        root_ = root_ == kNil ? item : meld(root_, item);
+    }
+
+    // item must be in the heap and key no greater than its current key.
+    void decrease(std::uint32_t item, Key key) {
+        Node &n = nodes_[item];
+        n.key = std::move(key);
+        if (item == root_) return;
+        Node &prev = nodes_[n.prev];
+        if (prev.child == item) prev.child = n.sibling;
+        else prev.sibling = n.sibling;
+        if (n.sibling != kNil) nodes_[n.sibling].prev = n.prev;
+        n.prev = n.sibling = kNil;
+        root_ = meld(root_, item);
+    }
+
+    std::uint32_t pop() {
+        const std::uint32_t top = root_;
+        pairs_.clear();
+        for (std::uint32_t c = nodes_[top].child; c != kNil;) {
+            const std::uint32_t a = c, b = nodes_[a].sibling;
+            nodes_[a].prev = nodes_[a].sibling = kNil;
+            if (b == kNil) {
+                pairs_.push_back(a);
+                break;
+            }
+            c = nodes_[b].sibling;
+            nodes_[b].prev = nodes_[b].sibling = kNil;
+            pairs_.push_back(meld(a, b));
+        }
+        root_ = kNil;
+        for (auto it = pairs_.rbegin(); it != pairs_.rend(); ++it) root_ = root_ == kNil ? *it : meld(*it, root_);
+        nodes_[top].child = kNil;
+        return top;
+    }
+
+private:
+    struct Node {
+        Key key{};
+        std::uint32_t child = kNil;
+        std::uint32_t sibling = kNil;
+        std::uint32_t prev = kNil;  // parent if first child, else left sibling
+    };
+
+    // Both a and b are roots without siblings; returns the new root.
+    std::uint32_t meld(std::uint32_t a, std::uint32_t b) {
+        if (nodes_[b].key < nodes_[a].key) std::swap(a, b);
+        Node &parent = nodes_[a], &child = nodes_[b];
+        child.prev = a;
+        child.sibling = parent.child;
+        if (parent.child != kNil) nodes_[parent.child].prev = b;
+        parent.child = b;
+        return a;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<std::uint32_t> pairs_;
+    std::uint32_t root_ = kNil;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of worker threads worth using for n items when each worker should
+// get at least min_grain of them.
+inline std::size_t parallel_workers(std::size_t n, std::size_t min_grain) {
+    const std::size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t by_size = min_grain ? n / min_grain : n;
+    return std::max<std::size_t>(1, std::min(hw, by_size));
+}
+
+// Splits [0, n) into `workers` contiguous ranges and calls fn(worker, begin, end)
+// for each, running the last range on the calling thread. Ranges are in order,
+// so per-worker outputs concatenated by worker index preserve input order.
+template <typename Fn>
+void parallel_for_ranges(std::size_t n, std::size_t workers, Fn &&fn) {
+    if (n == 0) return;
+    workers = std::max<std::size_t>(1, std::min(workers, n));
+    if (workers == 1) {
+        fn(std::size_t(0), std::size_t(0), n);
+        return;
+    }
+    const std::size_t chunk = (n + workers - 1) / workers;
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (std::size_t w = 0; w + 1 < workers; ++w) {
+        const std::size_t begin = std::min(n, w * chunk);
+        const std::size_t end = std::min(n, begin + chunk);
+        threads.emplace_back([&fn, w, begin, end]() { fn(w, begin, end); });
+    }
+    const std::size_t last_begin = std::min(n, (workers - 1) * chunk);
+    fn(workers - 1, last_begin, n);
+    for (auto &t : threads) t.join();
+}
+
+// Like parallel_for_ranges, but workers claim `grain`-sized ranges from a
+// shared counter as they finish, so a few expensive items cannot leave the
+// other threads idle behind one slow contiguous range. Ranges are claimed in
+// order but finish in any order.
+template <typename Fn>
+void parallel_for_dynamic(std::size_t n, std::size_t workers, std::size_t grain, Fn &&fn) {
+    if (n == 0) return;
+    grain = std::max<std::size_t>(1, grain);
+    workers = std::max<std::size_t>(1, std::min(workers, (n + grain - 1) / grain));
+    std::atomic<std::size_t> next{0};
+    auto run = [&fn, &next, n, grain](std::size_t w) {
+        for (;;) {
+            const std::size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+            if (begin >= n) return;
+            fn(w, begin, std::min(n, begin + grain));
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (std::size_t w = 0; w + 1 < workers; ++w) threads.emplace_back(run, w);
+    run(workers - 1);
+    for (auto &t : threads) t.join();
+}
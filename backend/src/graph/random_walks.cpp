@@ -0,0 +1,423 @@
+#include "random_walks.hpp"
+#include <algorithm>
+
+using namespace std;
+
+RandomWalkIndex::RandomWalkIndex(const Options &options) : options_(options), rng_(options.seed) {
+    options_.segments_per_user = max<size_t>(1, options_.segments_per_user);
+    options_.max_segment_length = max<size_t>(2, options_.max_segment_length);
+}
+
+void RandomWalkIndex::add_post(int post_id, int author) { push(post_id, {EventType::AddPost, post_id, author}); }
+void RandomWalkIndex::remove_post(int post_id) { push(post_id, {EventType::RemovePost, post_id}); }
+void RandomWalkIndex::remove_user(int user_id) { push(user_id, {EventType::RemoveUser, user_id}); }
+void RandomWalkIndex::add_follow(int from, int to) { push(from, {EventType::AddFollow, from, to}); }
+void RandomWalkIndex::scale_weights(double factor) { push(0, {EventType::Scale, 0, 0, factor}); }
+
+void RandomWalkIndex::add_interaction(int user_id, int post_id, double weight_delta, int edge_delta) {
+    push(post_id, {EventType::Interaction, user_id, post_id, weight_delta, edge_delta});
+}
+
+void RandomWalkIndex::clear() {
+    lock_guard lock(mutex_);
+    for (auto &buffer : pending_) {
+        lock_guard pending_lock(buffer.mutex);
+        pending_count_ -= buffer.events.size();
+        buffer.events.clear();
+    }
+    clear_unlocked();
+}
+
+void RandomWalkIndex::clear_unlocked() {
+    users_.clear();
+    posts_.clear();
+    segments_.clear();
+    free_blocks_.clear();
+    live_segments_ = 0;
+}
+
+void RandomWalkIndex::push(int key, Event event) {
+    PendingBuffer &buffer = pending_[static_cast<unsigned>(key) % kPendingBuffers];
+    size_t pending = 0;
+    {
+        // numbered and counted under the buffer lock, so each buffer stays in
+        // sequence order and a drain holding every buffer sees exact counts
+        lock_guard pending_lock(buffer.mutex);
+        event.sequence = next_sequence_.fetch_add(1, memory_order_relaxed);
+        buffer.events.push_back(event);
+        pending = pending_count_.fetch_add(1, memory_order_relaxed) + 1;
+    }
+    // without queries nothing would ever drain the buffers
+    if (pending >= kMaxPending) {
+        lock_guard lock(mutex_);
+        drain_unlocked();
+    }
+}
+
+void RandomWalkIndex::drain_unlocked() {
+    vector<Event> events;
+    {
+        // every buffer at once: a change numbered after one still waiting in
+        // another buffer must not be applied before it
+        vector<unique_lock<mutex>> locks;
+        locks.reserve(kPendingBuffers);
+        for (auto &buffer : pending_) locks.emplace_back(buffer.mutex);
+        for (auto &buffer : pending_) {
+            if (events.empty()) events.swap(buffer.events);
+            else events.insert(events.end(), buffer.events.begin(), buffer.events.end());
+            buffer.events.clear();
+        }
+        pending_count_ -= events.size();
+    }
+    // runs from different buffers interleave; each run is already in order
+    sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.sequence < b.sequence; });
+    for (const Event &e : events) apply_unlocked(e);
+}
+
+void RandomWalkIndex::apply_unlocked(const Event &event) {
+    switch (event.type) {
+    case EventType::AddPost:
+        posts_[event.a].author = event.b;
+        break;
+    case EventType::RemovePost: {
+        auto post = posts_.find(event.a);
+        if (post == posts_.end()) break;
+        const vector<int> users = post->second.users;
+        for (int u : users) {
+            auto user = users_.find(u);
+            if (user != users_.end()) remove_post_edge_unlocked(u, user->second, event.a);
+        }
+        posts_.erase(event.a);
+        break;
+    }
+    case EventType::RemoveUser: {
+        auto it = users_.find(event.a);
+        if (it == users_.end()) break;
+        UserNode &user = it->second;
+        const vector<int> followers = user.followers;
+        for (int f : followers) {
+            auto follower = users_.find(f);
+            if (follower != users_.end()) remove_followee_unlocked(f, follower->second, event.a);
+        }
+        for (int g : user.followees) {
+            auto followee = users_.find(g);
+            if (followee == users_.end()) continue;
+            auto &list = followee->second.followers;
+            auto pos = lower_bound(list.begin(), list.end(), event.a);
+            if (pos != list.end() && *pos == event.a) list.erase(pos);
+        }
+        for (const PostEdge &e : user.posts) {
+            auto post = posts_.find(e.post_id);
+            if (post == posts_.end()) continue;
+            auto &list = post->second.users;
+            auto pos = lower_bound(list.begin(), list.end(), event.a);
+            if (pos != list.end() && *pos == event.a) list.erase(pos);
+        }
+        if (user.first_segment != kNoSegments) {
+            for (size_t i = 0; i < options_.segments_per_user; ++i) segments_[user.first_segment + i].clear();
+            free_blocks_.push_back(user.first_segment);
+            live_segments_ -= options_.segments_per_user;
+        }
+        // only steps in through the user's own posts can be left; end those walks before the user
+        const int self = user_node(event.a);
+        for (uint32_t s : user.visits) {
+            auto &seg = segments_[s];
+            auto pos = find(seg.begin(), seg.end(), self);
+            if (pos != seg.end()) seg.erase(pos, seg.end());
+        }
+        users_.erase(it);
+        break;
+    }
+    case EventType::AddFollow: {
+        UserNode &user = users_[event.a];
+        auto pos = lower_bound(user.followees.begin(), user.followees.end(), event.b);
+        if (pos != user.followees.end() && *pos == event.b) break;
+        const Shape before{user.followees.size(), user.post_weight};
+        user.followees.insert(pos, event.b);
+        auto &followers = users_[event.b].followers;
+        followers.insert(lower_bound(followers.begin(), followers.end(), event.a), event.a);
+        repair_unlocked(event.a, user, before, user_node(event.b), 0.0, 1.0);
+        break;
+    }
+    case EventType::Interaction: {
+        auto post = posts_.find(event.b);
+        if (post == posts_.end()) break;
+        UserNode &user = users_[event.a];
+        auto e = lower_bound(user.posts.begin(), user.posts.end(), event.b,
+                             [](const PostEdge &edge, int id) { return edge.post_id < id; });
+        if (e == user.posts.end() || e->post_id != event.b) {
+            if (event.count <= 0) break;
+            const Shape before{user.followees.size(), user.post_weight};
+            const double weight = max(0.0, event.weight);
+            user.posts.insert(e, PostEdge{event.b, event.count, weight});
+            user.post_weight += weight;
+            auto &users = post->second.users;
+            users.insert(lower_bound(users.begin(), users.end(), event.a), event.a);
+            repair_unlocked(event.a, user, before, post_node(event.b), 0.0, weight);
+            break;
+        }
+        e->edges += event.count;
+        if (e->edges <= 0) {
+            remove_post_edge_unlocked(event.a, user, event.b);
+            break;
+        }
+        const double weight = max(0.0, e->weight + event.weight);
+        user.post_weight = max(0.0, user.post_weight + weight - e->weight);
+        e->weight = weight;
+        break;
+    }
+    case EventType::Scale:
+        // every share is unchanged, so no step needs repair
+        for (auto &u : users_) {
+            u.second.post_weight *= event.weight;
+            for (PostEdge &e : u.second.posts) e.weight *= event.weight;
+        }
+        break;
+    }
+}
+
+void RandomWalkIndex::remove_post_edge_unlocked(int user_id, UserNode &user, int post_id) {
+    auto e = lower_bound(user.posts.begin(), user.posts.end(), post_id,
+                         [](const PostEdge &edge, int id) { return edge.post_id < id; });
+    if (e == user.posts.end() || e->post_id != post_id) return;
+    const Shape before{user.followees.size(), user.post_weight};
+    const double weight = e->weight;
+    user.posts.erase(e);
+    user.post_weight = user.posts.empty() ? 0.0 : max(0.0, user.post_weight - weight);
+    auto post = posts_.find(post_id);
+    if (post != posts_.end()) {
+        auto &users = post->second.users;
+        auto pos = lower_bound(users.begin(), users.end(), user_id);
+        if (pos != users.end() && *pos == user_id) users.erase(pos);
+    }
+    repair_unlocked(user_id, user, before, post_node(post_id), weight, 0.0);
+}
+
+void RandomWalkIndex::remove_followee_unlocked(int user_id, UserNode &user, int followee) {
+    auto pos = lower_bound(user.followees.begin(), user.followees.end(), followee);
+    if (pos == user.followees.end() || *pos != followee) return;
+    const Shape before{user.followees.size(), user.post_weight};
+    user.followees.erase(pos);
+    repair_unlocked(user_id, user, before, user_node(followee), 1.0, 0.0);
+}
+
+// Every stored step out of the user was drawn from the `before` distribution
+// P. Keeping each step with probability min(1, Q/P) and otherwise redrawing it
+// from the surplus (Q - P)+ yields a draw from the new distribution Q, so only
+// the rerouted steps (and the walk after them) are resampled.
+void RandomWalkIndex::repair_unlocked(int user_id, UserNode &user, const Shape &before, int changed,
+                                      double before_weight, double after_weight) {
+    if (user.visits.empty()) return;
+    const Shape after{user.followees.size(), user.post_weight};
+    auto weights = [&](int next) {
+        const double current = next == changed ? after_weight : edge_weight(user, next);
+        return make_pair(next == changed ? before_weight : current, current);
+    };
+
+    vector<uint32_t> candidates;
+    candidates.swap(user.visits);  // rerouted walks may add fresh visits meanwhile
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+    const int self = user_node(user_id);
+    vector<uint32_t> still_visiting;
+    for (uint32_t s : candidates) {
+        bool visits = false;
+        for (size_t i = 0; i < segments_[s].size(); ++i) {
+            if (segments_[s][i] != self) continue;
+            visits = true;
+            if (i + 1 >= options_.max_segment_length) break;  // truncated, not a sampled step
+            const int next = i + 1 < segments_[s].size() ? segments_[s][i + 1] : kTerminal;
+            const auto [w_before, w_after] = weights(next);
+            const double p = step_probability(before, next, w_before);
+            const double q = step_probability(after, next, w_after);
+            if (q >= p || unit() * p < q) continue;
+
+            int step = kTerminal;
+            for (int attempt = 0; attempt < 64; ++attempt) {
+                step = unit() < options_.restart ? kTerminal : sample_edge(user);
+                const auto [s_before, s_after] = weights(step);
+                const double qs = step_probability(after, step, s_after);
+                const double ps = step_probability(before, step, s_before);
+                if (qs > ps && unit() * qs < qs - ps) break;
+            }
+            segments_[s].resize(i + 1);
+            if (step != kTerminal) {
+                segments_[s].push_back(step);
+                if (!is_post(step)) note_visit(node_id(step), s);
+                extend_unlocked(s);
+            }
+            break;
+        }
+        if (visits) still_visiting.push_back(s);
+    }
+    user.visits.insert(user.visits.end(), still_visiting.begin(), still_visiting.end());
+}
+
+double RandomWalkIndex::step_probability(const Shape &shape, int next, double edge_weight) const {
+    const bool follows = shape.followees > 0, posts = shape.post_weight > 0.0;
+    if (next == kTerminal) return follows || posts ? options_.restart : 1.0;
+    if (edge_weight <= 0.0) return 0.0;
+    const double move = 1.0 - options_.restart;
+    const double follow_share = follows ? (posts ? options_.follow_share : 1.0) : 0.0;
+    if (!is_post(next)) return follows ? move * follow_share / static_cast<double>(shape.followees) : 0.0;
+    return posts ? move * (1.0 - follow_share) * edge_weight / shape.post_weight : 0.0;
+}
+
+double RandomWalkIndex::edge_weight(const UserNode &user, int next) const {
+    if (next == kTerminal) return 0.0;
+    if (!is_post(next)) return binary_search(user.followees.begin(), user.followees.end(), node_id(next)) ? 1.0 : 0.0;
+    auto e = lower_bound(user.posts.begin(), user.posts.end(), node_id(next),
+                         [](const PostEdge &edge, int id) { return edge.post_id < id; });
+    return e != user.posts.end() && e->post_id == node_id(next) ? e->weight : 0.0;
+}
+
+int RandomWalkIndex::sample_edge(const UserNode &user) {
+    const bool follows = !user.followees.empty(), posts = user.post_weight > 0.0;
+    if (!follows && !posts) return kTerminal;
+    if (follows && (!posts || unit() < options_.follow_share)) {
+        return user_node(user.followees[rng_() % user.followees.size()]);
+    }
+    double target = unit() * user.post_weight;
+    for (const PostEdge &e : user.posts) {
+        target -= e.weight;
+        if (target < 0.0) return post_node(e.post_id);
+    }
+    return post_node(user.posts.back().post_id);  // rounding
+}
+
+void RandomWalkIndex::note_visit(int user_id, uint32_t segment) {
+    auto &visits = users_[user_id].visits;
+    if (visits.empty() || visits.back() != segment) visits.push_back(segment);
+}
+
+// Continues a walk from its last node until it restarts, dead-ends or hits
+// the length cap.
+void RandomWalkIndex::extend_unlocked(uint32_t segment) {
+    vector<int> &seg = segments_[segment];
+    while (seg.size() < options_.max_segment_length) {
+        if (unit() < options_.restart) return;
+        const int node = seg.back();
+        int next = kTerminal;
+        if (is_post(node)) {
+            auto post = posts_.find(node_id(node));
+            if (post == posts_.end()) return;
+            next = user_node(post->second.author);
+        } else {
+            auto user = users_.find(node_id(node));
+            if (user == users_.end()) return;
+            next = sample_edge(user->second);
+            if (next == kTerminal) return;
+        }
+        seg.push_back(next);
+        if (!is_post(next)) note_visit(node_id(next), segment);
+    }
+}
+
+void RandomWalkIndex::ensure_segments_unlocked(int user_id) {
+    UserNode &user = users_[user_id];
+    if (user.first_segment != kNoSegments) return;
+    const size_t count = options_.segments_per_user;
+    if (!free_blocks_.empty()) {
+        user.first_segment = free_blocks_.back();
+        free_blocks_.pop_back();
+    } else {
+        user.first_segment = static_cast<uint32_t>(segments_.size());
+        segments_.resize(segments_.size() + count);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t s = user.first_segment + static_cast<uint32_t>(i);
+        segments_[s].assign(1, user_node(user_id));
+        note_visit(user_id, s);
+        extend_unlocked(s);
+    }
+    live_segments_ += count;
+}
+
+WalkRecommendations RandomWalkIndex::query(int user_id, size_t k) {
+    lock_guard lock(mutex_);
+    drain_unlocked();
+    WalkRecommendations out;
+    auto it = users_.find(user_id);
+    if (it == users_.end() || k == 0) return out;
+    const UserNode &user = it->second;
+    ensure_segments_unlocked(user_id);
+
+    // The user's own segments are exact walks; the rest take a fresh first
+    // step and reuse a stored segment of wherever it lands.
+    const size_t per_user = options_.segments_per_user;
+    unordered_map<int, double> visits;
+    double total = 0.0;
+    auto count_segment = [&](uint32_t s) {
+        for (int node : segments_[s]) visits[node] += 1.0;
+        total += static_cast<double>(segments_[s].size());
+    };
+    for (size_t n = 0; n < options_.query_walks; ++n) {
+        if (n < per_user) {
+            count_segment(user.first_segment + static_cast<uint32_t>(n));
+            continue;
+        }
+        visits[user_node(user_id)] += 1.0;
+        total += 1.0;
+        if (unit() < options_.restart) continue;
+        int next = sample_edge(user);
+        if (next == kTerminal) continue;
+        if (is_post(next)) {
+            visits[next] += 1.0;
+            total += 1.0;
+            if (unit() < options_.restart) continue;
+            auto post = posts_.find(node_id(next));
+            if (post == posts_.end()) continue;
+            next = user_node(post->second.author);
+        }
+        const int owner = node_id(next);
+        ensure_segments_unlocked(owner);
+        count_segment(users_[owner].first_segment + static_cast<uint32_t>(rng_() % per_user));
+    }
+
+    for (const auto &[node, hits] : visits) {
+        const int id = node_id(node);
+        const double score = hits / total;
+        if (is_post(node)) {
+            auto post = posts_.find(id);
+            if (post == posts_.end() || post->second.author == user_id) continue;
+            if (edge_weight(user, node) > 0.0) continue;
+            out.posts.emplace_back(id, score);
+        } else {
+            if (id == user_id || !users_.count(id)) continue;
+            if (binary_search(user.followees.begin(), user.followees.end(), id)) continue;
+            out.users.emplace_back(id, score);
+        }
+    }
+    auto best_first = [](const pair<int, double> &a, const pair<int, double> &b) {
+        if (a.second != b.second) return a.second > b.second;
+        return a.first < b.first;
+    };
+    for (auto *list : {&out.users, &out.posts}) {
+        const size_t keep = min(k, list->size());
+        partial_sort(list->begin(), list->begin() + keep, list->end(), best_first);
+        list->resize(keep);
+    }
+    return out;
+}
+
+RandomWalkIndex::Stats RandomWalkIndex::stats() {
+    lock_guard lock(mutex_);
+    Stats out;
+    out.pending = pending_count_.load(memory_order_relaxed);
+    constexpr size_t kNodeBytes = 32;
+    out.users = users_.size();
+    out.segments = live_segments_;
+    size_t bytes = segments_.capacity() * sizeof(vector<int>) + free_blocks_.capacity() * sizeof(uint32_t);
+    for (const auto &seg : segments_) {
+        out.steps += seg.size();
+        bytes += seg.capacity() * sizeof(int);
+    }
+    for (const auto &u : users_) {
+        const UserNode &n = u.second;
+        bytes += sizeof(u) + kNodeBytes + (n.followees.capacity() + n.followers.capacity()) * sizeof(int) +
+            n.posts.capacity() * sizeof(PostEdge) + n.visits.capacity() * sizeof(uint32_t);
+    }
+    for (const auto &p : posts_) bytes += sizeof(p) + kNodeBytes + p.second.users.capacity() * sizeof(int);
+    out.memory_bytes = bytes;
+    return out;
+}
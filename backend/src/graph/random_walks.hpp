@@ -0,0 +1,150 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Top personalized PageRank estimates for one user, best first.
+struct WalkRecommendations {
+    std::vector<std::pair<int, double>> users;  // (user id, PPR mass); not the user or its followees
+    std::vector<std::pair<int, double>> posts;  // (post id, PPR mass); not its own or already seen
+};
+
+// Personalized PageRank by Monte Carlo walks with restart over users and
+// posts. A user steps to a followee or to a post it liked or viewed (by
+// decayed interaction weight), a post steps to its author, and every step
+// restarts with probability `restart`.
+//
+// A user's walk segments are sampled the first time they are needed and then
+// kept. A query samples a fresh first step from the user and stitches on a
+// stored segment of the neighbour it lands on. When an edge at a user changes,
+// only the stored steps leaving that user are revisited, and each is resampled
+// with just the probability that makes it a sample of the new graph again
+// (Bahmani et al., "Fast incremental and personalized PageRank"). Weight-only
+// changes are not repaired; new steps always use the current weights.
+//
+// Writers only append edge changes to one of several buffers, picked by the
+// post (or user) the change is about, under that buffer's short lock; writers
+// on different post stripes of the graph do not share one. Each change takes
+// a sequence number, and the next query applies them all in that order. The
+// index never calls back into the graph, so it may be updated under any of
+// the graph's locks.
+class RandomWalkIndex {
+public:
+    struct Options {
+        double restart = 0.15;             // matches PageRank's 0.85 damping
+        double follow_share = 0.5;         // chance of a follow step when a user has both kinds of edge
+        std::size_t segments_per_user = 8;
+        std::size_t max_segment_length = 64;
+        std::size_t query_walks = 2000;
+        std::uint64_t seed = 0x9e3779b97f4a7c15ull;
+    };
+    struct Stats {
+        std::size_t users = 0;
+        std::size_t segments = 0;
+        std::size_t steps = 0;
+        std::size_t pending = 0;
+        std::size_t memory_bytes = 0;
+    };
+
+    RandomWalkIndex() : RandomWalkIndex(Options{}) {}
+    explicit RandomWalkIndex(const Options &options);
+
+    // Edge changes, in the order the graph applied them.
+    void add_post(int post_id, int author);
+    void remove_post(int post_id);
+    void remove_user(int user_id);
+    void add_follow(int from, int to);
+    // edge_delta is +1 when a like or view edge appears, -1 when one goes,
+    // 0 when an existing one is re-weighted; likes and views of the same
+    // post are one walk edge.
+    void add_interaction(int user_id, int post_id, double weight_delta, int edge_delta);
+    void scale_weights(double factor);  // every interaction weight, e.g. on a decay rebase
+    void clear();
+
+    WalkRecommendations query(int user_id, std::size_t k);
+    Stats stats();
+
+private:
+    enum class EventType { AddPost, RemovePost, RemoveUser, AddFollow, Interaction, Scale };
+    struct Event {
+        EventType type;
+        int a = 0;
+        int b = 0;
+        double weight = 0.0;
+        int count = 0;
+        std::uint64_t sequence = 0;  // order of push()
+    };
+    struct PostEdge {
+        int post_id = 0;
+        int edges = 0;  // like and/or view
+        double weight = 0.0;
+    };
+    struct UserNode {
+        std::vector<int> followees;     // ascending
+        std::vector<int> followers;     // ascending
+        std::vector<PostEdge> posts;    // ascending post_id
+        double post_weight = 0.0;
+        std::uint32_t first_segment = kNoSegments;
+        std::vector<std::uint32_t> visits;  // segments that may pass through; may hold stale entries
+    };
+    struct PostNode {
+        int author = 0;
+        std::vector<int> users;  // ascending; users with an edge to the post
+    };
+    // The part of a user's step distribution an edge change can alter.
+    struct Shape {
+        std::size_t followees = 0;
+        double post_weight = 0.0;
+    };
+
+    static constexpr std::uint32_t kNoSegments = 0xffffffffu;
+    static constexpr int kTerminal = -1;
+    // Walk nodes: users are even, posts odd.
+    static int user_node(int user_id) { return user_id * 2; }
+    static int post_node(int post_id) { return post_id * 2 + 1; }
+    static bool is_post(int node) { return (node & 1) != 0; }
+    static int node_id(int node) { return node >> 1; }
+
+    void push(int key, Event event);  // key picks the pending buffer
+    void drain_unlocked();
+    void apply_unlocked(const Event &event);
+    void clear_unlocked();
+
+    void remove_post_edge_unlocked(int user_id, UserNode &user, int post_id);
+    void remove_followee_unlocked(int user_id, UserNode &user, int followee);
+    void repair_unlocked(int user_id, UserNode &user, const Shape &before, int changed, double before_weight,
+                         double after_weight);
+
+    double unit() { return std::uniform_real_distribution<double>(0.0, 1.0)(rng_); }
+    double step_probability(const Shape &shape, int next, double edge_weight) const;
+    double edge_weight(const UserNode &user, int next) const;
+    int sample_edge(const UserNode &user);
+    void extend_unlocked(std::uint32_t segment);
+    void ensure_segments_unlocked(int user_id);
+    void note_visit(int user_id, std::uint32_t segment);
+
+    Options options_;
+    std::mutex mutex_;  // everything below except pending_
+    std::unordered_map<int, UserNode> users_;
+    std::unordered_map<int, PostNode> posts_;
+    std::vector<std::vector<int>> segments_;  // walk nodes, starting at the owning user
+    std::vector<std::uint32_t> free_blocks_;  // first segment of each released block
+    std::size_t live_segments_ = 0;
+    std::mt19937_64 rng_;
+
+    static constexpr std::size_t kMaxPending = 1 << 16;  // writers apply the buffers themselves past this
+    static constexpr std::size_t kPendingBuffers = 64;
+    struct alignas(64) PendingBuffer {
+        std::mutex mutex;  // taken after mutex_ when both are held
+        std::vector<Event> events;
+    };
+    std::array<PendingBuffer, kPendingBuffers> pending_;
+    std::atomic<std::uint64_t> next_sequence_{0};
+    std::atomic<std::size_t> pending_count_{0};
+};
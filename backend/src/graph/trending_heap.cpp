@@ -0,0 +1,87 @@
+#include "trending_heap.hpp"
+#include <queue>
+
+using namespace std;
+
+void TrendingHeap::place(size_t i, const TrendingEntry &entry) {
+    heap_[i] = entry;
+    position_[entry.post_id] = i;
+}
+
+void TrendingHeap::sift_up(size_t i) {
+    const TrendingEntry entry = heap_[i];
+    while (i > 0) {
+        const size_t parent = (i - 1) / 2;
+        if (!ranks_before(entry, heap_[parent])) break;
+        place(i, heap_[parent]);
+        i = parent;
+    }
+    place(i, entry);
+}
+
+void TrendingHeap::sift_down(size_t i) {
+    const TrendingEntry entry = heap_[i];
+    const size_t n = heap_.size();
+    while (true) {
+        size_t best = 2 * i + 1;
+        if (best >= n) break;
+        if (best + 1 < n && ranks_before(heap_[best + 1], heap_[best])) ++best;
+        if (!ranks_before(heap_[best], entry)) break;
+        place(i, heap_[best]);
+        i = best;
+    }
+    place(i, entry);
+}
+
+void TrendingHeap::update(int post_id, double score) {
+    auto it = position_.find(post_id);
+    if (it == position_.end()) {
+        heap_.push_back({score, post_id});
+        position_[post_id] = heap_.size() - 1;
+        sift_up(heap_.size() - 1);
+        return;
+    }
+    const size_t i = it->second;
+    const double old_score = heap_[i].score;
+    heap_[i].score = score;
+    if (score > old_score) sift_up(i);
+    else if (score < old_score) sift_down(i);
+}
+
+void TrendingHeap::erase(int post_id) {
+    auto it = position_.find(post_id);
+    if (it == position_.end()) return;
+    const size_t i = it->second;
+    position_.erase(it);
+    const TrendingEntry last = heap_.back();
+    heap_.pop_back();
+    if (i == heap_.size()) return;
+    place(i, last);
+    sift_up(i);
+    sift_down(position_[last.post_id]);
+}
+
+void TrendingHeap::scale(double factor) {
+    for (auto &entry : heap_) entry.score *= factor;
+}
+
+void TrendingHeap::clear() {
+    heap_.clear();
+    position_.clear();
+}
+
+void TrendingHeap::top(size_t k, vector<TrendingEntry> &out) const {
+    if (heap_.empty() || k == 0) return;
+    // Walk the heap best-first: a node's children are only candidates once it is taken.
+    auto worse = [this](size_t a, size_t b) { return ranks_before(heap_[b], heap_[a]); };
+    priority_queue<size_t, vector<size_t>, decltype(worse)> frontier(worse);
+    frontier.push(0);
+    while (!frontier.empty() && k > 0) {
+        const size_t i = frontier.top();
+        frontier.pop();
+        out.push_back(heap_[i]);
+        --k;
+        if (2 * i + 1 < heap_.size()) frontier.push(2 * i + 1);
+        if (2 * i + 2 < heap_.size()) frontier.push(2 * i + 2);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+struct TrendingEntry {
+    double score = 0.0;
+    int post_id = 0;
+};
+
+// Indexed binary max-heap of post scores. update() moves an entry up or down
+// in O(log n), so scores can rise on new interactions and fall when
+// interactions are removed, without rebuilding the heap.
+class TrendingHeap {
+public:
+    void update(int post_id, double score);
+    void erase(int post_id);
+    void scale(double factor);  // multiplies every score; order is unchanged
+    void clear();
+    std::size_t size() const { return heap_.size(); }
+
+    // Appends the k best entries in descending order, in O(k log k).
+    void top(std::size_t k, std::vector<TrendingEntry> &out) const;
+
+    // Descending score, ties broken by lower post id.
+    static bool ranks_before(const TrendingEntry &a, const TrendingEntry &b) {
+        if (a.score != b.score) return a.score > b.score;
+        return a.post_id < b.post_id;
+    }
+
+private:
+    void sift_up(std::size_t i);
+    void sift_down(std::size_t i);
+    void place(std::size_t i, const TrendingEntry &entry);
+
+    std::vector<TrendingEntry> heap_;
+    std::unordered_map<int, std::size_t> position_;
+};
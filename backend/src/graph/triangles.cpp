@@ -0,0 +1,137 @@
+#include "triangles.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Calls on_match(x) for every x in both ascending, duplicate-free lists.
+template <class Fn>
+void intersect(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, Fn &&on_match) {
+    if (na > nb) {
+        swap(a, b);
+        swap(na, nb);
+    }
+    if (na * 32 < nb) {
+        // a hub against a short list: binary search beats walking the hub's list
+        const uint32_t *from = b, *end = b + nb;
+        for (size_t i = 0; i < na && from != end; ++i) {
+            from = lower_bound(from, end, a[i]);
+            if (from != end && *from == a[i]) on_match(a[i]);
+        }
+        return;
+    }
+    size_t i = 0, j = 0;
+#ifdef __SSE2__
+    // Compare four of a against all four rotations of four of b, then move on
+    // from whichever block ends lower (both when they end on the same value).
+    while (i + 4 <= na && j + 4 <= nb) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+        __m128i eq = _mm_cmpeq_epi32(va, vb);
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+        for (int mask = _mm_movemask_ps(_mm_castsi128_ps(eq)); mask != 0; mask &= mask - 1) {
+            on_match(a[i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)))]);
+        }
+        const uint32_t a_last = a[i + 3], b_last = b[j + 3];
+        if (a_last <= b_last) i += 4;
+        if (b_last <= a_last) j += 4;
+    }
+#endif
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            ++i;
+        } else if (b[j] < a[i]) {
+            ++j;
+        } else {
+            on_match(a[i]);
+            ++i;
+            ++j;
+        }
+    }
+}
+
+} // namespace
+
+TriangleCounts count_triangles(const vector<size_t> &offsets, const vector<uint32_t> &neighbours) {
+    TriangleCounts out;
+    const size_t n = offsets.empty() ? 0 : offsets.size() - 1;
+    out.per_vertex.assign(n, 0);
+    if (n == 0) return out;
+    auto degree = [&](size_t v) { return offsets[v + 1] - offsets[v]; };
+
+    vector<uint32_t> order(n);
+    iota(order.begin(), order.end(), 0u);
+    stable_sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) { return degree(x) < degree(y); });
+    vector<uint32_t> rank(n);
+    for (size_t r = 0; r < n; ++r) rank[order[r]] = static_cast<uint32_t>(r);
+    for (size_t v = 0; v < n; ++v) {
+        const uint64_t d = degree(v);
+        if (d >= 2) out.wedges += d * (d - 1) / 2;
+    }
+
+    // Each edge kept once, at its lower-ranked end; vertices are renamed to
+    // their ranks, so "later in the list" means "higher ranked".
+    vector<size_t> out_offsets(n + 1, 0);
+    for (size_t v = 0; v < n; ++v) {
+        for (size_t i = offsets[v]; i < offsets[v + 1]; ++i) {
+            if (rank[neighbours[i]] > rank[v]) ++out_offsets[rank[v] + 1];
+        }
+    }
+    for (size_t r = 0; r < n; ++r) out_offsets[r + 1] += out_offsets[r];
+    vector<uint32_t> out_targets(out_offsets[n]);
+    {
+        vector<size_t> next(out_offsets.begin(), out_offsets.end() - 1);
+        for (size_t v = 0; v < n; ++v) {
+            for (size_t i = offsets[v]; i < offsets[v + 1]; ++i) {
+                const uint32_t w = rank[neighbours[i]];
+                if (w > rank[v]) out_targets[next[rank[v]]++] = w;
+            }
+        }
+    }
+    const size_t workers = parallel_workers(out_targets.size(), 1 << 14);
+    parallel_for_ranges(n, workers, [&](size_t, size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            sort(out_targets.begin() + static_cast<ptrdiff_t>(out_offsets[r]),
+                 out_targets.begin() + static_cast<ptrdiff_t>(out_offsets[r + 1]));
+        }
+    });
+
+    // Triangle a < b < c is found once, at a, as c in out(a) past b and in
+    // out(b). Every corner is credited; c's credits come from other threads.
+    vector<atomic<uint64_t>> counts(n);  // by rank
+    vector<uint64_t> found(workers, 0);
+    const uint32_t *targets = out_targets.data();
+    parallel_for_dynamic(n, workers, 64, [&](size_t w, size_t begin, size_t end) {
+        for (size_t a = begin; a < end; ++a) {
+            const uint32_t *a_out = targets + out_offsets[a];
+            const size_t a_n = out_offsets[a + 1] - out_offsets[a];
+            uint64_t at_a = 0;
+            for (size_t k = 0; k + 1 < a_n; ++k) {
+                const uint32_t b = a_out[k];
+                uint64_t at_b = 0;
+                intersect(a_out + k + 1, a_n - k - 1, targets + out_offsets[b], out_offsets[b + 1] - out_offsets[b],
+                          [&](uint32_t c) {
+                              ++at_b;
+                              counts[c].fetch_add(1, memory_order_relaxed);
+                          });
+                if (at_b > 0) counts[b].fetch_add(at_b, memory_order_relaxed);
+                at_a += at_b;
+            }
+            if (at_a > 0) counts[a].fetch_add(at_a, memory_order_relaxed);
+            found[w] += at_a;
+        }
+    });
+
+    for (uint64_t f : found) out.triangles += f;
+    for (size_t v = 0; v < n; ++v) out.per_vertex[v] = counts[rank[v]].load(memory_order_relaxed);
+    return out;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct TriangleCounts {
+    std::vector<std::uint64_t> per_vertex;  // triangles through each vertex
+    std::uint64_t triangles = 0;            // distinct triangles in the graph
+    std::uint64_t wedges = 0;               // paths of length two, sum of d(d-1)/2
+
+    // Share of a vertex's neighbour pairs that are themselves connected.
+    static double local_clustering(std::uint64_t triangles, std::size_t degree) {
+        return degree < 2 ? 0.0
+                          : 2.0 * static_cast<double>(triangles) /
+                                (static_cast<double>(degree) * static_cast<double>(degree - 1));
+    }
+};
+
+// Counts triangles in an undirected simple graph given as CSR: the neighbours
+// of v are neighbours[offsets[v] .. offsets[v + 1]), with no self loops or
+// duplicates, in any order.
+//
+// Edges are oriented from lower to higher (degree, vertex) rank, so every
+// vertex keeps at most O(sqrt(edges)) out-neighbours and each triangle is
+// found exactly once, by intersecting the sorted out-lists of an edge's two
+// ends. Vertices are handed to threads in small chunks on demand, since the
+// cost per vertex is very uneven on a skewed graph.
+TriangleCounts count_triangles(const std::vector<std::size_t> &offsets, const std::vector<std::uint32_t> &neighbours);
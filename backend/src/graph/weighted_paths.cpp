@@ -0,0 +1,162 @@
+#include "weighted_paths.hpp"
+#include "pairing_heap.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t kNone = 0xffffffffu;
+
+// One direction of a search. Per-user state lives in arrays indexed by the
+// order users were first reached, found through a generation-stamped slot
+// map, so a search costs O(users touched) rather than O(all users).
+struct SearchSide {
+    vector<uint32_t> stamp;  // by slot
+    vector<uint32_t> local;  // by slot, valid when stamp matches
+    uint32_t generation = 0;
+    vector<uint32_t> slot_of, parent, hops;  // by local index
+    vector<double> dist;
+    vector<unsigned char> settled;
+    PairingHeap<double> heap;
+
+    void reset(size_t users) {
+        if (stamp.size() != users) {
+            stamp.assign(users, 0);
+            local.assign(users, 0);
+            generation = 0;
+        }
+        if (++generation == 0) {
+            fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+        slot_of.clear();
+        parent.clear();
+        hops.clear();
+        dist.clear();
+        settled.clear();
+        heap.clear();
+    }
+    uint32_t find(uint32_t slot) const { return stamp[slot] == generation ? local[slot] : kNone; }
+    uint32_t reach(uint32_t slot) {
+        if (stamp[slot] == generation) return local[slot];
+        stamp[slot] = generation;
+        local[slot] = static_cast<uint32_t>(slot_of.size());
+        slot_of.push_back(slot);
+        parent.push_back(kNone);
+        hops.push_back(0);
+        dist.push_back(numeric_limits<double>::infinity());
+        settled.push_back(0);
+        return local[slot];
+    }
+};
+
+} // namespace
+
+WeightedUserGraph::WeightedUserGraph(const DenseIdMap &users, const vector<Edge> &edges)
+    : users_(users), out_offsets_(users.size() + 1, 0), in_offsets_(users.size() + 1, 0) {
+    out_targets_.reserve(edges.size());
+    out_costs_.reserve(edges.size());
+    for (const Edge &e : edges) {
+        ++out_offsets_[e.from + 1];
+        ++in_offsets_[e.to + 1];
+        out_targets_.push_back(e.to);
+        out_costs_.push_back(e.cost);
+    }
+    for (size_t s = 0; s < users.size(); ++s) {
+        out_offsets_[s + 1] += out_offsets_[s];
+        in_offsets_[s + 1] += in_offsets_[s];
+    }
+    in_sources_.resize(edges.size());
+    in_costs_.resize(edges.size());
+    vector<size_t> next(in_offsets_.begin(), in_offsets_.end() - 1);
+    for (const Edge &e : edges) {
+        const size_t at = next[e.to]++;
+        in_sources_[at] = e.from;
+        in_costs_[at] = e.cost;
+    }
+}
+
+size_t WeightedUserGraph::memory_bytes() const {
+    return users_.size() * sizeof(int) + (out_offsets_.capacity() + in_offsets_.capacity()) * sizeof(size_t) +
+        (out_targets_.capacity() + in_sources_.capacity()) * sizeof(uint32_t) +
+        (out_costs_.capacity() + in_costs_.capacity()) * sizeof(double);
+}
+
+WeightedPath WeightedUserGraph::shortest_path(int from, int to, const WeightedPathOptions &options) const {
+    WeightedPath result;
+    const int s = users_.slot(from), t = users_.slot(to);
+    if (s < 0 || t < 0) return result;
+    if (s == t) {
+        result.users.push_back(from);
+        return result;
+    }
+
+    thread_local SearchSide forward, backward;
+    forward.reset(users_.size());
+    backward.reset(users_.size());
+    const uint32_t unbounded = numeric_limits<uint32_t>::max();
+    const uint32_t hop_limit[2] = {
+        options.max_hops > 0 ? static_cast<uint32_t>(options.max_hops + 1) / 2 : unbounded,
+        options.max_hops > 0 ? static_cast<uint32_t>(options.max_hops) / 2 : unbounded,
+    };
+    SearchSide *sides[2] = {&forward, &backward};
+    for (int d = 0; d < 2; ++d) {
+        const uint32_t start = sides[d]->reach(static_cast<uint32_t>(d == 0 ? s : t));
+        sides[d]->dist[start] = 0.0;
+        sides[d]->heap.push(start, 0.0);
+    }
+
+    double best = numeric_limits<double>::infinity();
+    uint32_t meet = kNone;  // slot
+    while (!forward.heap.empty() && !backward.heap.empty()) {
+        if (forward.heap.top_key() + backward.heap.top_key() >= best) break;
+        const int d = forward.heap.top_key() <= backward.heap.top_key() ? 0 : 1;
+        SearchSide &side = *sides[d];
+        const SearchSide &other = *sides[1 - d];
+        const uint32_t u = side.heap.pop();
+        side.settled[u] = 1;
+        if (side.hops[u] >= hop_limit[d]) {
+            result.cutoff = true;
+            continue;
+        }
+        const uint32_t u_slot = side.slot_of[u];
+        const double u_dist = side.dist[u];
+        const size_t begin = d == 0 ? out_offsets_[u_slot] : in_offsets_[u_slot];
+        const size_t end = d == 0 ? out_offsets_[u_slot + 1] : in_offsets_[u_slot + 1];
+        const uint32_t *neighbours = d == 0 ? out_targets_.data() : in_sources_.data();
+        const double *costs = d == 0 ? out_costs_.data() : in_costs_.data();
+        for (size_t i = begin; i < end; ++i) {
+            const double nd = u_dist + costs[i];
+            if (nd > options.max_cost) {
+                result.cutoff = true;
+                continue;
+            }
+            const uint32_t v = side.reach(neighbours[i]);
+            if (side.settled[v] || nd >= side.dist[v]) continue;
+            const bool queued = side.dist[v] != numeric_limits<double>::infinity();
+            side.dist[v] = nd;
+            side.parent[v] = u;
+            side.hops[v] = side.hops[u] + 1;
+            if (queued) side.heap.decrease(v, nd);
+            else side.heap.push(v, nd);
+            const uint32_t ov = other.find(neighbours[i]);
+            if (ov != kNone && nd + other.dist[ov] < best && nd + other.dist[ov] <= options.max_cost) {
+                best = nd + other.dist[ov];
+                meet = neighbours[i];
+            }
+        }
+    }
+    if (meet == kNone) return result;
+
+    // labels only ever decrease, so the current labels at meet give a path no
+    // dearer than `best`
+    const uint32_t fm = forward.find(meet), bm = backward.find(meet);
+    result.cost = forward.dist[fm] + backward.dist[bm];
+    for (uint32_t x = fm; x != kNone; x = forward.parent[x]) result.users.push_back(users_.id_at(forward.slot_of[x]));
+    reverse(result.users.begin(), result.users.end());
+    for (uint32_t x = backward.parent[bm]; x != kNone; x = backward.parent[x]) {
+        result.users.push_back(users_.id_at(backward.slot_of[x]));
+    }
+    return result;
+}
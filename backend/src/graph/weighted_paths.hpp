@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "dense_id_map.hpp"
+
+struct WeightedPathOptions {
+    double max_cost = std::numeric_limits<double>::infinity();  // paths costing more are not searched
+    int max_hops = 0;  // 0 = unbounded
+};
+
+struct WeightedPath {
+    std::vector<int> users;  // from .. to; empty if none was found
+    double cost = 0.0;
+    bool cutoff = false;  // a limit pruned the search, so a path may exist beyond it
+};
+
+// Directed user graph with a cost per edge, frozen at analytics time. An edge
+// a -> b exists if a follows b or a liked/viewed b's posts; its cost is
+// 1 / (follows + decayed interaction weight), so strong, recent ties are cheap
+// and a bare follow costs 1.
+class WeightedUserGraph {
+public:
+    struct Edge {
+        std::uint32_t from;  // slots into user_ids
+        std::uint32_t to;
+        double cost;
+    };
+    // edges must be sorted by (from, to) without duplicates.
+    WeightedUserGraph(const DenseIdMap &users, const std::vector<Edge> &edges);
+
+    std::size_t user_count() const { return users_.size(); }
+    std::size_t edge_count() const { return out_targets_.size(); }
+    std::size_t memory_bytes() const;
+
+    // Cheapest path by bidirectional Dijkstra, each side on a pairing heap.
+    // max_hops caps the depth of each side's search tree (the forward side
+    // gets the odd hop), so a returned path never exceeds it; the path is then
+    // the cheapest one those trees hold, not necessarily the cheapest of all
+    // paths within the hop budget.
+    WeightedPath shortest_path(int from, int to, const WeightedPathOptions &options = {}) const;
+
+private:
+    DenseIdMap users_;
+    std::vector<std::size_t> out_offsets_;  // by slot, user_count() + 1
+    std::vector<std::uint32_t> out_targets_;
+    std::vector<double> out_costs_;
+    std::vector<std::size_t> in_offsets_;
+    std::vector<std::uint32_t> in_sources_;
+    std::vector<double> in_costs_;
+};
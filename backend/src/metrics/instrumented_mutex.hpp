@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include "latency_histogram.hpp"
+
+struct LockStats {
+    LatencyHistogram wait;         // exclusive acquisitions
+    LatencyHistogram shared_wait;  // shared acquisitions
+    LatencyHistogram hold;         // exclusive only; shared holders overlap
+};
+
+// Drop-in std::shared_mutex that records wait and hold times into a LockStats
+// once attached. While detached or disabled it costs one relaxed load per
+// acquisition and reads no clocks; while enabled, only contended waits and
+// exclusive holds are timed.
+class InstrumentedSharedMutex {
+public:
+    void attach(LockStats *stats, const std::atomic<bool> *enabled) {
+        stats_ = stats;
+        enabled_ = enabled;
+    }
+
+    void lock() {
+        if (!recording()) {
+            mutex_.lock();
+            held_since_ = 0;
+            return;
+        }
+        // uncontended acquisitions are recorded as zero wait without a clock read
+        if (mutex_.try_lock()) {
+            held_since_ = monotonic_nanos();
+            stats_->wait.record(0);
+            return;
+        }
+        const std::uint64_t start = monotonic_nanos();
+        mutex_.lock();
+        held_since_ = monotonic_nanos();
+        stats_->wait.record(held_since_ - start);
+    }
+    bool try_lock() {
+        if (!mutex_.try_lock()) return false;
+        held_since_ = recording() ? monotonic_nanos() : 0;
+        return true;
+    }
+    void unlock() {
+        // only the owner touches held_since_, between its lock and unlock
+        if (held_since_) stats_->hold.record(monotonic_nanos() - held_since_);
+        mutex_.unlock();
+    }
+
+    void lock_shared() {
+        if (!recording()) {
+            mutex_.lock_shared();
+            return;
+        }
+        if (mutex_.try_lock_shared()) {
+            stats_->shared_wait.record(0);
+            return;
+        }
+        const std::uint64_t start = monotonic_nanos();
+        mutex_.lock_shared();
+        stats_->shared_wait.record(monotonic_nanos() - start);
+    }
+    bool try_lock_shared() { return mutex_.try_lock_shared(); }
+    // For callers that time a whole batch of acquisitions as one wait.
+    void lock_shared_untimed() { mutex_.lock_shared(); }
+    void unlock_shared() { mutex_.unlock_shared(); }
+
+private:
+    bool recording() const { return stats_ && enabled_->load(std::memory_order_relaxed); }
+
+    std::shared_mutex mutex_;
+    LockStats *stats_ = nullptr;
+    const std::atomic<bool> *enabled_ = nullptr;
+    std::uint64_t held_since_ = 0;
+};
@@ -0,0 +1,92 @@
+#include "latency_histogram.hpp"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+namespace {
+
+// Threads are spread over shards round-robin, in order of first use.
+size_t this_thread_shard() {
+    static atomic<size_t> next{0};
+    thread_local const size_t shard = next.fetch_add(1, memory_order_relaxed) % LatencyHistogram::kShards;
+    return shard;
+}
+
+} // namespace
+
+uint64_t monotonic_nanos() {
+    using namespace chrono;
+    return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+size_t LatencyHistogram::bucket_of(uint64_t nanos) {
+    if (nanos < kLinearBuckets) return static_cast<size_t>(nanos);
+    const int exponent = 63 - __builtin_clzll(nanos);
+    if (exponent >= kMaxExponent) return kBuckets - 1;
+    const size_t sub = static_cast<size_t>(nanos >> (exponent - kSubBucketBits)) & ((size_t{1} << kSubBucketBits) - 1);
+    return kLinearBuckets + static_cast<size_t>(exponent - kSubBucketBits - 1) * (size_t{1} << kSubBucketBits) + sub;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t bucket) {
+    if (bucket < kLinearBuckets) return bucket;
+    const size_t offset = bucket - kLinearBuckets;
+    const int shift = static_cast<int>(offset >> kSubBucketBits) + 1;  // exponent - kSubBucketBits
+    const uint64_t lower = (uint64_t{1} << kSubBucketBits | (offset & ((size_t{1} << kSubBucketBits) - 1))) << shift;
+    return lower + (uint64_t{1} << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanos) {
+    Shard &shard = shards_[this_thread_shard()];
+    shard.counts[bucket_of(nanos)].fetch_add(1, memory_order_relaxed);
+    shard.count.fetch_add(1, memory_order_relaxed);
+    shard.sum.fetch_add(nanos, memory_order_relaxed);
+    uint64_t seen = shard.max.load(memory_order_relaxed);
+    while (nanos > seen && !shard.max.compare_exchange_weak(seen, nanos, memory_order_relaxed)) {}
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot out;
+    for (const Shard &shard : shards_) {
+        if (shard.count.load(memory_order_relaxed) == 0) continue;
+        if (out.counts.empty()) out.counts.assign(kBuckets, 0);
+        // bucket counts are summed into count, so quantiles never index past it
+        for (size_t b = 0; b < kBuckets; ++b) {
+            const uint64_t n = shard.counts[b].load(memory_order_relaxed);
+            out.counts[b] += n;
+            out.count += n;
+        }
+        out.sum_nanos += shard.sum.load(memory_order_relaxed);
+        out.max_nanos = max(out.max_nanos, shard.max.load(memory_order_relaxed));
+    }
+    return out;
+}
+
+void LatencyHistogram::reset() {
+    for (Shard &shard : shards_) {
+        for (auto &c : shard.counts) c.store(0, memory_order_relaxed);
+        shard.count.store(0, memory_order_relaxed);
+        shard.sum.store(0, memory_order_relaxed);
+        shard.max.store(0, memory_order_relaxed);
+    }
+}
+
+uint64_t LatencyHistogram::Snapshot::quantile(double q) const {
+    if (count == 0) return 0;
+    const uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(clamp(q, 0.0, 1.0) * static_cast<double>(count) + 0.5));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < counts.size(); ++b) {
+        seen += counts[b];
+        if (seen >= rank) return min(bucket_upper_bound(b), max_nanos);
+    }
+    return max_nanos;
+}
+
+void LatencyHistogram::Snapshot::merge(const Snapshot &other) {
+    if (other.count == 0) return;
+    if (counts.empty()) counts.assign(kBuckets, 0);
+    for (size_t b = 0; b < kBuckets; ++b) counts[b] += other.counts[b];
+    count += other.count;
+    sum_nanos += other.sum_nanos;
+    max_nanos = max(max_nanos, other.max_nanos);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Log-linear latency histogram in the style of HdrHistogram: exact below
+// 16 ns, then 8 sub-buckets per power of two (at most 12.5% relative error)
+// up to ~73 minutes; larger values land in the last bucket. record() is a few
+// relaxed atomic adds into the calling thread's shard, so it never blocks and
+// concurrent recorders rarely touch the same cache line.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 3;
+    static constexpr int kMaxExponent = 42;
+    static constexpr std::size_t kLinearBuckets = std::size_t{2} << kSubBucketBits;  // 16
+    static constexpr std::size_t kBuckets =
+        kLinearBuckets + (kMaxExponent - kSubBucketBits - 1) * (std::size_t{1} << kSubBucketBits);
+    static constexpr std::size_t kShards = 4;
+
+    struct Snapshot {
+        std::vector<std::uint64_t> counts;  // by bucket; empty if nothing was recorded
+        std::uint64_t count = 0;
+        std::uint64_t sum_nanos = 0;
+        std::uint64_t max_nanos = 0;
+
+        // Upper bound of the bucket holding quantile q (0..1), capped at the
+        // largest recorded value; 0 if empty.
+        std::uint64_t quantile(double q) const;
+        void merge(const Snapshot &other);
+    };
+
+    void record(std::uint64_t nanos);
+    Snapshot snapshot() const;
+    void reset();
+
+    static std::size_t bucket_of(std::uint64_t nanos);
+    static std::uint64_t bucket_upper_bound(std::size_t bucket);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<std::uint64_t>, kBuckets> counts{};
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> sum{0};
+        std::atomic<std::uint64_t> max{0};
+    };
+    std::array<Shard, kShards> shards_;
+};
+
+// Monotonic clock in nanoseconds, for pairing with LatencyHistogram::record.
+std::uint64_t monotonic_nanos();
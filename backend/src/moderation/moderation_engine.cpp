@@ -0,0 +1,207 @@
+#include "moderation_engine.hpp"
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <queue>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+constexpr int kAlphabet = 26;
+
+// Maps each input byte to a letter index, or -1 for bytes that are skipped.
+const array<int8_t, 256> &fold_table() {
+    static const array<int8_t, 256> table = []() {
+        array<int8_t, 256> t;
+        t.fill(-1);
+        for (int c = 0; c < kAlphabet; ++c) {
+            t['a' + c] = static_cast<int8_t>(c);
+            t['A' + c] = static_cast<int8_t>(c);
+        }
+        const pair<char, char> leet[] = {
+            {'0', 'o'}, {'1', 'i'}, {'!', 'i'}, {'3', 'e'}, {'4', 'a'}, {'@', 'a'},
+            {'5', 's'}, {'$', 's'}, {'7', 't'}, {'+', 't'}, {'8', 'b'}, {'9', 'g'},
+        };
+        for (const auto &[from, to] : leet) t[(unsigned char)from] = static_cast<int8_t>(to - 'a');
+        return t;
+    }();
+    return table;
+}
+
+string fold(const string &term) {
+    const auto &table = fold_table();
+    string out;
+    for (char c : term) {
+        const int8_t f = table[(unsigned char)c];
+        if (f >= 0) out.push_back(static_cast<char>('a' + f));
+    }
+    return out;
+}
+
+int64_t steady_ms() {
+    using namespace chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+struct ModerationEngine::Ruleset {
+    vector<string> terms;
+    vector<int32_t> transitions;  // state * kAlphabet + letter -> state
+    vector<int32_t> rule_at;      // state -> matching term index, or -1
+    unique_ptr<atomic<uint64_t>[]> hits;
+
+    explicit Ruleset(const vector<string> &raw_terms) {
+        unordered_map<string, int> seen;
+        for (const auto &raw : raw_terms) {
+            string t = fold(raw);
+            if (t.empty() || seen.count(t)) continue;
+            seen.emplace(t, static_cast<int>(terms.size()));
+            terms.push_back(move(t));
+        }
+        hits.reset(new atomic<uint64_t>[terms.size()]);
+        for (size_t i = 0; i < terms.size(); ++i) hits[i].store(0, memory_order_relaxed);
+
+        // trie over the folded terms; -1 marks a missing edge until build time
+        transitions.assign(kAlphabet, -1);
+        rule_at.assign(1, -1);
+        for (size_t i = 0; i < terms.size(); ++i) {
+            int32_t state = 0;
+            for (char c : terms[i]) {
+                int32_t &next = transitions[state * kAlphabet + (c - 'a')];
+                if (next < 0) {
+                    next = static_cast<int32_t>(rule_at.size());
+                    rule_at.push_back(-1);
+                    transitions.resize(transitions.size() + kAlphabet, -1);
+                }
+                state = transitions[state * kAlphabet + (c - 'a')];
+            }
+            if (rule_at[state] < 0) rule_at[state] = static_cast<int32_t>(i);
+        }
+
+        // BFS to resolve failure links into a full DFA
+        vector<int32_t> fail(rule_at.size(), 0);
+        queue<int32_t> q;
+        for (int c = 0; c < kAlphabet; ++c) {
+            int32_t &next = transitions[c];
+            if (next < 0) next = 0;
+            else q.push(next);
+        }
+        while (!q.empty()) {
+            const int32_t state = q.front();
+            q.pop();
+            if (rule_at[state] < 0) rule_at[state] = rule_at[fail[state]];
+            for (int c = 0; c < kAlphabet; ++c) {
+                int32_t &next = transitions[state * kAlphabet + c];
+                const int32_t via_fail = transitions[fail[state] * kAlphabet + c];
+                if (next < 0) {
+                    next = via_fail;
+                } else {
+                    fail[next] = via_fail;
+                    q.push(next);
+                }
+            }
+        }
+    }
+};
+
+ModerationEngine::ModerationEngine() {
+    set_terms({"badword", "vulgar", "shit", "fuck", "bitch", "asshole", "damn", "crap"});
+}
+
+shared_ptr<const ModerationEngine::Ruleset> ModerationEngine::current() const {
+    return atomic_load(&rules_);
+}
+
+void ModerationEngine::install(shared_ptr<Ruleset> next) {
+    // carry counters over for terms that survive the swap
+    if (auto prev = current()) {
+        unordered_map<string, uint64_t> old_hits;
+        for (size_t i = 0; i < prev->terms.size(); ++i) {
+            old_hits[prev->terms[i]] = prev->hits[i].load(memory_order_relaxed);
+        }
+        for (size_t i = 0; i < next->terms.size(); ++i) {
+            auto it = old_hits.find(next->terms[i]);
+            if (it != old_hits.end()) next->hits[i].store(it->second, memory_order_relaxed);
+        }
+    }
+    atomic_store(&rules_, shared_ptr<const Ruleset>(move(next)));
+    generation_.fetch_add(1, memory_order_relaxed);
+}
+
+bool ModerationEngine::matches(string_view content) const {
+    const auto rules = current();
+    if (!rules || rules->terms.empty()) return false;
+    const auto &table = fold_table();
+    const int32_t *transitions = rules->transitions.data();
+    const int32_t *rule_at = rules->rule_at.data();
+    int32_t state = 0;
+    for (char c : content) {
+        const int8_t f = table[(unsigned char)c];
+        if (f < 0) continue;
+        state = transitions[state * kAlphabet + f];
+        if (rule_at[state] >= 0) {
+            rules->hits[rule_at[state]].fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ModerationEngine::set_terms(const vector<string> &terms) {
+    install(make_shared<Ruleset>(terms));
+}
+
+bool ModerationEngine::load_terms(const string &path) {
+    lock_guard<mutex> guard(reload_mutex_);
+    // watched from now on even if it can't be read yet, so a file created
+    // later is picked up by reload_if_changed
+    if (path != path_) {
+        path_ = path;
+        loaded_mtime_ = filesystem::file_time_type::min();
+    }
+    error_code ec;
+    const auto mtime = filesystem::last_write_time(path, ec);
+    ifstream in(path);
+    if (ec || !in) return false;
+    vector<string> terms;
+    string line;
+    while (getline(in, line)) {
+        const size_t hash = line.find('#');
+        if (hash != string::npos) line.erase(hash);
+        if (!line.empty()) terms.push_back(line);
+    }
+    install(make_shared<Ruleset>(terms));
+    loaded_mtime_ = mtime;
+    return true;
+}
+
+bool ModerationEngine::reload_if_changed() {
+    const int64_t now = steady_ms();
+    int64_t due = next_check_ms_.load(memory_order_relaxed);
+    if (now < due || !next_check_ms_.compare_exchange_strong(due, now + 1000)) return false;
+
+    string path;
+    {
+        lock_guard<mutex> guard(reload_mutex_);
+        if (path_.empty()) return false;
+        error_code ec;
+        const auto mtime = filesystem::last_write_time(path_, ec);
+        if (ec || mtime == loaded_mtime_) return false;  // missing: keep the current rules, keep polling
+        path = path_;
+    }
+    return load_terms(path);
+}
+
+vector<ModerationEngine::RuleStats> ModerationEngine::rule_stats() const {
+    const auto rules = current();
+    vector<RuleStats> out;
+    if (!rules) return out;
+    out.reserve(rules->terms.size());
+    for (size_t i = 0; i < rules->terms.size(); ++i) {
+        out.push_back({rules->terms[i], rules->hits[i].load(memory_order_relaxed)});
+    }
+    return out;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Vulgarity filter that matches a term list in one streaming pass.
+// Text is folded on the fly (case, leetspeak digits/symbols, separators
+// dropped) and fed straight into a dense automaton over the 26 letters, so
+// "B.a.D w0rd" is caught without building any intermediate strings.
+// The term list can be swapped at runtime; readers never block on a swap.
+class ModerationEngine {
+public:
+    struct RuleStats {
+        std::string term;
+        std::uint64_t hits = 0;
+    };
+
+    ModerationEngine();  // starts with the built-in term list
+
+    // Returns true if any term occurs in content; bumps that term's hit counter.
+    bool matches(std::string_view content) const;
+
+    void set_terms(const std::vector<std::string> &terms);
+    // One term per line, '#' starts a comment. Keeps the current list on
+    // failure, but watches path either way.
+    bool load_terms(const std::string &path);
+    // Re-reads the watched file if its mtime changed or it has appeared since;
+    // checked at most once a second.
+    bool reload_if_changed();
+
+    std::vector<RuleStats> rule_stats() const;
+    std::uint64_t generation() const { return generation_.load(std::memory_order_relaxed); }
+
+private:
+    struct Ruleset;
+
+    std::shared_ptr<const Ruleset> current() const;
+    void install(std::shared_ptr<Ruleset> next);
+
+    std::shared_ptr<const Ruleset> rules_;  // accessed through std::atomic_load/store
+    std::atomic<std::uint64_t> generation_{0};
+
+    std::mutex reload_mutex_;
+    std::string path_;
+    std::filesystem::file_time_type loaded_mtime_{};
+    std::atomic<std::int64_t> next_check_ms_{0};
+};
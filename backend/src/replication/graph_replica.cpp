@@ -0,0 +1,234 @@
+#include "graph_replica.hpp"
+#include "post_record.hpp"
+#include "replication_server.hpp"
+#include "shard_wire.hpp"
+#include <cstring>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+// A silent primary sends a heartbeat well within this; past it, reconnect.
+static constexpr int kReceiveTimeoutSeconds = 2;
+static constexpr auto kReconnectDelay = chrono::milliseconds(200);
+
+static int connect_to(const string &host, int port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &found) != 0) return -1;
+    int fd = -1;
+    for (addrinfo *a = found; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd < 0) return -1;
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    timeval timeout{kReceiveTimeoutSeconds, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+// Splits a record into at most n fields; the last one keeps any further '|'.
+static vector<string> record_fields(const string &line, size_t n) {
+    vector<string> fields;
+    size_t begin = 0;
+    while (fields.size() + 1 < n) {
+        const size_t bar = line.find('|', begin);
+        if (bar == string::npos) break;
+        fields.push_back(line.substr(begin, bar - begin));
+        begin = bar + 1;
+    }
+    fields.push_back(line.substr(begin));
+    return fields;
+}
+
+GraphReplica::GraphReplica(const string &host, int port, const string &db_path)
+    : host_(host), port_(port), graph_(make_unique<Graph>(db_path)), caught_up_at_(chrono::steady_clock::now()) {
+    follower_ = thread([this] { follow_loop(); });
+}
+
+GraphReplica::~GraphReplica() {
+    {
+        lock_guard lock(mutex_);
+        stopping_ = true;
+        if (fd_ >= 0) shutdown(fd_, SHUT_RDWR);
+    }
+    applied_.notify_all();
+    follower_.join();
+}
+
+GraphReplica::Lag GraphReplica::lag() const {
+    lock_guard lock(mutex_);
+    Lag out = lag_;
+    out.bytes = out.primary_offset > out.applied_offset ? out.primary_offset - out.applied_offset : 0;
+    out.seconds = chrono::duration<double>(chrono::steady_clock::now() - caught_up_at_).count();
+    return out;
+}
+
+bool GraphReplica::wait_for(uint64_t offset, chrono::milliseconds timeout) {
+    unique_lock lock(mutex_);
+    return applied_.wait_for(lock, timeout, [&] { return log_id_ != 0 && lag_.applied_offset >= offset; });
+}
+
+GraphStats GraphReplica::stats() {
+    GraphStats out = graph_->stats();
+    const Lag l = lag();
+    auto gauge = [&](const char *name, double value) { out.gauges.push_back({name, "", value}); };
+    gauge("replication_connected", l.connected ? 1.0 : 0.0);
+    gauge("replication_applied_offset", static_cast<double>(l.applied_offset));
+    gauge("replication_primary_offset", static_cast<double>(l.primary_offset));
+    gauge("replication_lag_bytes", static_cast<double>(l.bytes));
+    gauge("replication_lag_seconds", l.seconds);
+    gauge("replication_bootstraps", static_cast<double>(l.bootstraps));
+    gauge("replication_records_applied", static_cast<double>(l.records_applied));
+    gauge("replication_divergences", static_cast<double>(l.divergences));
+    return out;
+}
+
+void GraphReplica::follow_loop() {
+    for (;;) {
+        const int fd = connect_to(host_, port_);
+        if (fd >= 0) {
+            {
+                lock_guard lock(mutex_);
+                if (stopping_) {
+                    close(fd);
+                    return;
+                }
+                fd_ = fd;
+                lag_.connected = true;
+            }
+            try {
+                follow(fd);
+            } catch (const exception &) {
+                // primary gone or silent; keep serving reads and retry
+            }
+            {
+                lock_guard lock(mutex_);
+                fd_ = -1;
+                lag_.connected = false;
+            }
+            close(fd);
+        }
+        unique_lock lock(mutex_);
+        if (applied_.wait_for(lock, kReconnectDelay, [&] { return stopping_; })) return;
+    }
+}
+
+void GraphReplica::follow(int fd) {
+    WireWriter hello;
+    {
+        lock_guard lock(mutex_);
+        hello.put(log_id_);
+        hello.put(lag_.applied_offset);
+    }
+    write_frame(fd, hello.bytes());
+    string payload;
+    while (read_frame(fd, payload)) {
+        WireReader frame(move(payload));
+        const auto kind = frame.get<ReplicationFrame>();
+        if (kind == ReplicationFrame::Snapshot) {
+            const auto log_id = frame.get<uint64_t>();
+            const auto offset = frame.get<uint64_t>();
+            graph_->load_snapshot(frame.get_string());
+            lock_guard lock(mutex_);
+            log_id_ = log_id;
+            lag_.applied_offset = lag_.primary_offset = offset;
+            ++lag_.bootstraps;
+            caught_up_at_ = chrono::steady_clock::now();
+        } else {
+            const auto offset = frame.get<uint64_t>();
+            const auto end_offset = frame.get<uint64_t>();
+            const string records = frame.get_string();
+            {
+                lock_guard lock(mutex_);
+                if (offset != lag_.applied_offset) throw runtime_error("replication: records out of sequence");
+            }
+            uint64_t applied = 0;
+            const bool ok = apply(records, applied);
+            lock_guard lock(mutex_);
+            lag_.records_applied += applied;
+            if (!ok) {
+                // this replica no longer matches the primary: start over
+                ++lag_.divergences;
+                log_id_ = 0;
+                cerr << "replication: record rejected at offset " << offset << ", re-bootstrapping" << endl;
+                return;
+            }
+            lag_.applied_offset = offset + records.size();
+            lag_.primary_offset = max(lag_.primary_offset, end_offset);
+            if (lag_.applied_offset >= end_offset) caught_up_at_ = chrono::steady_clock::now();
+        }
+        applied_.notify_all();
+    }
+}
+
+bool GraphReplica::apply(const string &records, uint64_t &applied) {
+    // runs of likes/views go through add_interactions, one lock pass each
+    vector<InteractionRecord> interactions;
+    auto flush = [&] {
+        if (interactions.empty()) return true;
+        const auto status = graph_->add_interactions(interactions);
+        applied += interactions.size();
+        interactions.clear();
+        for (InteractionStatus s : status) {
+            if (s != InteractionStatus::Ok) return false;
+        }
+        return true;
+    };
+    try {
+        size_t begin = 0;
+        while (begin < records.size()) {
+            size_t end = records.find('\n', begin);
+            if (end == string::npos) end = records.size();
+            const string line = records.substr(begin, end - begin);
+            begin = end + 1;
+            if (line.empty()) continue;
+            if (line[0] == 'L' || line[0] == 'V') {
+                const auto f = record_fields(line, 5);
+                if (f.size() != 5) return false;
+                InteractionRecord r;
+                r.type = line[0] == 'L' ? InteractionRecord::Type::Like : InteractionRecord::Type::View;
+                r.user_id = stoi(f[1]);
+                r.post_id = stoi(f[2]);
+                r.weight = stod(f[3]);
+                r.timestamp = stoll(f[4]);
+                interactions.push_back(r);
+                continue;
+            }
+            if (!flush()) return false;
+            bool ok = false;
+            if (line[0] == 'U') {
+                const auto f = record_fields(line, 3);
+                ok = f.size() == 3 && graph_->add_user(f[2]) == stoi(f[1]);
+            } else if (const size_t tag = post_record_tag(line)) {
+                const auto f = record_fields(line, 4);
+                ok = f.size() == 4 && graph_->add_post(stoi(f[2]), post_record_content(tag, f[3])) == stoi(f[1]);
+            } else if (line[0] == 'F') {
+                const auto f = record_fields(line, 3);
+                ok = f.size() == 3 && graph_->add_follow(stoi(f[1]), stoi(f[2]));
+            } else if (line.compare(0, 3, "DU|") == 0) {
+                ok = graph_->delete_user(stoi(line.substr(3)));
+            } else if (line.compare(0, 3, "DP|") == 0) {
+                ok = graph_->delete_post(stoi(line.substr(3)));
+            }
+            if (!ok) return false;
+            ++applied;
+        }
+        return flush();
+    } catch (const exception &) {
+        return false;  // malformed number
+    }
+}
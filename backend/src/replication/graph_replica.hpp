@@ -0,0 +1,106 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+
+// A read-only follower of a primary Graph served by a ReplicationServer.
+// A background thread connects to the primary, bootstraps from a snapshot
+// plus the log offset it is current to, then applies the primary's records
+// as they arrive through the same Graph calls that made them, so ids,
+// edges and weights come out identical. Reads are answered locally and see
+// the primary's writes in order, up to the replica's staleness (see lag()).
+//
+// After a disconnect the replica keeps serving what it has and resumes
+// from its offset; it re-bootstraps only if the primary no longer retains
+// that part of the log. Analytics (PageRank, clustering, centrality) are
+// derived state and not shipped: call recompute_analytics() on the replica.
+class GraphReplica {
+public:
+    // db_path is the replica's own file, rewritten on every bootstrap.
+    GraphReplica(const std::string &host, int port, const std::string &db_path);
+    ~GraphReplica();
+    GraphReplica(const GraphReplica &) = delete;
+    GraphReplica &operator=(const GraphReplica &) = delete;
+
+    struct Lag {
+        bool connected = false;
+        std::uint64_t applied_offset = 0;  // in the primary's log
+        std::uint64_t primary_offset = 0;  // log end as of the last frame received
+        std::uint64_t bytes = 0;           // primary_offset - applied_offset
+        // Time since the replica last held every write the primary had
+        // made; at most about one heartbeat while connected and caught up.
+        double seconds = 0.0;
+        std::uint64_t bootstraps = 0;
+        std::uint64_t records_applied = 0;
+        std::uint64_t divergences = 0;     // records the replica rejected; each forces a bootstrap
+    };
+    Lag lag() const;
+    // Blocks until the replica has applied the primary's log up to offset
+    // (ReplicationServer::offset() after a write, for read-your-writes).
+    // False on timeout.
+    bool wait_for(std::uint64_t offset, std::chrono::milliseconds timeout);
+
+    // reads, as on Graph
+    int find_user_by_username(const std::string &username) { return graph_->find_user_by_username(username); }
+    std::vector<std::pair<int, std::string>> users_list(int page, int limit) { return graph_->users_list(page, limit); }
+    UserPage users_list_after(const std::string &cursor, int limit) { return graph_->users_list_after(cursor, limit); }
+    Graph::UserMetrics get_user_metrics(int user_id) { return graph_->get_user_metrics(user_id); }
+    Graph::PostMetrics get_post_metrics(int post_id) { return graph_->get_post_metrics(post_id); }
+    std::vector<int> get_followers(int user_id) { return graph_->get_followers(user_id); }
+    std::vector<int> get_followings(int user_id) { return graph_->get_followings(user_id); }
+    std::vector<int> get_liked_posts(int user_id) { return graph_->get_liked_posts(user_id); }
+    std::vector<int> get_user_posts(int user_id) { return graph_->get_user_posts(user_id); }
+    std::vector<int> bfs_path(int u1, int u2) { return graph_->bfs_path(u1, u2); }
+    WeightedPath weighted_path(int u1, int u2, const WeightedPathOptions &options = {}) {
+        return graph_->weighted_path(u1, u2, options);
+    }
+    std::vector<int> recommendations(int u) { return graph_->recommendations(u); }
+    WalkRecommendations personalized_recommendations(int u, std::size_t k = 10) {
+        return graph_->personalized_recommendations(u, k);
+    }
+    std::vector<std::pair<int, std::vector<int>>> communities() { return graph_->communities(); }
+    std::vector<int> search_posts(const std::string &q) { return graph_->search_posts(q); }
+    std::vector<std::string> autocomplete_users(const std::string &prefix) { return graph_->autocomplete_users(prefix); }
+    std::vector<PostInfo> top_posts(std::size_t k = 10) { return graph_->top_posts(k); }
+    std::vector<PostInfo> trending_window(std::int64_t window_seconds, std::size_t k = 10) {
+        return graph_->trending_window(window_seconds, k);
+    }
+    std::vector<RankedUser> get_ranked(int page, int limit) { return graph_->get_ranked(page, limit); }
+    std::size_t for_each_post(const std::function<bool(const PostView &)> &visit, const PostScanOptions &options = {}) {
+        return graph_->for_each_post(visit, options);
+    }
+    std::shared_ptr<const GraphSnapshot> snapshot() { return graph_->snapshot(); }
+    void recompute_analytics() { graph_->recompute_analytics(); }
+
+    // The graph's stats plus replication_* gauges from lag().
+    GraphStats stats();
+
+private:
+    void follow_loop();
+    void follow(int fd);  // one connection, until it fails or stop
+    // Applies whole records in order, counting them into applied; false at
+    // the first one the graph rejects, leaving the rest unapplied.
+    bool apply(const std::string &records, std::uint64_t &applied);
+
+    std::string host_;
+    int port_;
+    std::unique_ptr<Graph> graph_;
+
+    mutable std::mutex mutex_;  // everything below but the thread
+    std::condition_variable applied_;
+    int fd_ = -1;
+    bool stopping_ = false;
+    Lag lag_;
+    std::uint64_t log_id_ = 0;  // of the log applied_offset is in; 0 = bootstrap first
+    std::chrono::steady_clock::time_point caught_up_at_;
+    std::thread follower_;
+};
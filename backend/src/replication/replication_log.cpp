@@ -0,0 +1,79 @@
+#include "replication_log.hpp"
+#include <algorithm>
+#include <random>
+
+using namespace std;
+
+static uint64_t new_log_id() {
+    random_device rd;
+    uint64_t id = 0;
+    while (id == 0) id = (static_cast<uint64_t>(rd()) << 32) ^ rd();  // 0 is "no log" on the wire
+    return id;
+}
+
+ReplicationLog::ReplicationLog(size_t retain_bytes) : retain_bytes_(max<size_t>(retain_bytes, 1)), id_(new_log_id()) {}
+
+uint64_t ReplicationLog::id() const {
+    lock_guard lock(mutex_);
+    return id_;
+}
+
+uint64_t ReplicationLog::end_offset() const {
+    lock_guard lock(mutex_);
+    return end_offset_;
+}
+
+size_t ReplicationLog::retained_bytes() const {
+    lock_guard lock(mutex_);
+    return buffer_.size();
+}
+
+void ReplicationLog::append(const string &records) {
+    if (records.empty()) return;
+    {
+        lock_guard lock(mutex_);
+        buffer_ += records;
+        end_offset_ += records.size();
+        // trim only once twice the retention has built up, so each byte is
+        // moved at most once on average; cut at a record boundary
+        if (buffer_.size() > 2 * retain_bytes_) {
+            size_t cut = buffer_.find('\n', buffer_.size() - retain_bytes_ - 1);
+            cut = cut == string::npos ? buffer_.size() : cut + 1;
+            buffer_.erase(0, cut);
+        }
+    }
+    appended_.notify_all();
+}
+
+void ReplicationLog::restart() {
+    {
+        lock_guard lock(mutex_);
+        id_ = new_log_id();
+        end_offset_ = 0;
+        buffer_.clear();
+    }
+    appended_.notify_all();
+}
+
+ReplicationLog::Read ReplicationLog::read(uint64_t id, uint64_t offset, size_t max_bytes, chrono::milliseconds wait) {
+    Read out;
+    unique_lock lock(mutex_);
+    auto readable = [&] { return id == id_ && offset >= readable_from_unlocked() && offset <= end_offset_; };
+    if (readable() && offset == end_offset_) {
+        appended_.wait_for(lock, wait, [&] { return !readable() || offset < end_offset_; });
+    }
+    out.end_offset = end_offset_;
+    if (!readable()) return out;
+    out.available = true;
+    const size_t begin = static_cast<size_t>(offset - readable_from_unlocked());
+    if (begin == buffer_.size()) return out;
+    // whole records only: end after the last newline within max_bytes, or
+    // after the first one if a single record is longer than that
+    size_t end = begin + min(max(max_bytes, size_t{1}), buffer_.size() - begin);
+    if (end < buffer_.size()) {
+        const size_t last = buffer_.rfind('\n', end - 1);
+        end = last != string::npos && last >= begin ? last + 1 : buffer_.find('\n', end) + 1;
+    }
+    out.records.assign(buffer_, begin, end - begin);
+    return out;
+}
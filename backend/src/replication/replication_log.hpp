@@ -0,0 +1,52 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// A primary's mutation log for replication: the records Graph::persist_*
+// write to the db file, in the order the writes took effect, plus one record
+// per deletion (DU|user_id, DP|post_id). Offsets are byte positions in the
+// stream since the log was created; only the most recent records are kept
+// in memory, and a follower that falls further behind re-bootstraps from a
+// snapshot (see ReplicationServer).
+//
+// Appends come from Graph under its persist lock; the log locks internally
+// and never calls back into the graph.
+class ReplicationLog {
+public:
+    // Keeps at least the last retain_bytes of the stream readable.
+    explicit ReplicationLog(std::size_t retain_bytes = 64u << 20);
+
+    // Identifies this stream of offsets; changes when the log restarts.
+    std::uint64_t id() const;
+    std::uint64_t end_offset() const;
+    std::size_t retained_bytes() const;
+
+    // Whole '\n'-terminated records.
+    void append(const std::string &records);
+    // The graph's state was replaced wholesale (load_from_db): offsets of the
+    // old stream mean nothing any more, so start a new one with a new id.
+    void restart();
+
+    struct Read {
+        bool available = false;  // false: id is stale or offset no longer retained
+        std::uint64_t end_offset = 0;  // of the whole log when read
+        std::string records;     // whole records from offset, possibly none
+    };
+    // Records from offset, at most about max_bytes, waiting up to `wait` for
+    // some to arrive if offset is the end of the log.
+    Read read(std::uint64_t id, std::uint64_t offset, std::size_t max_bytes, std::chrono::milliseconds wait);
+
+private:
+    std::uint64_t readable_from_unlocked() const { return end_offset_ - buffer_.size(); }
+
+    std::size_t retain_bytes_;
+    mutable std::mutex mutex_;
+    std::condition_variable appended_;
+    std::uint64_t id_;
+    std::uint64_t end_offset_ = 0;
+    std::string buffer_;  // the stream's tail, starting at a record boundary
+};
@@ -0,0 +1,128 @@
+#include "replication_server.hpp"
+#include "graph.hpp"
+#include "shard_wire.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+ReplicationServer::ReplicationServer(Graph &primary, const Options &options)
+    : primary_(primary), options_(options), log_(make_shared<ReplicationLog>(options.retain_bytes)) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options_.port));
+    if (inet_pton(AF_INET, options_.bind_address.c_str(), &addr.sin_addr) != 1) {
+        throw runtime_error("replication: bad bind address " + options_.bind_address);
+    }
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) throw runtime_error("replication: socket failed: " + string(strerror(errno)));
+    const int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listen_fd_, 16) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+        const string error = strerror(errno);
+        close(listen_fd_);
+        throw runtime_error("replication: cannot listen on " + options_.bind_address + ":" +
+                            to_string(options_.port) + ": " + error);
+    }
+    port_ = ntohs(addr.sin_port);
+    // from here on every write is logged; followers start from a snapshot
+    primary_.attach_replication_log(log_);
+    acceptor_ = thread([this] { accept_loop(); });
+}
+
+ReplicationServer::~ReplicationServer() {
+    stopping_.store(true);
+    acceptor_.join();
+    close(listen_fd_);
+    {
+        lock_guard lock(connections_mutex_);
+        for (int fd : connections_) shutdown(fd, SHUT_RDWR);
+    }
+    // no new workers once the acceptor is gone
+    for (auto &worker : workers_) worker.thread.join();
+    primary_.attach_replication_log(nullptr);
+}
+
+void ReplicationServer::accept_loop() {
+    pollfd listener{listen_fd_, POLLIN, 0};
+    while (!stopping_.load()) {
+        reap_finished_workers();
+        if (poll(&listener, 1, options_.heartbeat_ms) <= 0) continue;
+        const int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) continue;
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        lock_guard lock(connections_mutex_);
+        connections_.push_back(fd);
+        Worker &worker = workers_.emplace_back();
+        worker.thread = thread([this, fd, &worker] { serve(fd, worker); });
+    }
+}
+
+// Followers reconnect, so the threads of closed connections are joined as
+// the acceptor goes rather than piling up until shutdown.
+void ReplicationServer::reap_finished_workers() {
+    for (auto it = workers_.begin(); it != workers_.end();) {
+        if (!it->done.load()) {
+            ++it;
+            continue;
+        }
+        it->thread.join();
+        it = workers_.erase(it);
+    }
+}
+
+void ReplicationServer::serve(int fd, Worker &worker) {
+    ++followers_;
+    try {
+        string hello;
+        if (read_frame(fd, hello)) {
+            WireReader request(move(hello));
+            uint64_t log_id = request.get<uint64_t>();
+            uint64_t offset = request.get<uint64_t>();
+            while (!stopping_.load()) {
+                ReplicationLog::Read batch = log_->read(log_id, offset, options_.max_batch_bytes,
+                                                        chrono::milliseconds(options_.heartbeat_ms));
+                WireWriter frame;
+                if (!batch.available) {
+                    // new follower, or one whose position has been trimmed or
+                    // belongs to a log from before a reload
+                    Graph::ReplicationSnapshot snapshot = primary_.replication_snapshot();
+                    log_id = snapshot.log_id;
+                    offset = snapshot.offset;
+                    frame.put(ReplicationFrame::Snapshot);
+                    frame.put(log_id);
+                    frame.put(offset);
+                    frame.put_string(snapshot.records);
+                    write_frame(fd, frame.bytes());
+                    ++snapshots_sent_;
+                    continue;
+                }
+                frame.put(ReplicationFrame::Records);
+                frame.put(offset);
+                frame.put(batch.end_offset);
+                frame.put_string(batch.records);
+                write_frame(fd, frame.bytes());
+                offset += batch.records.size();
+            }
+        }
+    } catch (const exception &) {
+        // the follower hung up or sent garbage; it reconnects with its position
+    }
+    {
+        lock_guard lock(connections_mutex_);
+        connections_.remove(fd);
+    }
+    close(fd);
+    --followers_;
+    worker.done.store(true);
+}
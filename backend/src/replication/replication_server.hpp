@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "replication_log.hpp"
+
+class Graph;
+
+// Frames from a primary to a follower, after the follower's hello
+// (log id, offset; id 0 asks for a snapshot). Encoded with WireWriter and
+// sent with write_frame, like the shard protocol.
+enum class ReplicationFrame : std::uint8_t {
+    Snapshot,  // log id, offset, records: replace everything, then tail from offset
+    Records,   // offset, log end offset, records (none in a heartbeat)
+};
+
+// Ships a primary Graph's mutation log to followers (GraphReplica) over TCP.
+// Attaches a ReplicationLog to the graph on construction; each follower gets
+// a thread that sends a snapshot if the follower's position is not in the
+// log any more (or it has none), then streams records as they are appended,
+// with a heartbeat at least every heartbeat_ms so followers can tell a quiet
+// primary from a dead one and measure their staleness.
+class ReplicationServer {
+public:
+    struct Options {
+        std::string bind_address = "127.0.0.1";
+        int port = 0;                         // 0: any free port, see port()
+        std::size_t retain_bytes = 64u << 20;  // of log kept for followers that fall behind
+        std::size_t max_batch_bytes = 1u << 20;
+        int heartbeat_ms = 100;
+    };
+    // Throws std::runtime_error if the address cannot be bound.
+    explicit ReplicationServer(Graph &primary) : ReplicationServer(primary, Options()) {}
+    ReplicationServer(Graph &primary, const Options &options);
+    ~ReplicationServer();  // disconnects followers and detaches the log from the graph
+    ReplicationServer(const ReplicationServer &) = delete;
+    ReplicationServer &operator=(const ReplicationServer &) = delete;
+
+    int port() const { return port_; }
+    // The log's end: a follower that has applied up to here has every write
+    // the primary has acknowledged so far (see GraphReplica::wait_for).
+    std::uint64_t offset() const { return log_->end_offset(); }
+    std::size_t followers() const { return followers_.load(); }
+    std::uint64_t snapshots_sent() const { return snapshots_sent_.load(); }
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::atomic<bool> done{false};  // set as serve() returns; joined by the acceptor
+    };
+    void accept_loop();
+    void reap_finished_workers();
+    void serve(int fd, Worker &worker);
+
+    Graph &primary_;
+    Options options_;
+    std::shared_ptr<ReplicationLog> log_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::size_t> followers_{0};
+    std::atomic<std::uint64_t> snapshots_sent_{0};
+    std::mutex connections_mutex_;
+    std::list<int> connections_;  // open follower sockets, shut down on stop
+    std::list<Worker> workers_;   // the acceptor's, then the destructor's
+    std::thread acceptor_;
+};
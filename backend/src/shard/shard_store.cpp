@@ -0,0 +1,637 @@
+#include "shard_store.hpp"
+#include "post_record.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+constexpr double kDecayHalfLifeSeconds = 72.0 * 60.0 * 60.0;  // as Graph's
+
+template <class Record>
+using Outbox = vector<vector<Record>>;  // by destination shard
+
+template <class Record>
+void put_outbox(WireWriter &out, const Outbox<Record> &outbox) {
+    for (const auto &records : outbox) out.put_vector(records);
+}
+
+// Splits "a|b|rest" into at most n fields; the last keeps any further '|'.
+vector<string> split_fields(const string &line, size_t n) {
+    vector<string> fields;
+    size_t begin = 0;
+    while (fields.size() + 1 < n) {
+        const size_t bar = line.find('|', begin);
+        if (bar == string::npos) break;
+        fields.push_back(line.substr(begin, bar - begin));
+        begin = bar + 1;
+    }
+    fields.push_back(line.substr(begin));
+    return fields;
+}
+
+} // namespace
+
+ShardStore::ShardStore(size_t shard, size_t shards, const string &db_path)
+    : shard_(shard), shards_(shards), db_path_(db_path), next_post_id_(static_cast<int>(shard) + 1) {
+    if (!db_path_.empty()) load(db_path_);
+}
+
+void ShardStore::load(const string &path) {
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        if (const size_t tag = post_record_tag(line)) {
+            const auto f = split_fields(line, 4);
+            if (f.size() < 4) continue;
+            const int post_id = atoi(f[1].c_str());
+            if (add_post(post_id, atoi(f[2].c_str()), post_record_content(tag, f[3])) > 0) {
+                next_post_id_ = max(next_post_id_, post_id + static_cast<int>(shards_));
+            }
+            continue;
+        }
+        if (line.size() < 2 || line[1] != '|') continue;
+        switch (line[0]) {
+        case 'N': {
+            const auto f = split_fields(line, 3);
+            if (f.size() == 3) directory_[f[2]] = atoi(f[1].c_str());
+            break;
+        }
+        case 'U': {
+            const auto f = split_fields(line, 3);
+            if (f.size() == 3) add_user(atoi(f[1].c_str()), f[2]);
+            break;
+        }
+        case 'F': {
+            const auto f = split_fields(line, 3);
+            if (f.size() < 3) break;
+            const int a = atoi(f[1].c_str()), b = atoi(f[2].c_str());
+            if (user_slots_.contains(a)) followees_[user_slots_.slot(a)].insert(b);
+            if (user_slots_.contains(b)) followers_[user_slots_.slot(b)].insert(a);
+            break;
+        }
+        case 'L':
+        case 'V': {
+            const auto f = split_fields(line, 5);
+            if (f.size() < 5) break;
+            const Kind kind = line[0] == 'L' ? Kind::Like : Kind::View;
+            const int user_id = atoi(f[1].c_str()), post_id = atoi(f[2].c_str());
+            const Stamp stamp{strtod(f[3].c_str(), nullptr), strtoll(f[4].c_str(), nullptr, 10)};
+            if (owns_user(user_id)) record_out(kind, user_id, post_id, stamp);
+            if (owns_post(post_id)) record_in(kind, user_id, post_id, stamp);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+void ShardStore::append_record(const string &line) {
+    if (db_path_.empty()) return;
+    ofstream out(db_path_, ios::app);
+    if (!out) return;
+    out << line << "\n";
+}
+
+bool ShardStore::add_user(int user_id, const string &name) {
+    if (user_id <= 0 || (!user_slots_.empty() && user_id <= user_slots_.ids().back())) return false;
+    user_slots_.insert(user_id);
+    names_.push_back(name);
+    followees_.emplace_back();
+    followers_.emplace_back();
+    liked_.emplace_back();
+    viewed_.emplace_back();
+    user_rank_.push_back(0.0);
+    return true;
+}
+
+int ShardStore::add_post(int post_id, int author, const string &content) {
+    if (!user_slots_.contains(author)) return -1;
+    if (!post_slots_.empty() && post_id <= post_slots_.ids().back()) return -1;
+    post_slots_.insert(post_id);
+    author_.push_back(author);
+    content_.push_back(content);
+    likes_.emplace_back();
+    views_.emplace_back();
+    unique_viewers_.emplace_back();
+    post_rank_.push_back(0.0);
+    return post_id;
+}
+
+bool ShardStore::record_out(Kind kind, int user_id, int post_id, Stamp stamp) {
+    const int slot = user_slots_.slot(user_id);
+    if (slot < 0) return false;
+    auto &edges = kind == Kind::Like ? liked_[slot] : viewed_[slot];
+    auto [it, inserted] = edges.emplace(post_id, stamp);
+    if (inserted) return true;
+    if (it->second.weight == stamp.weight && it->second.timestamp == stamp.timestamp) return false;
+    it->second = stamp;
+    return true;
+}
+
+bool ShardStore::record_in(Kind kind, int user_id, int post_id, Stamp stamp) {
+    const int slot = post_slots_.slot(post_id);
+    if (slot < 0) return false;
+    if (kind == Kind::View) unique_viewers_[slot].add(static_cast<uint64_t>(user_id));
+    auto &edges = kind == Kind::Like ? likes_[slot] : views_[slot];
+    auto [it, inserted] = edges.emplace(user_id, stamp);
+    if (inserted) return true;
+    if (it->second.weight == stamp.weight && it->second.timestamp == stamp.timestamp) return false;
+    it->second = stamp;
+    return true;
+}
+
+static double decayed(double weight, int64_t timestamp, int64_t now) {
+    // future timestamps count as "now", as in Graph::landmark_weight
+    return weight * exp2(static_cast<double>(min(timestamp, now) - now) / kDecayHalfLifeSeconds);
+}
+
+string ShardStore::handle(ShardOp op, WireReader &in) {
+    WireWriter out;
+    switch (op) {
+    case ShardOp::Shutdown:
+        break;
+    case ShardOp::Limits: {
+        // reserved names count too: a reservation whose user never arrived
+        // must not have its id handed to someone else
+        int max_user = user_slots_.empty() ? 0 : user_slots_.ids().back();
+        for (const auto &entry : directory_) max_user = max(max_user, entry.second);
+        out.put<int>(max_user);
+        out.put<int>(next_post_id_);
+        break;
+    }
+    case ShardOp::ReserveName: {
+        const string key = in.get_string();
+        const int user_id = in.get<int>();
+        const bool reserved = directory_.emplace(key, user_id).second;
+        if (reserved) append_record("N|" + to_string(user_id) + "|" + key);
+        out.put<bool>(reserved);
+        break;
+    }
+    case ShardOp::FindName: {
+        auto it = directory_.find(in.get_string());
+        out.put<int>(it == directory_.end() ? -1 : it->second);
+        break;
+    }
+    case ShardOp::AddUser: {
+        const int user_id = in.get<int>();
+        const string name = in.get_string();
+        const bool added = add_user(user_id, name);
+        if (added) append_record("U|" + to_string(user_id) + "|" + name);
+        out.put<bool>(added);
+        break;
+    }
+    case ShardOp::HasUser:
+        out.put<bool>(user_slots_.contains(in.get<int>()));
+        break;
+    case ShardOp::AddPost: {
+        const int author = in.get<int>();
+        const string content = in.get_string();
+        const int post_id = add_post(next_post_id_, author, content);
+        if (post_id > 0) {
+            next_post_id_ += static_cast<int>(shards_);
+            string record = post_record(post_id, author, content);
+            record.pop_back();  // append_record adds the newline
+            append_record(record);
+        }
+        out.put<int>(post_id);
+        break;
+    }
+    case ShardOp::PostAuthor: {
+        const int slot = post_slots_.slot(in.get<int>());
+        out.put<int>(slot < 0 ? -1 : author_[slot]);
+        break;
+    }
+    case ShardOp::FollowOut: {
+        const int a = in.get<int>(), b = in.get<int>();
+        const int slot = user_slots_.slot(a);
+        if (slot >= 0 && followees_[slot].insert(b).second) {
+            append_record("F|" + to_string(a) + "|" + to_string(b));
+        }
+        out.put<bool>(slot >= 0);
+        break;
+    }
+    case ShardOp::FollowIn: {
+        const int a = in.get<int>(), b = in.get<int>();
+        const int slot = user_slots_.slot(b);
+        // one record covers both sides when both users live here
+        if (slot >= 0 && followers_[slot].insert(a).second && !owns_user(a)) {
+            append_record("F|" + to_string(a) + "|" + to_string(b));
+        }
+        out.put<bool>(slot >= 0);
+        break;
+    }
+    case ShardOp::FollowsUser: {
+        const int a = in.get<int>(), b = in.get<int>();
+        const int slot = user_slots_.slot(a);
+        out.put<bool>(slot >= 0 && followees_[slot].count(b) > 0);
+        break;
+    }
+    case ShardOp::InteractionOut:
+    case ShardOp::InteractionIn: {
+        const Kind kind = in.get<Kind>();
+        const int user_id = in.get<int>(), post_id = in.get<int>();
+        const Stamp stamp{in.get<double>(), in.get<int64_t>()};
+        bool ok;
+        bool changed = false;
+        if (op == ShardOp::InteractionOut) {
+            ok = user_slots_.contains(user_id);
+            if (ok) changed = record_out(kind, user_id, post_id, stamp);
+        } else {
+            ok = post_slots_.contains(post_id);
+            if (ok) changed = record_in(kind, user_id, post_id, stamp) && !owns_user(user_id);
+        }
+        if (changed) {
+            append_record(string(kind == Kind::Like ? "L|" : "V|") + to_string(user_id) + "|" + to_string(post_id) +
+                          "|" + to_string(stamp.weight) + "|" + to_string(stamp.timestamp));
+        }
+        out.put<bool>(ok);
+        break;
+    }
+    case ShardOp::Followers:
+    case ShardOp::Followees: {
+        const int slot = user_slots_.slot(in.get<int>());
+        vector<int> ids;
+        if (slot >= 0) {
+            const auto &set = op == ShardOp::Followers ? followers_[slot] : followees_[slot];
+            ids.assign(set.begin(), set.end());
+            sort(ids.begin(), ids.end());
+        }
+        out.put_vector(ids);
+        break;
+    }
+    case ShardOp::UserPosts: {
+        const int user_id = in.get<int>();
+        vector<int> ids;
+        for (size_t p = 0; p < post_slots_.size(); ++p) {
+            if (author_[p] == user_id) ids.push_back(post_slots_.id_at(p));
+        }
+        out.put_vector(ids);
+        break;
+    }
+    case ShardOp::UserMetrics: {
+        const int user_id = in.get<int>();
+        const int slot = user_slots_.slot(user_id);
+        out.put<bool>(slot >= 0);
+        if (slot < 0) break;
+        int posts = 0, total_likes = 0;
+        HllSketch reach;
+        for (size_t p = 0; p < post_slots_.size(); ++p) {
+            if (author_[p] != user_id) continue;
+            ++posts;
+            total_likes += static_cast<int>(likes_[p].size());
+            reach.merge(unique_viewers_[p]);
+        }
+        out.put<int>(static_cast<int>(followers_[slot].size()));
+        out.put<int>(static_cast<int>(followees_[slot].size()));
+        out.put<int>(posts);
+        out.put<int>(total_likes);
+        out.put<uint64_t>(static_cast<uint64_t>(llround(reach.estimate())));
+        out.put<double>(user_rank_[slot]);
+        break;
+    }
+    case ShardOp::PostMetrics: {
+        const int slot = post_slots_.slot(in.get<int>());
+        const int64_t now = in.get<int64_t>();
+        out.put<bool>(slot >= 0);
+        if (slot < 0) break;
+        double weight = 0.0;
+        for (const auto *edges : {&likes_[slot], &views_[slot]}) {
+            for (const auto &e : *edges) weight += decayed(e.second.weight, e.second.timestamp, now);
+        }
+        out.put<int>(static_cast<int>(likes_[slot].size()));
+        out.put<uint64_t>(static_cast<uint64_t>(llround(unique_viewers_[slot].estimate())));
+        out.put<double>(weight);
+        out.put<double>(post_rank_[slot]);
+        break;
+    }
+    case ShardOp::RankTop: {
+        const size_t n = min(in.get<uint64_t>(), static_cast<uint64_t>(user_slots_.size()));
+        vector<size_t> order(user_slots_.size());
+        for (size_t u = 0; u < order.size(); ++u) order[u] = u;
+        partial_sort(order.begin(), order.begin() + static_cast<ptrdiff_t>(n), order.end(), [&](size_t a, size_t b) {
+            if (user_rank_[a] != user_rank_[b]) return user_rank_[a] > user_rank_[b];
+            return a < b;  // slot order is id order
+        });
+        out.put<uint64_t>(n);
+        for (size_t i = 0; i < n; ++i) {
+            out.put<double>(user_rank_[order[i]]);
+            out.put<int>(user_slots_.id_at(order[i]));
+            out.put_string(names_[order[i]]);
+        }
+        break;
+    }
+    case ShardOp::BfsStep:
+        bfs_step(in, out);
+        break;
+    case ShardOp::BfsParent: {
+        const int slot = user_slots_.slot(in.get<int>());
+        out.put<int>(slot >= 0 && static_cast<size_t>(slot) < bfs_parent_.size() ? bfs_parent_[slot] : 0);
+        break;
+    }
+    case ShardOp::RankInit:
+        rank_init(in, out);
+        break;
+    case ShardOp::RankScatter:
+        rank_scatter(in, out);
+        break;
+    case ShardOp::RankGather:
+        rank_gather(in, out);
+        break;
+    case ShardOp::RankApply:
+        rank_apply(in, out);
+        break;
+    case ShardOp::SimDegrees:
+        sim_degrees(out);
+        break;
+    case ShardOp::SimFollowers:
+        sim_followers(in, out);
+        break;
+    case ShardOp::SimEdges:
+        sim_edges(in, out);
+        break;
+    case ShardOp::LabelInit:
+        label_init(in, out);
+        break;
+    case ShardOp::LabelStep:
+        label_step(in, out);
+        break;
+    case ShardOp::Labels: {
+        vector<LabelOffer> labels(user_slots_.size());
+        for (size_t u = 0; u < labels.size(); ++u) labels[u] = {user_slots_.id_at(u), label_[u]};
+        out.put_vector(labels);
+        similar_ = {};
+        label_ = {};
+        break;
+    }
+    }
+    return out.take();
+}
+
+// Level-synchronous BFS: the inbox holds the users first reached in the
+// previous level, and the outbox every followee of theirs not known to be
+// reached already, at most once per shard and level.
+void ShardStore::bfs_step(WireReader &in, WireWriter &out) {
+    const bool fresh = in.get<bool>();
+    const int target = in.get<int>();
+    const vector<BfsVisit> inbox = in.get_vector<BfsVisit>();
+    if (fresh) bfs_parent_.assign(user_slots_.size(), 0);
+    vector<int> frontier;
+    for (const BfsVisit &visit : inbox) {
+        const int slot = user_slots_.slot(visit.user);
+        if (slot < 0 || bfs_parent_[slot] != 0) continue;
+        bfs_parent_[slot] = visit.parent;
+        frontier.push_back(slot);
+    }
+    const int target_slot = user_slots_.slot(target);
+    const bool found = target_slot >= 0 && bfs_parent_[target_slot] != 0;
+    out.put<bool>(found);
+    Outbox<BfsVisit> outbox(shards_);
+    if (!found) {
+        unordered_set<int> offered;
+        for (int slot : frontier) {
+            const int from = user_slots_.id_at(slot);
+            for (int w : followees_[slot]) {
+                const int local = user_slots_.slot(w);
+                if (local >= 0 && bfs_parent_[local] != 0) continue;
+                if (!offered.insert(w).second) continue;
+                outbox[shard_of_user(w, shards_)].push_back({w, from});
+            }
+        }
+    }
+    put_outbox(out, outbox);
+}
+
+// Bipartite PageRank as in Graph::recompute_analytics: users pass rank to
+// the posts they liked or viewed in proportion to decayed weight, posts are
+// boosted by unique viewers and pass it all to their author. Posts live with
+// their authors, so only the user -> post half crosses shards.
+void ShardStore::rank_init(WireReader &in, WireWriter &out) {
+    const int64_t now = in.get<int64_t>();
+    RankState &r = rank_;
+    r = RankState();
+    r.damping = in.get<double>();
+    const size_t users = user_slots_.size(), posts = post_slots_.size();
+    r.share_offsets.assign(users + 1, 0);
+    for (size_t u = 0; u < users; ++u) {
+        const size_t begin = r.shares.size();
+        double outgoing = 0.0;
+        for (const auto *edges : {&liked_[u], &viewed_[u]}) {
+            for (const auto &e : *edges) {
+                const double w = decayed(e.second.weight, e.second.timestamp, now);
+                if (w <= 0.0) continue;
+                r.shares.push_back({e.first, w});
+                outgoing += w;
+            }
+        }
+        for (size_t i = begin; i < r.shares.size(); ++i) r.shares[i].fraction /= outgoing;
+        r.share_offsets[u + 1] = r.shares.size();
+    }
+    r.boost.resize(posts);
+    r.author_slot.resize(posts);
+    for (size_t p = 0; p < posts; ++p) {
+        r.boost[p] = 1.0 + 0.05 * log1p(max(0.0, unique_viewers_[p].estimate()));
+        r.author_slot[p] = user_slots_.slot(author_[p]);
+    }
+    out.put<uint64_t>(users);
+    out.put<uint64_t>(posts);
+}
+
+void ShardStore::rank_scatter(WireReader &in, WireWriter &out) {
+    const double user_rank = in.get<double>(), post_rank = in.get<double>();
+    fill(user_rank_.begin(), user_rank_.end(), user_rank);
+    fill(post_rank_.begin(), post_rank_.end(), post_rank);
+    scatter_ranks(out);
+}
+
+// Sends each post the damped rank of its likers and viewers, combined per
+// post first; users with no outgoing weight are summed as dangling mass.
+void ShardStore::scatter_ranks(WireWriter &out) {
+    const RankState &r = rank_;
+    double dangling = 0.0;
+    unordered_map<int, double> flow;
+    for (size_t u = 0; u < user_slots_.size(); ++u) {
+        if (r.share_offsets[u] == r.share_offsets[u + 1]) {
+            dangling += user_rank_[u];
+            continue;
+        }
+        const double rank = r.damping * user_rank_[u];
+        for (size_t i = r.share_offsets[u]; i < r.share_offsets[u + 1]; ++i) flow[r.shares[i].post] += rank * r.shares[i].fraction;
+    }
+    Outbox<RankShare> outbox(shards_);
+    for (const auto &f : flow) outbox[shard_of_post(f.first, shards_)].push_back({f.first, f.second});
+    out.put<double>(dangling);
+    put_outbox(out, outbox);
+}
+
+void ShardStore::rank_gather(WireReader &in, WireWriter &out) {
+    RankState &r = rank_;
+    const double post_base = in.get<double>();
+    r.next_post.assign(post_slots_.size(), post_base);
+    for (const RankShare &share : in.get_vector<RankShare>()) {
+        const int slot = post_slots_.slot(share.post);
+        if (slot >= 0) r.next_post[slot] += share.rank;
+    }
+    double boosted = 0.0;
+    for (size_t p = 0; p < r.next_post.size(); ++p) {
+        r.next_post[p] *= r.boost[p];
+        boosted += r.next_post[p];
+    }
+    out.put<double>(boosted);
+}
+
+// Normalizes by the global boosted sum, passes post rank to authors, and
+// scatters again for the next iteration in the same round trip.
+void ShardStore::rank_apply(WireReader &in, WireWriter &out) {
+    RankState &r = rank_;
+    const double boosted_sum = in.get<double>(), user_base = in.get<double>();
+    if (boosted_sum > 0.0) {
+        for (double &rank : r.next_post) rank /= boosted_sum;
+    }
+    r.next_user.assign(user_slots_.size(), user_base);
+    for (size_t p = 0; p < r.next_post.size(); ++p) {
+        if (r.author_slot[p] >= 0) r.next_user[r.author_slot[p]] += r.damping * r.next_post[p];
+    }
+    double delta = 0.0;
+    for (size_t u = 0; u < user_rank_.size(); ++u) delta += fabs(r.next_user[u] - user_rank_[u]);
+    for (size_t p = 0; p < post_rank_.size(); ++p) delta += fabs(r.next_post[p] - post_rank_[p]);
+    user_rank_.swap(r.next_user);
+    post_rank_.swap(r.next_post);
+    out.put<double>(delta);
+    scatter_ranks(out);
+}
+
+// Communities as in GraphSnapshot::communities: users whose followee sets
+// have Jaccard similarity above 0.1 are joined. Only users sharing a
+// followee can be similar, so rather than comparing all pairs, each shard
+// receives the follower lists of its users' followees and counts, for each
+// of its users, how often every later user shows up across those lists.
+void ShardStore::sim_degrees(WireWriter &out) {
+    similar_.assign(user_slots_.size(), {});
+    label_.resize(user_slots_.size());
+    Outbox<FollowerDegree> outbox(shards_);
+    for (size_t u = 0; u < user_slots_.size(); ++u) {
+        const int id = user_slots_.id_at(u);
+        label_[u] = id;
+        const int degree = static_cast<int>(followees_[u].size());
+        for (int z : followees_[u]) outbox[shard_of_user(z, shards_)].push_back({z, id, degree});
+    }
+    put_outbox(out, outbox);
+}
+
+// Sends each followee's whole follower list, degrees included, once to
+// every shard owning one of those followers.
+void ShardStore::sim_followers(WireReader &in, WireWriter &out) {
+    vector<FollowerDegree> inbox = in.get_vector<FollowerDegree>();
+    sort(inbox.begin(), inbox.end(), [](const FollowerDegree &x, const FollowerDegree &y) {
+        return x.followee != y.followee ? x.followee < y.followee : x.follower < y.follower;
+    });
+    Outbox<FollowerDegree> outbox(shards_);
+    vector<unsigned char> wanted(shards_);
+    for (size_t begin = 0; begin < inbox.size();) {
+        size_t end = begin;
+        while (end < inbox.size() && inbox[end].followee == inbox[begin].followee) ++end;
+        fill(wanted.begin(), wanted.end(), 0);
+        for (size_t i = begin; i < end; ++i) wanted[shard_of_user(inbox[i].follower, shards_)] = 1;
+        for (size_t d = 0; d < shards_; ++d) {
+            if (wanted[d]) outbox[d].insert(outbox[d].end(), inbox.begin() + static_cast<ptrdiff_t>(begin),
+                                            inbox.begin() + static_cast<ptrdiff_t>(end));
+        }
+        begin = end;
+    }
+    put_outbox(out, outbox);
+}
+
+void ShardStore::sim_edges(WireReader &in, WireWriter &out) {
+    unordered_map<int, vector<pair<int, int>>> followers_of;  // followee -> (follower, its degree)
+    int max_id = 0;
+    for (const FollowerDegree &f : in.get_vector<FollowerDegree>()) {
+        followers_of[f.followee].emplace_back(f.follower, f.degree);
+        max_id = max(max_id, f.follower);
+    }
+    // common[j]: followees shared with the current user; touched lists the j to reset
+    vector<int> common(static_cast<size_t>(max_id) + 1, 0), degree(common.size(), 0);
+    vector<int> touched;
+    Outbox<SimilarityEdge> outbox(shards_);
+    for (size_t u = 0; u < user_slots_.size(); ++u) {
+        const int id = user_slots_.id_at(u);
+        const int own_degree = static_cast<int>(followees_[u].size());
+        for (int z : followees_[u]) {
+            auto it = followers_of.find(z);
+            if (it == followers_of.end()) continue;
+            for (const auto &f : it->second) {
+                if (f.first <= id) continue;  // each pair once, by its lower id
+                if (common[f.first]++ == 0) touched.push_back(f.first);
+                degree[f.first] = f.second;
+            }
+        }
+        for (int j : touched) {
+            const double jaccard = static_cast<double>(common[j]) / static_cast<double>(own_degree + degree[j] - common[j]);
+            if (jaccard > 0.1) {
+                similar_[u].push_back(j);
+                outbox[shard_of_user(j, shards_)].push_back({j, id});
+            }
+            common[j] = 0;
+        }
+        touched.clear();
+    }
+    put_outbox(out, outbox);
+}
+
+// Components of the similarity graph by min-label propagation: every user
+// starts with its own id and keeps offering the lowest label it has seen to
+// its neighbours until no offer lowers anything.
+void ShardStore::label_init(WireReader &in, WireWriter &out) {
+    for (const SimilarityEdge &e : in.get_vector<SimilarityEdge>()) {
+        const int slot = user_slots_.slot(e.user);
+        if (slot >= 0) similar_[slot].push_back(e.neighbour);
+    }
+    Outbox<LabelOffer> outbox(shards_);
+    for (size_t u = 0; u < similar_.size(); ++u) {
+        for (int n : similar_[u]) {
+            if (label_[u] < n) outbox[shard_of_user(n, shards_)].push_back({n, label_[u]});
+        }
+    }
+    put_outbox(out, outbox);
+}
+
+void ShardStore::label_step(WireReader &in, WireWriter &out) {
+    vector<int> changed;
+    vector<unsigned char> queued(label_.size(), 0);
+    for (const LabelOffer &offer : in.get_vector<LabelOffer>()) {
+        const int slot = user_slots_.slot(offer.user);
+        if (slot < 0 || offer.label >= label_[slot]) continue;
+        label_[slot] = offer.label;
+        if (!queued[slot]) {
+            queued[slot] = 1;
+            changed.push_back(slot);
+        }
+    }
+    Outbox<LabelOffer> outbox(shards_);
+    for (int slot : changed) {
+        for (int n : similar_[slot]) {
+            const int local = user_slots_.slot(n);
+            if (local >= 0 && label_[local] <= label_[slot]) continue;
+            outbox[shard_of_user(n, shards_)].push_back({n, label_[slot]});
+        }
+    }
+    put_outbox(out, outbox);
+}
+
+void serve_shard(int fd, ShardStore &store) {
+    string frame;
+    while (read_frame(fd, frame)) {
+        WireReader request(move(frame));
+        const auto op = request.get<ShardOp>();
+        if (op == ShardOp::Shutdown) {
+            write_frame(fd, string());
+            return;
+        }
+        write_frame(fd, store.handle(op, request));
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "dense_id_map.hpp"
+#include "hll_sketch.hpp"
+#include "shard_wire.hpp"
+
+// One shard's partition of the social graph: the users hashed to it with
+// both directions of their follow edges and their side of every like/view,
+// the posts they wrote with the posts' side of the same interactions, and
+// its slice of the username directory. Each edge is stored by both owners,
+// so every superstep reads only local state. Owned by a single-threaded
+// worker process, so nothing here locks.
+class ShardStore {
+public:
+    // Replays db_path (its own append log, same record format as Graph's
+    // plus N|id|name directory entries); "" keeps the shard in memory only.
+    ShardStore(std::size_t shard, std::size_t shards, const std::string &db_path);
+
+    // Applies one request and returns its reply.
+    std::string handle(ShardOp op, WireReader &request);
+
+private:
+    struct Stamp {
+        double weight = 0.0;
+        std::int64_t timestamp = 0;
+    };
+    using InteractionMap = std::unordered_map<int, Stamp>;  // by the other end's id
+    using Kind = InteractionKind;
+
+    bool owns_user(int user_id) const { return shard_of_user(user_id, shards_) == shard_; }
+    bool owns_post(int post_id) const { return shard_of_post(post_id, shards_) == shard_; }
+    void load(const std::string &path);
+    void append_record(const std::string &line);
+
+    bool add_user(int user_id, const std::string &name);
+    int add_post(int post_id, int author, const std::string &content);
+    bool record_out(Kind kind, int user_id, int post_id, Stamp stamp);  // false if unchanged
+    bool record_in(Kind kind, int user_id, int post_id, Stamp stamp);
+
+    // supersteps; each reads its inbox from the request and writes its outbox
+    void bfs_step(WireReader &in, WireWriter &out);
+    void rank_init(WireReader &in, WireWriter &out);
+    void rank_scatter(WireReader &in, WireWriter &out);
+    void scatter_ranks(WireWriter &out);
+    void rank_gather(WireReader &in, WireWriter &out);
+    void rank_apply(WireReader &in, WireWriter &out);
+    void sim_degrees(WireWriter &out);
+    void sim_followers(WireReader &in, WireWriter &out);
+    void sim_edges(WireReader &in, WireWriter &out);
+    void label_init(WireReader &in, WireWriter &out);
+    void label_step(WireReader &in, WireWriter &out);
+
+    std::size_t shard_;
+    std::size_t shards_;
+    std::string db_path_;
+    int next_post_id_;
+
+    std::unordered_map<std::string, int> directory_;  // lowercased name -> user id, for names hashed here
+
+    // users owned here, columns by slot
+    DenseIdMap user_slots_;
+    std::vector<std::string> names_;
+    std::vector<std::unordered_set<int>> followees_;
+    std::vector<std::unordered_set<int>> followers_;
+    std::vector<InteractionMap> liked_;   // by post id
+    std::vector<InteractionMap> viewed_;
+    std::vector<double> user_rank_;       // 0 until the first analytics run
+
+    // posts owned here (their authors are), columns by slot
+    DenseIdMap post_slots_;
+    std::vector<int> author_;
+    std::vector<std::string> content_;
+    std::vector<InteractionMap> likes_;   // by user id
+    std::vector<InteractionMap> views_;
+    std::vector<HllSketch> unique_viewers_;
+    std::vector<double> post_rank_;
+
+    // PageRank between RankInit and the last RankApply
+    struct Share {
+        int post;
+        double fraction;  // of the user's decayed outgoing like/view weight
+    };
+    struct RankState {
+        double damping = 0.85;
+        std::vector<std::size_t> share_offsets;  // by user slot
+        std::vector<Share> shares;
+        std::vector<double> boost;               // by post slot
+        std::vector<int> author_slot;            // by post slot
+        std::vector<double> next_user;
+        std::vector<double> next_post;
+    } rank_;
+
+    std::vector<int> bfs_parent_;  // by user slot, 0 = not reached
+
+    std::vector<std::vector<int>> similar_;  // by user slot: users with followee Jaccard > 0.1
+    std::vector<int> label_;                 // by user slot: lowest id reached so far
+};
+
+// Serves requests from fd until Shutdown or the coordinator hangs up.
+void serve_shard(int fd, ShardStore &store);
@@ -0,0 +1,77 @@
+#include "shard_wire.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+static void write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error("shard wire: send failed: " + string(strerror(errno)));
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+// False if the stream ended before the first byte.
+static bool read_all(int fd, char *data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = read(fd, data + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error("shard wire: read failed: " + string(strerror(errno)));
+        }
+        if (n == 0) {
+            if (done == 0) return false;
+            throw runtime_error("shard wire: stream ended inside a frame");
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void write_frame(int fd, const string &payload) {
+    const uint64_t size = payload.size();
+    // small frames (most point requests) go out in one send instead of two
+    if (size <= 4096) {
+        string frame(reinterpret_cast<const char *>(&size), sizeof(size));
+        frame += payload;
+        write_all(fd, frame.data(), frame.size());
+        return;
+    }
+    write_all(fd, reinterpret_cast<const char *>(&size), sizeof(size));
+    write_all(fd, payload.data(), payload.size());
+}
+
+bool read_frame(int fd, string &payload) {
+    uint64_t size = 0;
+    if (!read_all(fd, reinterpret_cast<char *>(&size), sizeof(size))) return false;
+    payload.resize(size);
+    if (size > 0 && !read_all(fd, payload.data(), size)) throw runtime_error("shard wire: stream ended inside a frame");
+    return true;
+}
+
+size_t shard_of_user(int user_id, size_t shards) {
+    // splitmix64 finalizer: consecutive ids land on unrelated shards
+    uint64_t x = static_cast<uint64_t>(static_cast<uint32_t>(user_id)) + 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return static_cast<size_t>(x % shards);
+}
+
+size_t shard_of_name(const string &lowered, size_t shards) {
+    // FNV-1a, fixed so that a directory persisted by one build is found by the next
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : lowered) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return static_cast<size_t>(h % shards);
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Requests from the coordinator to a shard worker; every request gets exactly
+// one reply frame. Point operations touch one shard; the Bfs*, Rank* and
+// Sim*/Label* steps are supersteps of the cross-shard algorithms in
+// sharded_graph.cpp, sent to every shard at once.
+enum class ShardOp : std::uint8_t {
+    Shutdown,
+    Limits,          // -> highest user id, next post id this shard will hand out
+    ReserveName,     // lowered name, user id -> bool (false if taken)
+    FindName,        // lowered name -> user id or -1
+    AddUser,         // id, name
+    HasUser,         // id -> bool
+    AddPost,         // author, content -> post id
+    PostAuthor,      // post id -> author or -1
+    FollowOut,       // a, b: a's side of a -> b; -> bool (false if a unknown)
+    FollowIn,        // a, b: b's side
+    FollowsUser,     // a, b -> does a follow b
+    InteractionOut,  // kind, user, post, weight, timestamp -> bool: user's side
+    InteractionIn,   // same, post's side
+    Followers,
+    Followees,
+    UserPosts,
+    UserMetrics,
+    PostMetrics,
+    RankTop,         // n -> best n (score, id, name) on this shard
+    BfsStep,
+    BfsParent,
+    RankInit,
+    RankScatter,
+    RankGather,
+    RankApply,
+    SimDegrees,
+    SimFollowers,
+    SimEdges,
+    LabelInit,
+    LabelStep,
+    Labels,
+};
+
+enum class InteractionKind : std::uint8_t { Like, View };
+
+// Byte buffer of fixed-layout values. Vectors of trivially copyable records
+// are written as a byte length and the raw bytes, so the coordinator can
+// route superstep messages by concatenating them without decoding.
+class WireWriter {
+public:
+    template <class T>
+    void put(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "fixed-layout values only");
+        const auto *p = reinterpret_cast<const char *>(&value);
+        bytes_.append(p, sizeof(T));
+    }
+    void put_string(const std::string &s) {
+        put<std::uint64_t>(s.size());
+        bytes_.append(s);
+    }
+    template <class T>
+    void put_vector(const std::vector<T> &v) {
+        static_assert(std::is_trivially_copyable<T>::value, "fixed-layout records only");
+        put_raw(v.data(), v.size() * sizeof(T));
+    }
+    void put_raw(const void *data, std::size_t size) {
+        put<std::uint64_t>(size);
+        bytes_.append(static_cast<const char *>(data), size);
+    }
+    const std::string &bytes() const { return bytes_; }
+    std::string take() { return std::move(bytes_); }
+
+private:
+    std::string bytes_;
+};
+
+// Reads what a WireWriter wrote, in the same order. Running past the end
+// means the two sides disagree on a message layout: throws.
+class WireReader {
+public:
+    // swapped in rather than move-constructed: GCC 12 cannot follow a moved
+    // short string's inline buffer and warns on every get() otherwise
+    explicit WireReader(std::string bytes) { bytes_.swap(bytes); }
+
+    template <class T>
+    T get() {
+        static_assert(std::is_trivially_copyable<T>::value, "fixed-layout values only");
+        T value{};
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+    std::string get_string() {
+        const auto size = get<std::uint64_t>();
+        return std::string(take(size), size);
+    }
+    template <class T>
+    std::vector<T> get_vector() {
+        const auto size = get<std::uint64_t>();
+        if (size % sizeof(T) != 0) throw std::runtime_error("shard wire: ragged record vector");
+        std::vector<T> v(size / sizeof(T));
+        const char *p = take(size);
+        if (size) std::memcpy(v.data(), p, size);
+        return v;
+    }
+    // One put_raw / put_vector payload, undecoded.
+    std::string get_raw() { return get_string(); }
+
+private:
+    const char *take(std::size_t size) {
+        if (bytes_.size() - pos_ < size) throw std::runtime_error("shard wire: truncated message");
+        const char *p = bytes_.data() + pos_;
+        pos_ += size;
+        return p;
+    }
+
+    std::string bytes_;
+    std::size_t pos_ = 0;
+};
+
+// Length-prefixed frames over a stream socket. Both throw on I/O errors;
+// read_frame returns false on a clean end of stream before a frame starts.
+// Writes never raise SIGPIPE, so a dead peer surfaces as an exception.
+void write_frame(int fd, const std::string &payload);
+bool read_frame(int fd, std::string &payload);
+
+// Placement: users by a hash of their id, names by a hash of the lowercased
+// name (the directory that keeps them unique), posts with their author.
+// Shard s hands out post ids s + 1, s + 1 + n, ..., so a post id alone
+// names its shard.
+std::size_t shard_of_user(int user_id, std::size_t shards);
+std::size_t shard_of_name(const std::string &lowered, std::size_t shards);
+inline std::size_t shard_of_post(int post_id, std::size_t shards) {
+    return post_id > 0 ? static_cast<std::size_t>(post_id - 1) % shards : 0;
+}
+
+// Superstep messages, each addressed to the shard owning its first user or post.
+struct BfsVisit {
+    int user;
+    int parent;  // user that reached it; the source is its own parent
+};
+struct RankShare {
+    int post;
+    double rank;  // damped rank flowing into the post, already summed per sending shard
+};
+struct FollowerDegree {
+    int followee;
+    int follower;
+    int degree;  // follower's followee count
+};
+struct SimilarityEdge {
+    int user;
+    int neighbour;
+};
+struct LabelOffer {
+    int user;
+    int label;
+};
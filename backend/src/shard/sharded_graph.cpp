@@ -0,0 +1,425 @@
+#include "sharded_graph.hpp"
+#include "shard_store.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+string lower(const string &s) {
+    string out;
+    out.reserve(s.size());
+    for (char c : s) out.push_back(static_cast<char>(tolower(static_cast<unsigned char>(c))));
+    return out;
+}
+
+int64_t current_epoch_seconds() {
+    return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void put_arg(WireWriter &w, const string &s) { w.put_string(s); }
+
+template <class T>
+void put_arg(WireWriter &w, const T &value) { w.put(value); }
+
+template <class... Args>
+WireWriter request(ShardOp op, const Args &...args) {
+    WireWriter w;
+    w.put(op);
+    (put_arg(w, args), ...);
+    return w;
+}
+
+// The same request to every shard, each followed by its inbox.
+vector<WireWriter> with_inboxes(size_t shards, const vector<string> &inboxes, ShardOp op) {
+    vector<WireWriter> requests(shards);
+    for (size_t s = 0; s < shards; ++s) {
+        requests[s] = request(op);
+        requests[s].put_raw(inboxes[s].data(), inboxes[s].size());
+    }
+    return requests;
+}
+
+bool ranks_higher(const RankedUser &a, const RankedUser &b) {
+    if (a.third != b.third) return a.third > b.third;
+    return a.first < b.first;
+}
+
+} // namespace
+
+ShardedGraph::ShardedGraph(size_t shards, const string &db_dir) {
+    shards = max<size_t>(1, shards);
+    try { if (!db_dir.empty()) filesystem::create_directories(db_dir); } catch(...) {}
+    try {
+        for (size_t s = 0; s < shards; ++s) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) throw runtime_error("sharded graph: socketpair failed");
+            const pid_t pid = fork();
+            if (pid < 0) {
+                close(fds[0]);
+                close(fds[1]);
+                throw runtime_error("sharded graph: fork failed");
+            }
+            if (pid == 0) {
+                // the worker keeps only its own end; _exit skips the parent's atexit work
+                close(fds[0]);
+                for (const auto &c : channels_) close(c->fd);
+                int status = 0;
+                try {
+                    const string path = db_dir.empty() ? string() :
+                        (filesystem::path(db_dir) / ("shard-" + to_string(s) + "-of-" + to_string(shards) + ".db")).string();
+                    ShardStore store(s, shards, path);
+                    serve_shard(fds[1], store);
+                } catch (const exception &e) {
+                    fprintf(stderr, "shard %zu: %s\n", s, e.what());
+                    status = 1;
+                }
+                _exit(status);
+            }
+            close(fds[1]);
+            auto channel = make_unique<Channel>();
+            channel->fd = fds[0];
+            channel->pid = pid;
+            channels_.push_back(move(channel));
+        }
+        // user ids continue after the highest any shard has seen
+        for (size_t s = 0; s < shards; ++s) {
+            WireReader limits = call(s, request(ShardOp::Limits));
+            next_user_id_ = max(next_user_id_, limits.get<int>() + 1);
+        }
+    } catch (...) {
+        stop_workers();
+        throw;
+    }
+}
+
+ShardedGraph::~ShardedGraph() {
+    stop_workers();
+}
+
+void ShardedGraph::stop_workers() {
+    for (size_t s = 0; s < channels_.size(); ++s) {
+        try {
+            call(s, request(ShardOp::Shutdown));
+        } catch (...) {
+            // already gone; reaping below is all that is left
+        }
+        close(channels_[s]->fd);
+        waitpid(channels_[s]->pid, nullptr, 0);
+    }
+    channels_.clear();
+}
+
+WireReader ShardedGraph::call_locked(size_t shard, const WireWriter &request) {
+    const int fd = channels_[shard]->fd;
+    write_frame(fd, request.bytes());
+    string reply;
+    if (!read_frame(fd, reply)) throw runtime_error("sharded graph: shard " + to_string(shard) + " exited");
+    return WireReader(move(reply));
+}
+
+WireReader ShardedGraph::call(size_t shard, const WireWriter &request) {
+    lock_guard lock(channels_[shard]->mutex);
+    return call_locked(shard, request);
+}
+
+ShardedGraph::ChannelLocks ShardedGraph::lock_pair(size_t a, size_t b) {
+    ChannelLocks locks;
+    locks.emplace_back(channels_[min(a, b)]->mutex);
+    if (a != b) locks.emplace_back(channels_[max(a, b)]->mutex);
+    return locks;
+}
+
+ShardedGraph::ChannelLocks ShardedGraph::lock_all() {
+    ChannelLocks locks;
+    locks.reserve(channels_.size());
+    for (auto &c : channels_) locks.emplace_back(c->mutex);  // ascending shard order
+    return locks;
+}
+
+vector<WireReader> ShardedGraph::superstep(const vector<WireWriter> &requests) {
+    ++exchange_.supersteps;
+    // A shard blocked writing a large reply only waits for its own read
+    // below; it never stops the writes to the shards after it.
+    for (size_t s = 0; s < channels_.size(); ++s) write_frame(channels_[s]->fd, requests[s].bytes());
+    vector<WireReader> replies;
+    replies.reserve(channels_.size());
+    for (size_t s = 0; s < channels_.size(); ++s) {
+        string reply;
+        if (!read_frame(channels_[s]->fd, reply)) throw runtime_error("sharded graph: shard " + to_string(s) + " exited");
+        replies.emplace_back(move(reply));
+    }
+    return replies;
+}
+
+vector<string> ShardedGraph::route(vector<WireReader> &replies) {
+    vector<string> inboxes(channels_.size());
+    for (auto &reply : replies) {
+        for (auto &inbox : inboxes) {
+            const string part = reply.get_raw();
+            exchange_.routed_bytes += part.size();
+            inbox += part;
+        }
+    }
+    return inboxes;
+}
+
+bool ShardedGraph::empty_inboxes(const vector<string> &inboxes) {
+    return all_of(inboxes.begin(), inboxes.end(), [](const string &inbox) { return inbox.empty(); });
+}
+
+int ShardedGraph::add_user(const string &username) {
+    const string key = lower(username);
+    const size_t n = channels_.size();
+    // claim the name with the id it would get; ids stay gapless because no
+    // other add_user can take the id in between
+    lock_guard ids_lock(user_ids_mutex_);
+    const int id = next_user_id_;
+    const size_t name_shard = shard_of_name(key, n), user_shard = shard_of_user(id, n);
+    auto locks = lock_pair(name_shard, user_shard);
+    if (!call_locked(name_shard, request(ShardOp::ReserveName, key, id)).get<bool>()) return -1;
+    ++next_user_id_;
+    call_locked(user_shard, request(ShardOp::AddUser, id, username));
+    return id;
+}
+
+int ShardedGraph::find_user_by_username(const string &username) {
+    const string key = lower(username);
+    return call(shard_of_name(key, channels_.size()), request(ShardOp::FindName, key)).get<int>();
+}
+
+int ShardedGraph::add_post(int user_id, const string &content) {
+    return call(shard_of_user(user_id, channels_.size()), request(ShardOp::AddPost, user_id, content)).get<int>();
+}
+
+bool ShardedGraph::add_follow(int a, int b) {
+    const size_t n = channels_.size();
+    if (a == b) return false;
+    const size_t from = shard_of_user(a, n), to = shard_of_user(b, n);
+    auto locks = lock_pair(from, to);
+    if (!call_locked(from, request(ShardOp::HasUser, a)).get<bool>() ||
+        !call_locked(to, request(ShardOp::HasUser, b)).get<bool>()) {
+        return false;
+    }
+    call_locked(from, request(ShardOp::FollowOut, a, b));
+    call_locked(to, request(ShardOp::FollowIn, a, b));
+    return true;
+}
+
+bool ShardedGraph::add_like(int user_id, int post_id, double weight, int64_t timestamp) {
+    return add_interaction(InteractionKind::Like, user_id, post_id, weight, timestamp);
+}
+
+bool ShardedGraph::add_view(int user_id, int post_id, double weight, int64_t timestamp) {
+    return add_interaction(InteractionKind::View, user_id, post_id, weight, timestamp);
+}
+
+bool ShardedGraph::add_interaction(InteractionKind kind, int user_id, int post_id, double weight, int64_t timestamp) {
+    const size_t n = channels_.size();
+    if (weight <= 0.0) return false;
+    if (timestamp <= 0) timestamp = current_epoch_seconds();
+    const size_t user_shard = shard_of_user(user_id, n), post_shard = shard_of_post(post_id, n);
+    auto locks = lock_pair(user_shard, post_shard);
+    const int author = call_locked(post_shard, request(ShardOp::PostAuthor, post_id)).get<int>();
+    if (author < 0) return false;
+    // likes require following the author, which the liker's shard knows
+    const bool allowed = kind == InteractionKind::Like
+        ? call_locked(user_shard, request(ShardOp::FollowsUser, user_id, author)).get<bool>()
+        : call_locked(user_shard, request(ShardOp::HasUser, user_id)).get<bool>();
+    if (!allowed) return false;
+    call_locked(user_shard, request(ShardOp::InteractionOut, kind, user_id, post_id, weight, timestamp));
+    call_locked(post_shard, request(ShardOp::InteractionIn, kind, user_id, post_id, weight, timestamp));
+    return true;
+}
+
+Graph::UserMetrics ShardedGraph::get_user_metrics(int user_id) {
+    WireReader reply = call(shard_of_user(user_id, channels_.size()), request(ShardOp::UserMetrics, user_id));
+    Graph::UserMetrics m;
+    if (!reply.get<bool>()) return m;
+    m.followers = reply.get<int>();
+    m.followings = reply.get<int>();
+    m.posts = reply.get<int>();
+    m.total_likes = reply.get<int>();
+    m.unique_reach = reply.get<uint64_t>();
+    m.score = reply.get<double>();
+    return m;
+}
+
+Graph::PostMetrics ShardedGraph::get_post_metrics(int post_id) {
+    WireReader reply = call(shard_of_post(post_id, channels_.size()),
+                            request(ShardOp::PostMetrics, post_id, current_epoch_seconds()));
+    Graph::PostMetrics m;
+    if (!reply.get<bool>()) return m;
+    m.likes = reply.get<int>();
+    m.unique_views = reply.get<uint64_t>();
+    m.interaction_weight = reply.get<double>();
+    m.score = reply.get<double>();
+    return m;
+}
+
+vector<int> ShardedGraph::get_followers(int user_id) {
+    return call(shard_of_user(user_id, channels_.size()), request(ShardOp::Followers, user_id)).get_vector<int>();
+}
+
+vector<int> ShardedGraph::get_followings(int user_id) {
+    return call(shard_of_user(user_id, channels_.size()), request(ShardOp::Followees, user_id)).get_vector<int>();
+}
+
+vector<int> ShardedGraph::get_user_posts(int user_id) {
+    return call(shard_of_user(user_id, channels_.size()), request(ShardOp::UserPosts, user_id)).get_vector<int>();
+}
+
+// Two round trips per iteration: RankGather sums the flow into each post,
+// RankApply normalizes with the global sum, hands post rank to authors and
+// scatters the next iteration's flow. Convergence is checked here on the
+// summed per-shard deltas, with Graph's damping, tolerance and cap.
+void ShardedGraph::recompute_analytics() {
+    const double damping = 0.85;
+    const double epsilon = 1e-9;
+    const int max_iterations = 200;
+    const size_t n = channels_.size();
+    auto locks = lock_all();
+    exchange_ = ExchangeStats();
+
+    const int64_t now = current_epoch_seconds();
+    vector<WireWriter> requests(n);
+    for (auto &r : requests) r = request(ShardOp::RankInit, now, damping);
+    vector<WireReader> replies = superstep(requests);
+    uint64_t users = 0, posts = 0;
+    for (auto &reply : replies) {
+        users += reply.get<uint64_t>();
+        posts += reply.get<uint64_t>();
+    }
+    if (users == 0) return;
+    const double initial_post = posts ? 1.0 / static_cast<double>(posts) : 0.0;
+    for (auto &r : requests) r = request(ShardOp::RankScatter, 1.0 / static_cast<double>(users), initial_post);
+    replies = superstep(requests);
+    if (posts == 0) return;  // every user keeps 1 / users
+
+    for (int iterations = 1;; ++iterations) {
+        double dangling = 0.0;
+        for (auto &reply : replies) dangling += reply.get<double>();
+        const vector<string> inboxes = route(replies);
+        const double post_base = (1.0 - damping) / static_cast<double>(posts) +
+                                 damping * dangling / static_cast<double>(posts);
+        requests.assign(n, WireWriter());
+        for (size_t s = 0; s < n; ++s) {
+            requests[s] = request(ShardOp::RankGather, post_base);
+            requests[s].put_raw(inboxes[s].data(), inboxes[s].size());
+        }
+        double boosted_sum = 0.0;
+        for (auto &reply : superstep(requests)) boosted_sum += reply.get<double>();
+
+        const double user_base = (1.0 - damping) / static_cast<double>(users);
+        for (auto &r : requests) r = request(ShardOp::RankApply, boosted_sum, user_base);
+        replies = superstep(requests);
+        double delta = 0.0;
+        for (auto &reply : replies) delta += reply.get<double>();
+        if (delta < epsilon || iterations >= max_iterations) break;
+    }
+}
+
+vector<RankedUser> ShardedGraph::get_ranked(int page, int limit) {
+    if (limit <= 0) return {};
+    const long long start = max(0LL, static_cast<long long>(page - 1) * limit);
+    const uint64_t wanted = static_cast<uint64_t>(start + limit);
+    vector<RankedUser> all;
+    for (size_t s = 0; s < channels_.size(); ++s) {
+        WireReader reply = call(s, request(ShardOp::RankTop, wanted));
+        for (uint64_t i = reply.get<uint64_t>(); i > 0; --i) {
+            RankedUser u;
+            u.third = reply.get<double>();
+            u.first = reply.get<int>();
+            u.second = reply.get_string();
+            all.push_back(move(u));
+        }
+    }
+    sort(all.begin(), all.end(), ranks_higher);
+    if (static_cast<size_t>(start) >= all.size()) return {};
+    const auto end = all.begin() + static_cast<ptrdiff_t>(min(all.size(), static_cast<size_t>(wanted)));
+    return vector<RankedUser>(make_move_iterator(all.begin() + start), make_move_iterator(end));
+}
+
+// One superstep per BFS level; the path is then read back one parent at a
+// time from the owners of the users on it.
+vector<int> ShardedGraph::bfs_path(int u1, int u2) {
+    const size_t n = channels_.size();
+    auto locks = lock_all();
+    exchange_ = ExchangeStats();
+    if (!call_locked(shard_of_user(u1, n), request(ShardOp::HasUser, u1)).get<bool>() ||
+        !call_locked(shard_of_user(u2, n), request(ShardOp::HasUser, u2)).get<bool>()) {
+        return {};
+    }
+    if (u1 == u2) return {u1};
+
+    vector<string> inboxes(n);
+    const BfsVisit source{u1, u1};
+    inboxes[shard_of_user(u1, n)].assign(reinterpret_cast<const char *>(&source), sizeof(source));
+    for (bool fresh = true;; fresh = false) {
+        vector<WireWriter> requests(n);
+        for (size_t s = 0; s < n; ++s) {
+            requests[s] = request(ShardOp::BfsStep, fresh, u2);
+            requests[s].put_raw(inboxes[s].data(), inboxes[s].size());
+        }
+        vector<WireReader> replies = superstep(requests);
+        bool found = false;
+        for (auto &reply : replies) found = reply.get<bool>() || found;
+        if (found) break;
+        inboxes = route(replies);
+        if (empty_inboxes(inboxes)) return {};
+    }
+    vector<int> path{u2};
+    for (int v = u2; v != u1;) {
+        v = call_locked(shard_of_user(v, n), request(ShardOp::BfsParent, v)).get<int>();
+        path.push_back(v);
+    }
+    reverse(path.begin(), path.end());
+    return path;
+}
+
+// Three supersteps find the similar pairs (see ShardStore::sim_degrees) and a
+// fourth seeds the labels; label propagation then takes one superstep per
+// round until no label drops.
+vector<pair<int, vector<int>>> ShardedGraph::communities() {
+    const size_t n = channels_.size();
+    auto locks = lock_all();
+    exchange_ = ExchangeStats();
+    vector<WireWriter> requests(n);
+    for (auto &r : requests) r = request(ShardOp::SimDegrees);
+    vector<WireReader> replies = superstep(requests);
+    for (ShardOp op : {ShardOp::SimFollowers, ShardOp::SimEdges, ShardOp::LabelInit}) {
+        replies = superstep(with_inboxes(n, route(replies), op));
+    }
+    for (;;) {
+        const vector<string> inboxes = route(replies);
+        if (empty_inboxes(inboxes)) break;
+        replies = superstep(with_inboxes(n, inboxes, ShardOp::LabelStep));
+    }
+
+    for (auto &r : requests) r = request(ShardOp::Labels);
+    map<int, vector<int>> groups;
+    for (auto &reply : superstep(requests)) {
+        for (const LabelOffer &l : reply.get_vector<LabelOffer>()) groups[l.label].push_back(l.user);
+    }
+    vector<pair<int, vector<int>>> out;
+    out.reserve(groups.size());
+    for (auto &g : groups) {
+        sort(g.second.begin(), g.second.end());
+        out.emplace_back(g.first, move(g.second));
+    }
+    return out;
+}
+
+ShardedGraph::ExchangeStats ShardedGraph::last_exchange() {
+    auto locks = lock_all();
+    return exchange_;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+#include "graph.hpp"
+#include "shard_wire.hpp"
+
+// Partitioned mode: users and their posts are hash-sharded across worker
+// processes on this machine (see ShardStore), each with its own memory and
+// no locks, and this coordinator routes calls to the owning shard over a
+// local socket per worker. Ids and return values follow Graph's.
+//
+// Point operations lock only the channel of the shard they talk to, one at
+// a time, so calls on different shards run in parallel. bfs_path,
+// recompute_analytics and communities hold every channel and run as
+// bulk-synchronous supersteps: each shard processes its inbox and returns an
+// outbox per destination shard, all shards at once, and the coordinator
+// concatenates the outboxes into the next step's inboxes without decoding
+// them.
+//
+// Writes that touch two shards (a follow, a like or view, a new user's name
+// and record) are all-or-nothing for every caller of this object: both
+// channels are held, ascending, while the write first checks everything on
+// both shards that could refuse it and only then applies the two halves.
+// Nothing is ever deleted in this mode, so a write that passed the checks
+// cannot be refused halfway, and readers never see one half without the
+// other. Both halves are idempotent (a repeated follow or identical
+// like/view stamp changes nothing).
+//
+// A worker that dies makes every later call on it throw std::runtime_error.
+// If it dies between the two halves of a write, the call throws and the
+// half already applied stays in the other shard's log; repeating the same
+// write once the directory is reopened completes it.
+class ShardedGraph {
+public:
+    // Forks `shards` workers. Each appends to db_dir/shard-<i>-of-<n>.db and
+    // replays it on start, so a directory must be reopened with the same
+    // shard count; "" keeps everything in memory. Construct before starting
+    // other threads: the workers are forked from the calling process.
+    ShardedGraph(std::size_t shards, const std::string &db_dir = "");
+    ~ShardedGraph();  // stops and reaps the workers
+    ShardedGraph(const ShardedGraph &) = delete;
+    ShardedGraph &operator=(const ShardedGraph &) = delete;
+
+    std::size_t shard_count() const { return channels_.size(); }
+
+    int add_user(const std::string &username);
+    int find_user_by_username(const std::string &username);
+    int add_post(int user_id, const std::string &content);
+    bool add_follow(int a, int b);
+    bool add_like(int user_id, int post_id, double weight = 3.0, std::int64_t timestamp = 0);
+    bool add_view(int user_id, int post_id, double weight = 1.0, std::int64_t timestamp = 0);
+
+    // followers, followings, posts, total_likes, unique_reach and score; the
+    // single-process analytics (clustering, centrality, components) stay 0
+    Graph::UserMetrics get_user_metrics(int user_id);
+    Graph::PostMetrics get_post_metrics(int post_id);
+    std::vector<int> get_followers(int user_id);
+    std::vector<int> get_followings(int user_id);
+    std::vector<int> get_user_posts(int user_id);
+
+    // Cross-shard, bulk-synchronous. Same results as Graph's, except that a
+    // community's id is its lowest member id and communities come sorted by it.
+    void recompute_analytics();  // bipartite PageRank over likes/views
+    std::vector<RankedUser> get_ranked(int page, int limit);
+    std::vector<int> bfs_path(int u1, int u2);
+    std::vector<std::pair<int, std::vector<int>>> communities();
+
+    struct ExchangeStats {
+        std::size_t supersteps = 0;
+        std::uint64_t routed_bytes = 0;  // superstep messages passed between shards
+    };
+    // Of the last bfs_path, recompute_analytics or communities call.
+    ExchangeStats last_exchange();
+
+private:
+    struct Channel {
+        int fd = -1;
+        pid_t pid = -1;
+        std::mutex mutex;
+    };
+    using ChannelLocks = std::vector<std::unique_lock<std::mutex>>;
+
+    // One request and its reply; the caller holds the channel's lock.
+    WireReader call_locked(std::size_t shard, const WireWriter &request);
+    WireReader call(std::size_t shard, const WireWriter &request);
+    ChannelLocks lock_all();
+    ChannelLocks lock_pair(std::size_t a, std::size_t b);  // ascending; a == b locks one
+    // add_like / add_view: validated on both shards, then both halves applied.
+    bool add_interaction(InteractionKind kind, int user_id, int post_id, double weight, std::int64_t timestamp);
+    // Sends every shard its request before reading any reply, so all shards
+    // work on the step at once. Caller holds every channel.
+    std::vector<WireReader> superstep(const std::vector<WireWriter> &requests);
+    // Reads one outbox per destination from each reply and concatenates
+    // them into that destination's inbox.
+    std::vector<std::string> route(std::vector<WireReader> &replies);
+    static bool empty_inboxes(const std::vector<std::string> &inboxes);
+    void stop_workers();
+
+    std::vector<std::unique_ptr<Channel>> channels_;
+    std::mutex user_ids_mutex_;  // next_user_id_; taken before any channel
+    int next_user_id_ = 1;
+    ExchangeStats exchange_;     // all channels
+};
@@ -0,0 +1,201 @@
+#include "hll_sketch.hpp"
+#include <algorithm>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr size_t kSparseLimit = HllSketch::kRegisters * 3 / 4 / sizeof(uint32_t);
+constexpr int kSuffixBits = HllSketch::kSparsePrecision - HllSketch::kPrecision;  // 11
+
+// murmur3 finalizer: user ids are small and sequential, registers need all 64 bits mixed
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+double harmonic_sum(const uint8_t *regs, size_t n, size_t &zeros) {
+    zeros = 0;
+#ifdef __SSE2__
+    // 2^-r built directly as a float: exponent field 127 - r, zero mantissa
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi32(127);
+    __m128d acc = _mm_setzero_pd();
+    for (size_t i = 0; i < n; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(regs + i));
+        zeros += static_cast<size_t>(__builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))));
+        const __m128i lo = _mm_unpacklo_epi8(v, zero);
+        const __m128i hi = _mm_unpackhi_epi8(v, zero);
+        const __m128i parts[4] = {_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                                  _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+        __m128 sum = _mm_setzero_ps();
+        for (const __m128i &p : parts) {
+            sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(bias, p), 23)));
+        }
+        acc = _mm_add_pd(acc, _mm_cvtps_pd(sum));
+        acc = _mm_add_pd(acc, _mm_cvtps_pd(_mm_movehl_ps(sum, sum)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return lanes[0] + lanes[1];
+#else
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += ldexp(1.0, -static_cast<int>(regs[i]));
+        zeros += regs[i] == 0;
+    }
+    return sum;
+#endif
+}
+
+} // namespace
+
+uint64_t hll::hash(uint64_t value) {
+    return mix64(value);
+}
+
+void hll::add(uint8_t *registers, size_t count, uint64_t hash) {
+    const int precision = __builtin_ctzll(count);
+    const uint64_t rest = hash << precision;
+    const uint8_t rank = rest ? static_cast<uint8_t>(__builtin_clzll(rest) + 1) : static_cast<uint8_t>(64 - precision + 1);
+    uint8_t &reg = registers[hash >> (64 - precision)];
+    if (rank > reg) reg = rank;
+}
+
+bool hll::merge(uint8_t *dst, const uint8_t *src, size_t count) {
+    size_t i = 0;
+#ifdef __SSE2__
+    int unchanged = 0xffff;
+    for (; i < count; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        const __m128i m = _mm_max_epu8(a, _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        unchanged &= _mm_movemask_epi8(_mm_cmpeq_epi8(a, m));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), m);
+    }
+    return unchanged != 0xffff;
+#else
+    bool grew = false;
+    for (; i < count; ++i) {
+        grew |= src[i] > dst[i];
+        dst[i] = max(dst[i], src[i]);
+    }
+    return grew;
+#endif
+}
+
+double hll::estimate(const uint8_t *registers, size_t count) {
+    const double m = static_cast<double>(count);
+    size_t zeros = 0;
+    const double sum = harmonic_sum(registers, count, zeros);
+    // bias constants from Flajolet et al.; the closed form is for m >= 128
+    const double alpha = count == 16 ? 0.673 : count == 32 ? 0.697 : count == 64 ? 0.709 : 0.7213 / (1.0 + 1.079 / m);
+    const double raw = alpha * m * m / sum;
+    if (raw <= 2.5 * m && zeros > 0) return m * log(m / static_cast<double>(zeros));
+    return raw;
+}
+
+uint32_t HllSketch::encode_sparse(uint64_t hash) {
+    const uint32_t index = static_cast<uint32_t>(hash >> (64 - kSparsePrecision));
+    const uint64_t rest = hash << kSparsePrecision;
+    const uint32_t rank = rest ? static_cast<uint32_t>(__builtin_clzll(rest)) + 1 : 64 - kSparsePrecision + 1;
+    return index << 6 | rank;
+}
+
+void HllSketch::add(uint64_t value) {
+    const uint32_t entry = encode_sparse(hll::hash(value));
+    if (is_sparse()) insert_sparse(entry);
+    else apply_sparse(entry);
+}
+
+void HllSketch::insert_sparse(uint32_t entry) {
+    auto it = lower_bound(sparse_.begin(), sparse_.end(), entry, [](uint32_t a, uint32_t b) {
+        return sparse_index(a) < sparse_index(b);
+    });
+    if (it != sparse_.end() && sparse_index(*it) == sparse_index(entry)) {
+        if (sparse_rank(entry) > sparse_rank(*it)) *it = entry;
+        return;
+    }
+    if (sparse_.size() == sparse_.capacity()) {
+        // grow geometrically, but never past the point where dense is cheaper
+        const size_t pos = static_cast<size_t>(it - sparse_.begin());
+        sparse_.reserve(min(max<size_t>(4, sparse_.size() * 2), kSparseLimit + 1));
+        it = sparse_.begin() + static_cast<ptrdiff_t>(pos);
+    }
+    sparse_.insert(it, entry);
+    if (sparse_.size() > kSparseLimit) to_dense();
+}
+
+void HllSketch::apply_sparse(uint32_t entry) {
+    // the index bits below kPrecision are the first bits of the dense rank
+    const uint32_t index = sparse_index(entry);
+    const uint32_t suffix = index & ((1u << kSuffixBits) - 1);
+    const uint8_t rank = suffix
+        ? static_cast<uint8_t>(__builtin_clz(suffix) - (32 - kSuffixBits) + 1)
+        : static_cast<uint8_t>(kSuffixBits + sparse_rank(entry));
+    uint8_t &reg = registers_[index >> kSuffixBits];
+    if (rank > reg) reg = rank;
+}
+
+void HllSketch::to_dense() {
+    registers_.assign(kRegisters, 0);
+    for (uint32_t entry : sparse_) apply_sparse(entry);
+    sparse_.clear();
+    sparse_.shrink_to_fit();
+}
+
+void HllSketch::merge(const HllSketch &other) {
+    if (&other == this) return;
+    if (other.is_sparse()) {
+        if (!is_sparse()) {
+            for (uint32_t entry : other.sparse_) apply_sparse(entry);
+            return;
+        }
+        vector<uint32_t> merged;
+        merged.reserve(sparse_.size() + other.sparse_.size());
+        size_t i = 0, j = 0;
+        while (i < sparse_.size() || j < other.sparse_.size()) {
+            if (j == other.sparse_.size() || (i < sparse_.size() && sparse_index(sparse_[i]) < sparse_index(other.sparse_[j]))) {
+                merged.push_back(sparse_[i++]);
+            } else if (i == sparse_.size() || sparse_index(other.sparse_[j]) < sparse_index(sparse_[i])) {
+                merged.push_back(other.sparse_[j++]);
+            } else {
+                merged.push_back(max(sparse_[i++], other.sparse_[j++]));  // same index: higher rank wins
+            }
+        }
+        sparse_ = move(merged);
+        if (sparse_.size() > kSparseLimit) to_dense();
+        return;
+    }
+
+    if (is_sparse()) to_dense();
+    hll::merge(registers_.data(), other.registers_.data(), kRegisters);
+}
+
+double HllSketch::estimate() const {
+    if (is_sparse()) {
+        // linear counting over the 2^25 sparse buckets; exact-ish for small sets
+        if (sparse_.empty()) return 0.0;
+        const double m = static_cast<double>(size_t{1} << kSparsePrecision);
+        return m * log(m / (m - static_cast<double>(sparse_.size())));
+    }
+    return hll::estimate(registers_.data(), kRegisters);
+}
+
+void HllSketch::clear() {
+    sparse_.clear();
+    sparse_.shrink_to_fit();
+    registers_.clear();
+    registers_.shrink_to_fit();
+}
+
+size_t HllSketch::memory_bytes() const {
+    return sparse_.capacity() * sizeof(uint32_t) + registers_.capacity();
+}
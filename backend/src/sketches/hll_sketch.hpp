@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Dense-register kernels behind HllSketch, for counters that need another
+// register count (HyperBall keeps a small one per user). count must be a
+// power of two, at least 16.
+namespace hll {
+std::uint64_t hash(std::uint64_t value);
+void add(std::uint8_t *registers, std::size_t count, std::uint64_t hash);
+// Register-wise max into dst; returns whether any register of dst grew.
+bool merge(std::uint8_t *dst, const std::uint8_t *src, std::size_t count);
+double estimate(const std::uint8_t *registers, std::size_t count);
+} // namespace hll
+
+// HyperLogLog++ distinct counter (precision 14) that starts sparse: a sorted
+// list of (25-bit index, rank) pairs estimated by linear counting, promoted to
+// 16K one-byte registers once the list would cost more than ~3/4 of them.
+// Sketches built from the same hash merge losslessly, in either representation.
+class HllSketch {
+public:
+    static constexpr int kPrecision = 14;
+    static constexpr int kSparsePrecision = 25;
+    static constexpr std::size_t kRegisters = std::size_t{1} << kPrecision;
+
+    void add(std::uint64_t value);
+    void merge(const HllSketch &other);
+    double estimate() const;
+    void clear();
+
+    bool is_sparse() const { return registers_.empty(); }
+    std::size_t memory_bytes() const;
+
+private:
+    // sparse entry: index at kSparsePrecision bits << 6 | rank (1..40)
+    static std::uint32_t encode_sparse(std::uint64_t hash);
+    static std::uint32_t sparse_index(std::uint32_t entry) { return entry >> 6; }
+    static std::uint8_t sparse_rank(std::uint32_t entry) { return static_cast<std::uint8_t>(entry & 0x3f); }
+
+    void insert_sparse(std::uint32_t entry);
+    void apply_sparse(std::uint32_t entry);  // dense only
+    void to_dense();
+
+    std::vector<std::uint32_t> sparse_;   // sorted by index, one entry per index
+    std::vector<std::uint8_t> registers_; // empty while sparse
+};
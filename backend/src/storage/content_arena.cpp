@@ -0,0 +1,76 @@
+#include "content_arena.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+using namespace std;
+
+ContentArena::ContentArena(size_t chunk_bytes) : chunk_bytes_(max<size_t>(chunk_bytes, 64)) {}
+
+char *ContentArena::reserve(size_t length, Span &span) {
+    if (chunks_.empty() || chunks_.back()->capacity - chunks_.back()->used < length) {
+        auto chunk = make_shared<Chunk>();
+        chunk->capacity = max(chunk_bytes_, length);
+        chunk->bytes.reset(new char[chunk->capacity]);
+        chunks_.push_back(move(chunk));
+    }
+    Chunk &chunk = *chunks_.back();
+    span.chunk = static_cast<uint32_t>(chunks_.size() - 1);
+    span.offset = static_cast<uint32_t>(chunk.used);
+    span.length = static_cast<uint32_t>(length);
+    char *out = chunk.bytes.get() + chunk.used;
+    chunk.used += length;
+    live_bytes_ += length;
+    return out;
+}
+
+ContentArena::Span ContentArena::append(string_view text) {
+    Span span;
+    if (text.empty()) return span;
+    memcpy(reserve(text.size(), span), text.data(), text.size());
+    return span;
+}
+
+ContentArena::Span ContentArena::append_lower(string_view text) {
+    Span span;
+    if (text.empty()) return span;
+    char *out = reserve(text.size(), span);
+    for (size_t i = 0; i < text.size(); ++i) out[i] = static_cast<char>(tolower((unsigned char)text[i]));
+    return span;
+}
+
+string_view ContentArena::view(const Span &span) const {
+    if (span.length == 0) return {};
+    return string_view(chunks_[span.chunk]->bytes.get() + span.offset, span.length);
+}
+
+ContentArena::Pinned ContentArena::pin() const {
+    Pinned pinned;
+    pinned.chunks_.reserve(chunks_.size());
+    pinned.bytes_.reserve(chunks_.size());
+    for (const auto &chunk : chunks_) {
+        pinned.chunks_.push_back(chunk);
+        pinned.bytes_.push_back(chunk->bytes.get());
+    }
+    return pinned;
+}
+
+string_view ContentArena::Pinned::view(const Span &span) const {
+    if (span.length == 0) return {};
+    return string_view(bytes_[span.chunk] + span.offset, span.length);
+}
+
+void ContentArena::release(const Span &span) {
+    live_bytes_ -= span.length;
+    garbage_bytes_ += span.length;
+}
+
+bool ContentArena::should_compact() const {
+    return garbage_bytes_ > chunk_bytes_ && garbage_bytes_ > live_bytes_;
+}
+
+void ContentArena::clear() {
+    chunks_.clear();
+    live_bytes_ = 0;
+    garbage_bytes_ = 0;
+}
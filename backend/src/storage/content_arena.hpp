@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only text storage carved out of large fixed-capacity chunks.
+// Bytes never move once written, so a Span (and any string_view made from it)
+// stays valid until the arena is cleared or replaced by a compacted copy.
+class ContentArena {
+public:
+    struct Span {
+        std::uint32_t chunk = 0;
+        std::uint32_t offset = 0;
+        std::uint32_t length = 0;
+    };
+
+    explicit ContentArena(std::size_t chunk_bytes = 1 << 20);
+
+    Span append(std::string_view text);
+    Span append_lower(std::string_view text);   // ASCII-lowercased copy
+    std::string_view view(const Span &span) const;
+
+    // Marks a span's bytes as dead; they are reclaimed by compaction.
+    void release(const Span &span);
+    bool should_compact() const;
+    void clear();
+
+    // Shares ownership of the current chunks: its views stay valid after the
+    // arena is cleared or swapped for a compacted copy. Spans appended after
+    // pin() are not covered.
+    class Pinned {
+    public:
+        std::string_view view(const Span &span) const;
+    private:
+        friend class ContentArena;
+        std::vector<std::shared_ptr<const void>> chunks_;
+        std::vector<const char *> bytes_;  // by chunk index
+    };
+    Pinned pin() const;
+
+    std::size_t live_bytes() const { return live_bytes_; }
+    std::size_t garbage_bytes() const { return garbage_bytes_; }
+    std::size_t chunk_bytes() const { return chunk_bytes_; }
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> bytes;
+        std::size_t used = 0;
+        std::size_t capacity = 0;
+    };
+
+    char *reserve(std::size_t length, Span &span);
+
+    std::size_t chunk_bytes_;
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    std::size_t live_bytes_ = 0;
+    std::size_t garbage_bytes_ = 0;
+};
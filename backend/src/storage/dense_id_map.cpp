@@ -0,0 +1,35 @@
+#include "dense_id_map.hpp"
+#include <algorithm>
+
+using namespace std;
+
+int DenseIdMap::insert(int id) {
+    if (id < 0) return -1;
+    if (static_cast<size_t>(id) >= slot_of_.size()) slot_of_.resize(static_cast<size_t>(id) + 1, -1);
+    if (slot_of_[id] >= 0) return slot_of_[id];
+    slot_of_[id] = static_cast<int>(ids_.size());
+    ids_.push_back(id);
+    return slot_of_[id];
+}
+
+vector<unsigned char> DenseIdMap::erase(const vector<int> &ids) {
+    vector<unsigned char> keep(ids_.size(), 1);
+    for (int id : ids) {
+        const int s = slot(id);
+        if (s < 0) continue;
+        keep[s] = 0;
+        slot_of_[id] = -1;
+    }
+    compact_column(ids_, keep);
+    for (size_t s = 0; s < ids_.size(); ++s) slot_of_[ids_[s]] = static_cast<int>(s);
+    return keep;
+}
+
+size_t DenseIdMap::lower_bound_slot(int id) const {
+    return static_cast<size_t>(lower_bound(ids_.begin(), ids_.end(), id) - ids_.begin());
+}
+
+void DenseIdMap::clear() {
+    slot_of_.clear();
+    ids_.clear();
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Maps stable external ids onto dense slots 0..size()-1. Ids are handed out
+// in increasing order and removal compacts the slots, so slot order is always
+// id order and per-field columns indexed by slot can be swept linearly.
+class DenseIdMap {
+public:
+    // Appends id in the next slot; id must be greater than every live id.
+    // Returns the existing slot if id is already present.
+    int insert(int id);
+    // Removes ids and renumbers the remaining slots. Returns a keep mask over
+    // the old slots for compact_column() on each of the caller's columns.
+    std::vector<unsigned char> erase(const std::vector<int> &ids);
+    void clear();
+
+    int slot(int id) const {
+        return id >= 0 && static_cast<std::size_t>(id) < slot_of_.size() ? slot_of_[id] : -1;
+    }
+    bool contains(int id) const { return slot(id) >= 0; }
+    int id_at(std::size_t slot) const { return ids_[slot]; }
+    // First slot whose id is >= id (size() if none).
+    std::size_t lower_bound_slot(int id) const;
+    const std::vector<int> &ids() const { return ids_; }
+    std::size_t size() const { return ids_.size(); }
+    bool empty() const { return ids_.empty(); }
+
+    // Survivors are move-constructed into a fresh column rather than
+    // move-assigned down, so elements keep their own allocators (pmr).
+    template <class T>
+    static void compact_column(std::vector<T> &column, const std::vector<unsigned char> &keep) {
+        std::vector<T> kept;
+        kept.reserve(column.size());
+        for (std::size_t i = 0; i < column.size(); ++i) {
+            if (keep[i]) kept.push_back(std::move(column[i]));
+        }
+        column.swap(kept);
+    }
+
+private:
+    std::vector<int> slot_of_;  // by id, -1 when absent
+    std::vector<int> ids_;      // by slot, ascending
+};
@@ -0,0 +1,47 @@
+#include "post_record.hpp"
+
+using namespace std;
+
+string post_record(int post_id, int user_id, string_view content) {
+    const bool escape = content.find_first_of("\r\n") != string_view::npos;
+    string out = escape ? "PE|" : "P|";
+    out += to_string(post_id);
+    out += '|';
+    out += to_string(user_id);
+    out += '|';
+    if (!escape) {
+        out += content;
+    } else {
+        for (char c : content) {
+            switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            default: out += c;
+            }
+        }
+    }
+    out += '\n';
+    return out;
+}
+
+size_t post_record_tag(string_view line) {
+    if (line.compare(0, 2, "P|") == 0) return 2;
+    if (line.compare(0, 3, "PE|") == 0) return 3;
+    return 0;
+}
+
+string post_record_content(size_t tag_length, string_view field) {
+    if (tag_length != 3) return string(field);
+    string out;
+    out.reserve(field.size());
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] != '\\' || i + 1 == field.size()) {
+            out += field[i];
+            continue;
+        }
+        const char c = field[++i];
+        out += c == 'n' ? '\n' : c == 'r' ? '\r' : c;
+    }
+    return out;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Post records in the line-based db files and the replication log. Text
+// without line breaks is written as P|post_id|user_id|content, byte for
+// byte as older files have it. Text with a '\n' or '\r' would split the
+// record, so it goes in a PE| record with backslash, '\n' and '\r' escaped.
+
+// The whole record, newline included.
+std::string post_record(int post_id, int user_id, std::string_view content);
+// Length of the record's tag and its bar ("P|" or "PE|"), 0 if the line is
+// not a post record.
+std::size_t post_record_tag(std::string_view line);
+// The content field of a record whose tag is tag_length long, unescaped.
+std::string post_record_content(std::size_t tag_length, std::string_view field);
@@ -18,15 +18,18 @@ void AhoCorasick::add_pattern(const string &pat) {
     }
     curr->is_end = true;
     curr->pattern = pat;
+    curr->pattern_ids.push_back(static_cast<int>(patterns.size()));
     patterns.push_back(pat);
 }
 
 void AhoCorasick::build() {
     queue<shared_ptr<Node>> q;
+    vector<shared_ptr<Node>> order{root};  // BFS order, parents before children
     
     for (auto &[c, child] : root->children) {
         child->fail = root;
         q.push(child);
+        order.push_back(child);
     }
     
     while (!q.empty()) {
@@ -35,6 +38,7 @@ void AhoCorasick::build() {
         
         for (auto &[c, child] : curr->children) {
             q.push(child);
+            order.push_back(child);
             
             auto fail_node = curr->fail;
             while (fail_node != root && !fail_node->children.count(c)) {
@@ -55,6 +59,37 @@ void AhoCorasick::build() {
             }
         }
     }
+
+    for (size_t i = 0; i < order.size(); ++i) order[i]->index = static_cast<int>(i);
+    byte_class.fill(0);
+    vector<char> class_bytes{0};  // a representative byte per class
+    for (const auto &pat : patterns) {
+        for (char ch : pat) {
+            auto &cls = byte_class[static_cast<unsigned char>(ch)];
+            if (cls) continue;
+            cls = static_cast<uint16_t>(class_bytes.size());
+            class_bytes.push_back(ch);
+        }
+    }
+    classes = class_bytes.size();
+    transitions.assign(order.size() * classes, 0);
+    outputs.assign(order.size(), {});
+    for (const auto &node : order) {
+        const int id = node->index;
+        outputs[id] = node->pattern_ids;
+        if (node != root) {
+            const auto &inherited = outputs[node->fail->index];
+            outputs[id].insert(outputs[id].end(), inherited.begin(), inherited.end());
+        }
+        for (size_t c = 1; c < classes; ++c) {
+            auto it = node->children.find(class_bytes[c]);
+            if (it != node->children.end()) {
+                transitions[id * classes + c] = it->second->index;
+            } else if (node != root) {
+                transitions[id * classes + c] = transitions[node->fail->index * classes + c];
+            }
+        }
+    }
 }
 
 vector<string> AhoCorasick::search(const string &text) {
@@ -88,3 +123,19 @@ vector<string> AhoCorasick::search(const string &text) {
     
     return matches;
 }
+
+void AhoCorasick::match_ids(string_view text, vector<int> &out, vector<unsigned char> &seen) const {
+    if (patterns.empty() || transitions.empty()) return;
+    const size_t first = out.size();
+    int state = 0;
+    for (char c : text) {
+        state = transitions[state * classes + byte_class[static_cast<unsigned char>(c)]];
+        for (int id : outputs[state]) {
+            if (!seen[id]) {
+                seen[id] = 1;
+                out.push_back(id);
+            }
+        }
+    }
+    for (size_t i = first; i < out.size(); ++i) seen[out[i]] = 0;
+}
@@ -1,8 +1,11 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <string_view>
 
 using namespace std;
 
@@ -12,13 +15,29 @@ struct AhoCorasick {
         shared_ptr<Node> fail;
         bool is_end = false;
         string pattern;
+        vector<int> pattern_ids;  // patterns ending exactly here
+        int index = 0;
     };
     
     shared_ptr<Node> root;
     vector<string> patterns;
+
+    // Flattened automaton filled in by build(): one transition per byte class
+    // and node (failure links already resolved) and every pattern id reported
+    // there. Each byte that occurs in a pattern is its own class; all other
+    // bytes share class 0, which always leads back to the root, so lowercase
+    // ASCII terms need ~30 columns instead of 256.
+    array<uint16_t, 256> byte_class{};
+    size_t classes = 1;
+    vector<int> transitions;
+    vector<vector<int>> outputs;
     
     AhoCorasick();
     void add_pattern(const string &pat);
     void build();
     vector<string> search(const string &text);
+
+    // Appends the distinct ids of patterns occurring in text to out.
+    // `seen` must hold patterns.size() zeroes and is left zeroed on return.
+    void match_ids(string_view text, vector<int> &out, vector<unsigned char> &seen) const;
 };
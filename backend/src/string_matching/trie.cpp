@@ -26,14 +26,41 @@ void Trie::insert(const string &s) {
     for (char c : lower_s) {
         if (current->children.find(c) == current->children.end()) {
             current->children[c] = make_shared<TrieNode>();
+            ++node_count;
         }
         current = current->children[c];
     }
     
+    if (!current->is_end_of_word) ++word_count;
     current->is_end_of_word = true;
     current->complete_word = s;  
 }
 
+bool Trie::erase(const string &s) {
+    if (s.empty()) return false;
+
+    string lower_s = to_lowercase(s);
+    vector<TrieNode *> path{root.get()};
+    for (char c : lower_s) {
+        auto it = path.back()->children.find(c);
+        if (it == path.back()->children.end()) return false;
+        path.push_back(it->second.get());
+    }
+    if (!path.back()->is_end_of_word) return false;
+    path.back()->is_end_of_word = false;
+    path.back()->complete_word.clear();
+    --word_count;
+
+    // prune from the leaf up while nodes carry nothing else
+    for (size_t i = lower_s.size(); i > 0; --i) {
+        TrieNode *node = path[i];
+        if (node->is_end_of_word || !node->children.empty()) break;
+        path[i - 1]->children.erase(lower_s[i - 1]);
+        --node_count;
+    }
+    return true;
+}
+
 void Trie::dfs_collect(shared_ptr<TrieNode> node, vector<string> &results, int limit) {
     if (!node || (int)results.size() >= limit) return;
     
@@ -74,4 +101,6 @@ vector<string> Trie::autocomplete(const string &prefix, int limit) {
 
 void Trie::clear() {
     root = make_shared<TrieNode>();
+    node_count = 1;
+    word_count = 0;
 }
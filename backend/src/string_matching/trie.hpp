@@ -18,9 +18,13 @@ struct TrieNode {
 
 struct Trie {
     shared_ptr<TrieNode> root;
+    size_t node_count = 1;  // including the root
+    size_t word_count = 0;
     
     Trie();
     void insert(const string &s);
+    // Drops s and any nodes no other word runs through. False if s is not in the trie.
+    bool erase(const string &s);
     vector<string> autocomplete(const string &prefix, int limit = 10);
     void clear();
     